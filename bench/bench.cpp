@@ -3,6 +3,9 @@
 #include <chrono>
 #include <iostream>
 #include <iomanip>
+#include <vector>
+#include <cmath>
+#include <glm/gtx/transform.hpp>
 
 using namespace std;
 using namespace std::chrono;
@@ -10,51 +13,492 @@ using namespace std::chrono;
 #ifdef EMSCRIPTEN
 int bench() {
 #else
-int main() {
+int main(int argc, char* argv[]) {
 #endif
     PlanetsUniverse universe;
 
-    /* Use a constant seed for consistency. */
-    universe.randSeed(0);
+#ifndef EMSCRIPTEN
+    /* The first argument can set the number of threads, otherwise all of them are used. */
+    if (argc > 1)
+        universe.setThreadCount(unsigned(std::stoul(argv[1])));
+#endif
+
+    /* The number of steps is reduced as the amount of planets increases, the last few sizes are where the tree solvers should pull ahead of the scalar loop. */
+    size_t sizes[] = { 20,   100,  200,  500,  800,  1500, 3000, 6000, 20000 };
+    int steps[] =    { 2000, 1750, 1500, 1250, 1000, 400,  100,  25,   5 };
 
-    /* Start with a thousand steps. */
-    universe.stepsPerFrame = 2000;
+    struct Config {
+        string name;
+        PlanetsUniverse::GravitySolver solver;
+        ForceKernel::InstructionSet instructionSet;
+        PlanetsUniverse::Integrator integrator;
+    };
 
-    size_t sizes[] = { 20, 100, 200, 500, 800 };
+    /* Run the direct solver with every instruction set this CPU has, to see what the vector versions are worth. */
+    vector<Config> configs;
+    for (int set = ForceKernel::Scalar; set <= ForceKernel::detect(); ++set)
+        configs.push_back({ string("direct-") + ForceKernel::name(ForceKernel::InstructionSet(set)), PlanetsUniverse::DirectSum,
+                            ForceKernel::InstructionSet(set), PlanetsUniverse::Euler });
+    configs.push_back({ "barnes-hut", PlanetsUniverse::BarnesHut, ForceKernel::detect(), PlanetsUniverse::Euler });
+    configs.push_back({ "multipole", PlanetsUniverse::FastMultipole, ForceKernel::detect(), PlanetsUniverse::Euler });
+    configs.push_back({ "particle-mesh", PlanetsUniverse::ParticleMeshFFT, ForceKernel::detect(), PlanetsUniverse::Euler });
+
+    /* The higher order integrators, with the fastest direct solver. */
+    configs.push_back({ "leapfrog", PlanetsUniverse::DirectSum, ForceKernel::detect(), PlanetsUniverse::Leapfrog });
+    configs.push_back({ "yoshida4", PlanetsUniverse::DirectSum, ForceKernel::detect(), PlanetsUniverse::Yoshida4 });
 
 #ifndef NDEBUG
     cout << "WARNING: Debug builds benchmarks can take an extremely long time, "
             "and aren't always indicative of release build performance." << endl;
 #endif
 
-    /* Col:  |- 6-||-- 8--||---   16   ---||---   16   ---| doesn't matter, Align left. */
-    cout << "steps planets total time      average step    remaining planets" << left << endl;
+    cout << "threads: " << universe.threadCount() << endl;
+
+    /* Col:  |--- 15 ---||- 6-||-- 8--||---   16   ---||---   16   ---| doesn't matter, Align left. */
+    cout << "solver         steps planets total time      average step    remaining planets" << left << endl;
+
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+        for (const Config& config : configs) {
+            /* The grid costs the same no matter how many planets there are, so it's only worth timing with a lot of them. */
+            if (config.solver == PlanetsUniverse::ParticleMeshFFT && sizes[i] < 3000)
+                continue;
+
+            /* Use a constant seed for consistency, and so both solvers start with the same planets. */
+            universe.randSeed(0);
+            universe.generateRandom(sizes[i], 1000.0f, 1.0f, 1000.0f);
+
+            universe.stepsPerFrame = steps[i];
+            universe.gravitySolver = config.solver;
+            universe.instructionSet = config.instructionSet;
+            universe.integrator = config.integrator;
+
+            cout << setw(15) << config.name
+                 << setw(6) << universe.stepsPerFrame
+                 << setw(8) << sizes[i];
+
+            high_resolution_clock::time_point start = high_resolution_clock::now();
+
+            universe.advance(10.0f);
+
+            high_resolution_clock::time_point end = high_resolution_clock::now();
+
+            double delay = duration_cast<duration<double, std::milli>>(end - start).count();
+
+            cout << setw(16) << to_string(delay) + "ms"
+                 << setw(16) << to_string(delay / double(universe.stepsPerFrame)) + "ms"
+                 << universe.size();
+
+            /* The fast multipole solver is only approximate, so show how far off it was. */
+            if (config.solver == PlanetsUniverse::FastMultipole)
+                cout << " (force error " << scientific << setprecision(2) << universe.multipoleError() << defaultfloat << ")";
+
+            cout << endl;
+
+            fflush(stdout);
+
+            /* Clear the thing for the next one. */
+            universe.deleteAll();
+        }
+    }
+
+    /* A star with planets orbiting it, to see how well each integrator holds onto energy for the time it takes.
+     * Wisdom-Holman follows the orbits exactly so it gets much longer steps, IAS15 picks its own. */
+    struct OrbitConfig {
+        string name;
+        PlanetsUniverse::Integrator integrator;
+        int stepsPerFrame;
+    };
+    const OrbitConfig orbitConfigs[] = {
+        { "euler",         PlanetsUniverse::Euler,          20 },
+        { "euler",         PlanetsUniverse::Euler,          1 },
+        { "leapfrog",      PlanetsUniverse::Leapfrog,       20 },
+        { "leapfrog",      PlanetsUniverse::Leapfrog,       1 },
+        { "yoshida4",      PlanetsUniverse::Yoshida4,       1 },
+        { "wisdom-holman", PlanetsUniverse::WisdomHolman,   20 },
+        { "wisdom-holman", PlanetsUniverse::WisdomHolman,   1 },
+        { "ias15",         PlanetsUniverse::IAS15,          1 },
+        { "kepler",        PlanetsUniverse::KeplerLeapfrog, 1 },
+    };
+    const int orbitFrames = 100;
+    const float orbitFrameTime = 1.0e5f;
+
+    cout << endl << "integrator     steps total time      energy error    error per second" << endl;
+
+    for (const OrbitConfig& config : orbitConfigs) {
+        universe.randSeed(0);
+        const key_type star = universe.addPlanet(Planet(glm::vec3(), glm::vec3(), 1.0e6f));
+
+        /* Light planets so the orbits don't cross too much, and far enough apart that they don't merge. */
+        for (int p = 0; p < 20; ++p) {
+            const glm::mat4 plane = glm::rotate(0.05f * float(p), glm::vec3(1.0f, 0.0f, 0.0f)) * glm::rotate(2.4f * float(p), glm::vec3(0.0f, 0.0f, 1.0f));
+            universe.addOrbital(star, 300.0f + 400.0f * float(p), 1.0f + float(p), plane);
+        }
+
+        universe.gravitySolver = PlanetsUniverse::DirectSum;
+        universe.integrator = config.integrator;
+        universe.stepsPerFrame = config.stepsPerFrame;
+
+        const double startEnergy = universe.totalEnergy();
+
+        high_resolution_clock::time_point start = high_resolution_clock::now();
+
+        for (int frame = 0; frame < orbitFrames; ++frame)
+            universe.advance(orbitFrameTime);
+
+        const double seconds = duration_cast<duration<double>>(high_resolution_clock::now() - start).count();
+        const double error = abs((universe.totalEnergy() - startEnergy) / startEnergy);
+
+        cout << setw(15) << config.name
+             << setw(6) << config.stepsPerFrame
+             << setw(16) << to_string(seconds * 1000.0) + "ms"
+             << setw(16) << scientific << setprecision(3) << error
+             << error / seconds << defaultfloat << endl;
+
+        universe.deleteAll();
+    }
+
+    /* The same orbits with leapfrog in each precision, around the origin and then far enough away that a float can only
+     * just tell the planets' steps apart from where they are. */
+    struct PrecisionConfig {
+        string name;
+        PlanetsUniverse::Precision precision;
+    };
+    const PrecisionConfig precisionConfigs[] = {
+        { "single", PlanetsUniverse::Single },
+        { "mixed",  PlanetsUniverse::Mixed },
+        { "double", PlanetsUniverse::Double },
+    };
+    const float precisionOffsets[] = { 0.0f, 1.0e5f };
+
+    /* Run the orbits around offset for orbitFrames, returning how long it took and the relative change in energy. */
+    auto runPrecisionOrbits = [&](float offset, double& seconds, double& error) {
+        universe.randSeed(0);
+        const key_type star = universe.addPlanet(Planet(glm::vec3(offset, 0.0f, 0.0f), glm::vec3(), 1.0e6f));
+
+        for (int p = 0; p < 20; ++p) {
+            const glm::mat4 plane = glm::rotate(0.05f * float(p), glm::vec3(1.0f, 0.0f, 0.0f)) * glm::rotate(2.4f * float(p), glm::vec3(0.0f, 0.0f, 1.0f));
+            universe.addOrbital(star, 300.0f + 400.0f * float(p), 1.0f + float(p), plane);
+        }
 
-    for (size_t size : sizes) {
-        universe.generateRandom(size, 1000.0f, 1.0f, 1000.0f);
+        universe.gravitySolver = PlanetsUniverse::DirectSum;
+        universe.integrator = PlanetsUniverse::Leapfrog;
+        universe.stepsPerFrame = 20;
 
-        cout << setw(6) << universe.stepsPerFrame
-             << setw(8) << size;
+        /* Starting from the float values, so every precision starts from exactly the same place. */
+        universe.advance(0.0f);
+        const double startEnergy = universe.totalEnergy();
 
         high_resolution_clock::time_point start = high_resolution_clock::now();
 
-        universe.advance(10.0f);
+        for (int frame = 0; frame < orbitFrames; ++frame)
+            universe.advance(orbitFrameTime);
+
+        seconds = duration_cast<duration<double>>(high_resolution_clock::now() - start).count();
+        error = abs((universe.totalEnergy() - startEnergy) / startEnergy);
+
+        universe.deleteAll();
+    };
+
+    cout << endl << "precision      offset  total time      energy error" << endl;
+
+    /* Rebasing would move everything back to the origin before the first step. */
+    universe.rebaseDistance = 0.0f;
+
+    for (float offset : precisionOffsets) {
+        for (const PrecisionConfig& config : precisionConfigs) {
+            universe.precision = config.precision;
+
+            double seconds, error;
+            runPrecisionOrbits(offset, seconds, error);
+
+            cout << setw(15) << config.name
+                 << setw(8) << offset
+                 << setw(16) << to_string(seconds * 1000.0) + "ms"
+                 << scientific << setprecision(3) << error << defaultfloat << endl;
+        }
+    }
+
+    universe.precision = PlanetsUniverse::Single;
+
+    /* The far away orbits again in single precision, left where they are and then moved back to the origin by rebasing. */
+    const float rebaseDistances[] = { 0.0f, 1.0e4f };
+
+    cout << endl << "rebase         offset  total time      energy error" << endl;
 
-        high_resolution_clock::time_point end = high_resolution_clock::now();
+    for (float distance : rebaseDistances) {
+        universe.rebaseDistance = distance;
 
-        double delay = duration_cast<duration<double, std::milli>>(end - start).count();
+        double seconds, error;
+        runPrecisionOrbits(precisionOffsets[1], seconds, error);
+
+        cout << setw(15) << (distance > 0.0f ? "on" : "off")
+             << setw(8) << precisionOffsets[1]
+             << setw(16) << to_string(seconds * 1000.0) + "ms"
+             << scientific << setprecision(3) << error << defaultfloat << endl;
+    }
+
+    /* A sparse cloud around a tight binary, where the binary needs far shorter steps than anything else.
+     * Shared steps have to be short enough for the binary, block timesteps only make the binary's short. */
+    const OrbitConfig mixedConfigs[] = {
+        { "leapfrog",      PlanetsUniverse::Leapfrog,       20 },
+        { "leapfrog",      PlanetsUniverse::Leapfrog,       200 },
+        { "block",         PlanetsUniverse::BlockTimesteps, 1 },
+    };
+
+    cout << endl << "integrator     steps total time      force evaluations   energy error" << endl;
+
+    for (const OrbitConfig& config : mixedConfigs) {
+        universe.randSeed(0);
+        universe.generateRandom(300, 5000.0f, 0.0f, 10.0f);
+        const key_type star = universe.addPlanet(Planet(glm::vec3(), glm::vec3(), 1.0e6f));
+        universe.addOrbital(star, 250.0f, 1.0e4f, glm::mat4(1.0f));
+
+        universe.integrator = config.integrator;
+        universe.stepsPerFrame = config.stepsPerFrame;
+
+        const double startEnergy = universe.totalEnergy();
+        uint64_t evaluations = 0;
+
+        high_resolution_clock::time_point start = high_resolution_clock::now();
+
+        for (int frame = 0; frame < orbitFrames / 2; ++frame) {
+            universe.advance(orbitFrameTime);
+            evaluations += universe.forceEvaluations();
+        }
+
+        const double seconds = duration_cast<duration<double>>(high_resolution_clock::now() - start).count();
+
+        cout << setw(15) << config.name
+             << setw(6) << config.stepsPerFrame
+             << setw(16) << to_string(seconds * 1000.0) + "ms"
+             << setw(20) << evaluations
+             << scientific << setprecision(3) << abs((universe.totalEnergy() - startEnergy) / startEnergy) << defaultfloat << endl;
+
+        universe.deleteAll();
+    }
 
-        cout << setw(16) << to_string(delay) + "ms"
-             << setw(16) << to_string(delay / double(universe.stepsPerFrame)) + "ms"
+    /* A planet on an eccentric orbit that passes a couple of radii from the star, with steps too long for the pass unless
+     * there's a lot of them, with and without regularizing close pairs. */
+    struct EncounterConfig {
+        float regularizationRange;
+        int stepsPerFrame;
+    };
+    const EncounterConfig encounterConfigs[] = {
+        { 0.0f,  1 },
+        { 0.0f,  40 },
+        { 10.0f, 1 },
+    };
+
+    cout << endl << "regularization steps total time      energy error" << endl;
+
+    for (const EncounterConfig& config : encounterConfigs) {
+        universe.addPlanet(Planet(glm::vec3(), glm::vec3(), 1.0e6f));
+        universe.addPlanet(Planet(glm::vec3(3000.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.36f * sqrt(6.667e-11f * 1.0e6f / 3000.0f), 0.0f), 1.0f));
+
+        universe.integrator = PlanetsUniverse::Leapfrog;
+        universe.regularizationRange = config.regularizationRange;
+        universe.stepsPerFrame = config.stepsPerFrame;
+
+        const double startEnergy = universe.totalEnergy();
+
+        high_resolution_clock::time_point start = high_resolution_clock::now();
+
+        for (int frame = 0; frame < orbitFrames; ++frame)
+            universe.advance(orbitFrameTime * 3.0f);
+
+        const double seconds = duration_cast<duration<double>>(high_resolution_clock::now() - start).count();
+
+        cout << setw(15) << config.regularizationRange
+             << setw(6) << config.stepsPerFrame
+             << setw(16) << to_string(seconds * 1000.0) + "ms"
+             << scientific << setprecision(3) << abs((universe.totalEnergy() - startEnergy) / startEnergy) << defaultfloat << endl;
+
+        universe.deleteAll();
+    }
+
+    /* A dense cloud that quickly starts merging. The particle mesh doesn't notice touching planets without its correction,
+     * and Barnes-Hut only does when it opens the node they're in, the spatial hash finds them whatever the solver.
+     * With the hash, planets that grow into others while merging get merged in the same step too. */
+    struct CollisionConfig {
+        string name;
+        PlanetsUniverse::GravitySolver solver;
+        bool hashCollisions;
+    };
+    const CollisionConfig collisionConfigs[] = {
+        { "direct",        PlanetsUniverse::DirectSum,       false },
+        { "direct",        PlanetsUniverse::DirectSum,       true },
+        { "barnes-hut",    PlanetsUniverse::BarnesHut,       false },
+        { "barnes-hut",    PlanetsUniverse::BarnesHut,       true },
+        { "particle-mesh", PlanetsUniverse::ParticleMeshFFT, false },
+        { "particle-mesh", PlanetsUniverse::ParticleMeshFFT, true },
+    };
+
+    cout << endl << "solver         hash  total time      after one step  remaining planets" << endl;
+
+    for (const CollisionConfig& config : collisionConfigs) {
+        universe.randSeed(0);
+        universe.generateRandom(6000, 400.0f, 0.0f, 1000.0f);
+
+        universe.integrator = PlanetsUniverse::Leapfrog;
+        universe.gravitySolver = config.solver;
+        universe.meshCorrection = false;
+        universe.hashCollisions = config.hashCollisions;
+        universe.stepsPerFrame = 1;
+
+        high_resolution_clock::time_point start = high_resolution_clock::now();
+
+        universe.advance(orbitFrameTime / 5.0f);
+        const size_t firstStep = universe.size();
+
+        universe.stepsPerFrame = 5;
+        for (int frame = 0; frame < 4; ++frame)
+            universe.advance(orbitFrameTime);
+
+        const double delay = duration_cast<duration<double, std::milli>>(high_resolution_clock::now() - start).count();
+
+        cout << setw(15) << config.name
+             << setw(6) << (config.hashCollisions ? "on" : "off")
+             << setw(16) << to_string(delay) + "ms"
+             << setw(16) << firstStep
              << universe.size() << endl;
 
-        fflush(stdout);
+        universe.deleteAll();
+    }
+
+    universe.gravitySolver = PlanetsUniverse::DirectSum;
+    universe.meshCorrection = true;
+    universe.hashCollisions = true;
+
+    /* A disk of debris around a star with a few planets in it, first with the debris as light planets and then as tracers
+     * that only feel the star and the planets. */
+    const size_t debrisSizes[] = { 2000, 20000 };
+
+    cout << endl << "debris         steps debris  total time      average step" << endl;
+
+    for (size_t debris : debrisSizes) {
+        for (int tracers = 0; tracers < 2; ++tracers) {
+            universe.randSeed(0);
+            const key_type star = universe.addPlanet(Planet(glm::vec3(), glm::vec3(), 1.0e6f));
+            for (int p = 0; p < 10; ++p)
+                universe.addOrbital(star, 2000.0f + 500.0f * float(p), 100.0f, glm::mat4(1.0f));
+
+            if (tracers)
+                universe.generateRandomOrbitalTracers(debris, star);
+            else
+                for (size_t d = 0; d < debris; ++d)
+                    universe.addOrbital(star, 100.0f + 10.0f * float(d % 500), 1.0f,
+                                        glm::rotate(float(d), glm::vec3(0.0f, 0.0f, 1.0f)));
+
+            universe.integrator = PlanetsUniverse::Leapfrog;
+            universe.stepsPerFrame = 5;
+
+            high_resolution_clock::time_point start = high_resolution_clock::now();
+
+            universe.advance(orbitFrameTime);
+
+            const double delay = duration_cast<duration<double, std::milli>>(high_resolution_clock::now() - start).count();
+
+            cout << setw(15) << (tracers ? "tracers" : "planets")
+                 << setw(6) << universe.stepsPerFrame
+                 << setw(8) << debris
+                 << setw(16) << to_string(delay) + "ms"
+                 << to_string(delay / double(universe.stepsPerFrame)) + "ms" << endl;
+
+            universe.deleteAll();
+        }
+    }
+
+    /* A frame at a time with a single step each, so the merging and the trails are as much of the work as they can be.
+     * Whatever is turned off isn't checked at all, advance() picks a version of the step loop without it. */
+    struct FeatureConfig {
+        string name;
+        bool mergePlanets, recordPaths;
+    };
+    const FeatureConfig featureConfigs[] = {
+        { "everything", true,  true },
+        { "no-trails",  true,  false },
+        { "no-merging", false, true },
+        { "gravity",    false, false },
+    };
+
+    cout << endl << "features       frames planets total time      average frame" << endl;
+
+    for (const FeatureConfig& config : featureConfigs) {
+        universe.randSeed(0);
+        universe.generateRandom(200, 1.0e3f, 1.0f, 100.0f);
+
+        universe.integrator = PlanetsUniverse::Leapfrog;
+        universe.mergePlanets = config.mergePlanets;
+        universe.recordPaths = config.recordPaths;
+        universe.stepsPerFrame = 1;
+
+        const int frames = 2000;
+
+        high_resolution_clock::time_point start = high_resolution_clock::now();
+
+        for (int frame = 0; frame < frames; ++frame)
+            universe.advance(1.0f);
+
+        const double delay = duration_cast<duration<double, std::milli>>(high_resolution_clock::now() - start).count();
+
+        cout << setw(15) << config.name
+             << setw(7) << frames
+             << setw(8) << universe.size()
+             << setw(16) << to_string(delay) + "ms"
+             << to_string(delay / double(frames)) + "ms" << endl;
 
-        /* Clear the thing for the next one. */
         universe.deleteAll();
+    }
+
+    universe.mergePlanets = true;
+    universe.recordPaths = true;
+
+    /* A big cloud in the random order it was added in, then the same cloud sorted along a Z-curve. The planets start out the
+     * same either way, the difference in step time is how many more cache misses the tree build and the spatial hash get
+     * without sorting. */
+    const size_t sortSizes[] = { 20000, 100000 };
+
+    cout << endl << "order          steps planets sort time       average step" << endl;
+
+    universe.gravitySolver = PlanetsUniverse::BarnesHut;
+    universe.integrator = PlanetsUniverse::Leapfrog;
+    universe.sortInterval = 0;
+
+    for (size_t planets : sortSizes) {
+        for (int sorted = 0; sorted < 2; ++sorted) {
+            universe.randSeed(0);
+            universe.generateRandom(planets, 1.0e5f, 0.0f, 100.0f);
+
+            double sortDelay = 0.0;
+            if (sorted) {
+                high_resolution_clock::time_point start = high_resolution_clock::now();
+
+                universe.sortPlanets();
+
+                sortDelay = duration_cast<duration<double, std::milli>>(high_resolution_clock::now() - start).count();
+            }
+
+            /* One step first, so both are timed doing the same steps with the first merges out of the way and the tree,
+             * hash, and force buffers already allocated. */
+            universe.stepsPerFrame = 1;
+            universe.advance(orbitFrameTime);
+
+            universe.stepsPerFrame = 2;
+
+            high_resolution_clock::time_point start = high_resolution_clock::now();
+
+            universe.advance(orbitFrameTime);
+
+            const double delay = duration_cast<duration<double, std::milli>>(high_resolution_clock::now() - start).count();
+
+            cout << setw(15) << (sorted ? "z-curve" : "random")
+                 << setw(6) << universe.stepsPerFrame
+                 << setw(8) << universe.size()
+                 << setw(16) << to_string(sortDelay) + "ms"
+                 << to_string(delay / double(universe.stepsPerFrame)) + "ms" << endl;
 
-        /* Reduce the number of steps as the amount of planets increases. */
-        universe.stepsPerFrame -= 250;
+            universe.deleteAll();
+        }
     }
 
     return 0;
@@ -1,6 +1,7 @@
 #include "sdlgamepad.h"
 #include "camera.h"
 #include "planetsuniverse.h"
+#include "simulationrunner.h"
 #include "placinginterface.h"
 #include <SDL.h>
 #include <glm/glm.hpp>
@@ -62,11 +63,11 @@ void PlanetsGamepad::doControllerButtonPress(const uint8_t& button) {
             camera.selectUnder(camera.getCenterScreen());
         break;
     case SDL_CONTROLLER_BUTTON_X:
-        universe.deleteSelected();
+        runner.post([](PlanetsUniverse& universe) { universe.deleteSelected(); });
         break;
     case SDL_CONTROLLER_BUTTON_Y:
         /* Automatically select orbital or normal interactive placement based on selection. */
-        if (universe.isSelectedValid())
+        if (runner.current().isSelectedValid())
             placing.beginOrbitalCreation();
         else
             placing.beginInteractiveCreation();
@@ -74,7 +75,7 @@ void PlanetsGamepad::doControllerButtonPress(const uint8_t& button) {
     case SDL_CONTROLLER_BUTTON_B:
         /* If trigger is not being held down pause/resume. */
         if (speedTriggerLast < triggerDeadzone)
-            universe.simulationSpeed = universe.simulationSpeed <= 0.0f ? 1.0f : 0.0f;
+            runner.post([](PlanetsUniverse& universe) { universe.simulationSpeed = universe.simulationSpeed <= 0.0f ? 1.0f : 0.0f; });
 
         /* If the trigger is being held down lock to current speed. */
         speedTriggerInUse = false;
@@ -150,8 +151,8 @@ void PlanetsGamepad::doControllerAxisInput(int32_t delay) {
 
         /* If the trigger has gone from disengaged (< deadzone) to engaged (> deadzone) we enable using it as speed input. */
         if (speedTriggerInUse || (speedTriggerCurrent > triggerDeadzone && speedTriggerLast <= triggerDeadzone)) {
-            universe.simulationSpeed = float(speedTriggerCurrent * 8) / int16_max;
-            universe.simulationSpeed *= universe.simulationSpeed;
+            const float speed = float(speedTriggerCurrent * 8) / int16_max;
+            runner.post([speed](PlanetsUniverse& universe) { universe.simulationSpeed = speed * speed; });
 
             speedTriggerInUse = true;
         }
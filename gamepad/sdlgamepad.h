@@ -6,7 +6,7 @@
 #include <functional>
 
 class PlanetsGamepad {
-    PlanetsUniverse& universe;
+    SimulationRunner& runner;
     Camera& camera;
     PlacingInterface& placing;
 
@@ -34,7 +34,7 @@ public:
     void doControllerButtonPress(const Uint8& button);
     void doControllerAxisInput(int32_t delay);
 
-    PlanetsGamepad(PlanetsUniverse& u, Camera& c, PlacingInterface& p) : universe(u), camera(c), placing(p) { }
+    PlanetsGamepad(SimulationRunner& r, Camera& c, PlacingInterface& p) : runner(r), camera(c), placing(p) { }
 
     inline bool isAttached() const { return controller != nullptr; }
 
@@ -1,4 +1,5 @@
 #include <planetsuniverse.h>
+#include <simulationrunner.h>
 #include <camera.h>
 #include <emscripten/bind.h>
 #include <glm/vec2.hpp>
@@ -73,7 +74,7 @@ EMSCRIPTEN_BINDINGS(camera) {
             .value("WeightedAverage",   Camera::WeightedAverage)
             ;
     emscripten::class_<Camera>("Camera")
-            .constructor<PlanetsUniverse&>()
+            .constructor<SimulationRunner&>()
             .function("bound",                  &Camera::bound)
             .function("clearFollow",            &Camera::clearFollow)
             .function("followNext",             &Camera::followNext)
@@ -1,4 +1,5 @@
 #include <planetsuniverse.h>
+#include <simulationrunner.h>
 #include <camera.h>
 #include <placinginterface.h>
 #include <emscripten/bind.h>
@@ -52,7 +53,7 @@ EMSCRIPTEN_BINDINGS(placinginterface) {
             .element(&TwoBool::b2)
             ;
     emscripten::class_<PlacingInterface>("PlacingInterface")
-            .constructor<PlanetsUniverse&>()
+            .constructor<SimulationRunner&>()
             .function("beginInteractiveCreation",   &PlacingInterface::beginInteractiveCreation)
             .function("beginOrbitalCreation",       &PlacingInterface::beginOrbitalCreation)
             .function("enableFiringMode",           &PlacingInterface::enableFiringMode)
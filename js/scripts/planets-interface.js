@@ -1,4 +1,4 @@
-var universe, camera, placing;
+var universe, runner, camera, placing;
 
 var gamepad;
 
@@ -392,11 +392,13 @@ var Module = {
 
         universe = new Module.PlanetsUniverse();
 
-        camera = new Module.Camera(universe);
+        runner = new Module.SimulationRunner(universe);
 
-        placing = new Module.PlacingInterface(universe);
+        camera = new Module.Camera(runner);
 
-        gamepad = new Module.Gamepad(universe, camera, placing);
+        placing = new Module.PlacingInterface(runner);
+
+        gamepad = new Module.Gamepad(runner, camera, placing);
         gamepad.init();
 
         /* To track the button being pressed during mousemove. */
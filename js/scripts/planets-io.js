@@ -57,9 +57,10 @@ function generateDOM() {
         var root = doc.createElement("planets-3d-universe");
 
         for (var i = 0; i < universe.size(); ++i) {
-            var pos = universe.getPlanetPosition(i);
-            var vel = universe.getPlanetVelocity(i);
-            var mass = universe.getPlanetMass(i);
+            var key = universe.keyAt(i);
+            var pos = universe.getPlanetPosition(key);
+            var vel = universe.getPlanetVelocity(key);
+            var mass = universe.getPlanetMass(key);
 
             var p = doc.createElement("planet");
 
@@ -108,10 +109,12 @@ function loadLocalStorage(name) {
 function getBase64() {
     var json = [];
 
-    for (var i = 0; i < universe.size(); ++i)
-        json.push([universe.getPlanetPosition(i),
-                   universe.getPlanetVelocity(i),
-                   universe.getPlanetMass(i)])
+    for (var i = 0; i < universe.size(); ++i) {
+        var key = universe.keyAt(i);
+        json.push([universe.getPlanetPosition(key),
+                   universe.getPlanetVelocity(key),
+                   universe.getPlanetMass(key)])
+    }
 
     return LZString.compressToEncodedURIComponent(JSON.stringify(json));
 }
@@ -241,7 +241,8 @@ function paint() {
     GLctx.uniform3fv(textureLightDir, camera.getLightDir());
 
     for (var i = 0; i < universe.size(); ++i) {
-        GLctx.uniformMatrix4fv(textureModelMat, false, makeMat(universe.getPlanetPosition(i), universe.getPlanetRadius(i)));
+        var key = universe.keyAt(i);
+        GLctx.uniformMatrix4fv(textureModelMat, false, makeMat(universe.getPlanetPosition(key), universe.getPlanetRadius(key)));
 
         GLctx.drawElements(GLctx.TRIANGLES, highResTriCount, GLctx.UNSIGNED_INT, 0);
     }
@@ -369,8 +370,9 @@ function animate(time) {
     lastTime = time;
 
     /* We don't advance when placing. */
-    if (placing.step === Module.PlacingStep.NotPlacing || placing.step === Module.PlacingStep.Firing)
-        universe.advance(delta);
+    runner.setPaused(placing.step !== Module.PlacingStep.NotPlacing && placing.step !== Module.PlacingStep.Firing);
+    runner.update(delta);
+    runner.acquire();
 
     gamepad.pollInput();
     gamepad.doAxisInput(delta);
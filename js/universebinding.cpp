@@ -1,4 +1,5 @@
 #include <planetsuniverse.h>
+#include <simulationrunner.h>
 #include <planet.h>
 #include "glbindings.h"
 
@@ -48,9 +49,18 @@ void drawTrails(PlanetsUniverse& universe) {
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
     glEnableVertexAttribArray(vertex);
 
-    for (const auto& i : universe) {
-        glVertexAttribPointer(vertex, 3, GL_FLOAT, GL_FALSE, 0, i.path.data());
-        glDrawArrays(GL_LINE_STRIP, 0, GLsizei(i.path.size()));
+    const TrailArena& trails = universe.getTrails();
+
+    for (size_t i = 0; i < trails.trailCount(); ++i) {
+        const TrailArena::Spans spans = trails.spans(i);
+
+        /* A trail can be split in two where its ring buffer wraps around. */
+        for (const TrailArena::Span& span : { spans.first, spans.second }) {
+            if (span.size < 2) continue;
+
+            glVertexAttribPointer(vertex, 3, GL_FLOAT, GL_FALSE, 0, span.data);
+            glDrawArrays(GL_LINE_STRIP, 0, GLsizei(span.size));
+        }
     }
 }
 
@@ -64,6 +74,11 @@ void removePlanet(PlanetsUniverse& universe, key_type planet) {
     universe.remove(planet);
 }
 
+/* Snapshot isn't bound, so drop what acquire returns. Anything JS wants from it goes through the camera and universe bindings. */
+void acquireSnapshot(SimulationRunner& runner) {
+    runner.acquire();
+}
+
 EMSCRIPTEN_BINDINGS(planets_universe) {
     emscripten::class_<PlanetsUniverse>("PlanetsUniverse")
             .constructor()
@@ -91,6 +106,8 @@ EMSCRIPTEN_BINDINGS(planets_universe) {
             .function("isEmpty",                &PlanetsUniverse::isEmpty)
             .function("isSelectedValid",        &PlanetsUniverse::isSelectedValid)
             .function("isValid",                &PlanetsUniverse::isValid)
+            .function("keyAt",                  &PlanetsUniverse::keyAt)
+            .function("indexOf",                &PlanetsUniverse::indexOf)
             .function("remove",                 &removePlanet)
             .function("resetSelected",          &PlanetsUniverse::resetSelected)
             .function("size",                   &PlanetsUniverse::size)
@@ -102,4 +119,11 @@ EMSCRIPTEN_BINDINGS(planets_universe) {
             .property("speed",                  &PlanetsUniverse::simulationSpeed)
             .property("stepsPerFrame",          &PlanetsUniverse::stepsPerFrame)
             ;
+    /* There are no threads here, so the runner steps the universe inline whenever update is called. */
+    emscripten::class_<SimulationRunner>("SimulationRunner")
+            .constructor<PlanetsUniverse&>()
+            .function("acquire",                &acquireSnapshot)
+            .function("setPaused",              &SimulationRunner::setPaused)
+            .function("update",                 &SimulationRunner::update)
+            ;
 }
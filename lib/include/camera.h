@@ -10,11 +10,18 @@ struct Ray {
 };
 
 class Camera {
-    PlanetsUniverse& universe;
+    /* Planets are read from the runner's current snapshot, and changes to selected and following are posted to it. */
+    SimulationRunner& runner;
 
     /* [0, 0, Width, Height] (in pixels). Used for unproject and anything else that wants width or height of the viewport. */
     glm::vec4 viewport;
 
+    /* The last planet follow() was called with, until it shows up in a snapshot. */
+    key_type followRequest = -1;
+
+    /* The origin of the last snapshot setup() saw, when the universe is rebased position moves with it. */
+    glm::dvec3 origin;
+
 public:
     enum FollowingState{
         FollowNone,
@@ -41,7 +48,7 @@ public:
     /* The final camera matrix with all transformations applied. Pass this to OpenGL. */
     glm::mat4 camera;
 
-    EXPORT Camera(PlanetsUniverse& universe);
+    EXPORT Camera(SimulationRunner& runner);
 
     /* Limit the rotation & distance of the camera. */
     EXPORT void bound();
@@ -60,6 +67,7 @@ public:
     EXPORT key_type selectUnder(const glm::ivec2& pos, float scale = 1.0f);
 
     /* Following state changing functions. */
+    EXPORT void follow(key_type key);
     EXPORT void followPrevious();
     EXPORT void followNext();
     EXPORT void followSelection();
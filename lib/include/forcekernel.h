@@ -0,0 +1,61 @@
+#pragma once
+
+#include "types.h"
+#include "threadpool.h"
+#include <vector>
+#include <glm/vec3.hpp>
+
+/* Direct pairwise gravity between every pair of bodies, using vector instructions where the CPU has them. */
+class ForceKernel {
+public:
+    /* Ordered from narrowest to widest, so anything up to the detected value can be used. */
+    enum InstructionSet {
+        Scalar,
+        SSE,
+        AVX2,
+        AVX512
+    };
+
+    /* The widest instruction set this CPU (and OS) supports, only actually checked the first time. */
+    EXPORT static InstructionSet detect();
+
+    EXPORT static const char* name(InstructionSet instructionSet);
+
+    /* Sum of mass * direction / distance^3 from every other body onto each body (no gravity constant applied), written to result.
+     * With Merging any pair of bodies that are overlapping are left out and added to merges instead (lower index first).
+     * Without it nothing is checked for overlap and merges isn't touched, only bodies at exactly the same position are left out.
+     * Instruction sets wider than what the CPU supports fall back to the widest available.
+     * Rows are split between the threads in the pool once there are enough bodies to be worth it. */
+    template<bool Merging>
+    EXPORT void accelerations(const glm::vec3* positions, const float* masses, const float* radii, size_t count,
+                              InstructionSet instructionSet, ThreadPool& pool, glm::vec3* result, pair_list& merges);
+
+    /* Sum of mass * direction / distance^3 from every body onto each of the tracers, which don't pull on anything themselves.
+     * Tracers inside a body are left out and added to contacts as (tracer, body) instead. The vector versions do several
+     * tracers at once against one body at a time, so there's no summing across lanes and no writing to the bodies. */
+    EXPORT void tracerAccelerations(const glm::vec3* tracers, size_t tracerCount, const glm::vec3* positions, const float* masses,
+                                    const float* radii, size_t count, InstructionSet instructionSet, ThreadPool& pool,
+                                    glm::vec3* result, pair_list& contacts);
+
+    /* Below this many bodies everything is done on the calling thread. */
+    constexpr static size_t parallelThreshold = 256;
+    /* How many rows a thread takes at a time. Rows get shorter towards the end, so this is kept small to even out the work. */
+    constexpr static size_t rowBlock = 16;
+    /* How many tracers a thread takes at a time, a multiple of the widest vector so only the last block has leftovers. */
+    constexpr static size_t tracerBlock = 256;
+
+private:
+    /* Positions are split into separate components so the vector loops can load several bodies at once. */
+    std::vector<float> x, y, z, m, r;
+
+    /* Every pair adds to both bodies, so each thread gets its own copy to add to and they're summed at the end. */
+    struct Accumulator {
+        std::vector<float> ax, ay, az;
+        pair_list merges;
+    };
+    std::vector<Accumulator> accumulators;
+
+    /* Tracer positions split up the same way, and the contacts each thread found. */
+    std::vector<float> tx, ty, tz, tax, tay, taz;
+    std::vector<pair_list> contactLists;
+};
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "types.h"
+#include <array>
+#include <vector>
+#include <functional>
+#include <glm/vec3.hpp>
+
+/* A 15th order Gauss-Radau integrator with its own step size control, the same scheme as IAS15.
+ * Each step fits a 7th degree polynomial in time to the accelerations at 8 points in the step, iterating until the fit stops
+ * changing, and the size of the highest term decides how long the next step can be. Fits are carried over to predict the
+ * next step, so it usually only needs a couple of iterations. Everything is double precision. */
+class GaussRadau {
+public:
+    typedef std::function<void(const std::vector<glm::dvec3>& positions, std::vector<glm::dvec3>& accelerations)> force_function;
+
+    /* Give up iterating a step after this many tries, and on shrinking a rejected step after this many. */
+    constexpr static int maximumIterations = 12;
+    constexpr static int maximumRejections = 20;
+
+    /* Move positions and velocities forward by time, taking as many steps as tolerance needs (the size of the highest
+     * term relative to the accelerations). forces fills accelerations for a set of positions and gets called 7 times per iteration. */
+    EXPORT void integrate(std::vector<glm::dvec3>& positions, std::vector<glm::dvec3>& velocities, double time, double tolerance,
+                          const force_function& forces);
+
+    /* Forget the step size and the fit from the last step, for when the bodies have changed. */
+    EXPORT void reset();
+
+    /* The step size the next step will try. 0 means it'll pick one. */
+    inline double stepSize() const { return step; }
+    /* Steps taken and iterations done since the last reset. */
+    inline uint64_t stepCount() const { return steps; }
+    inline uint64_t iterationCount() const { return iterations; }
+
+private:
+    /* The length of the next step, and of the last one that was taken. */
+    double step = 0.0, lastStep = 0.0;
+    uint64_t steps = 0, iterations = 0;
+
+    /* The polynomial's coefficients in powers of time (b) and in the Newton form through the nodes (g) for the current step,
+     * what b was predicted to be from the last step, and the last step's final b and how far off its prediction was. */
+    std::array<std::vector<glm::dvec3>, 7> b, g, predicted, fit, correction;
+
+    std::vector<glm::dvec3> startAcceleration, nodePositions, nodeAccelerations;
+
+    /* Fill predicted and b for a step ratio times as long as the last one. */
+    void predict(double ratio);
+
+    /* Take one step of dt, or less if the error is too big (but never less than minimum).
+     * Returns how long it actually was and sets next to how long the one after should be. */
+    double attempt(std::vector<glm::dvec3>& positions, std::vector<glm::dvec3>& velocities, double dt, double tolerance,
+                   double minimum, const force_function& forces, double& next);
+};
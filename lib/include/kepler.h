@@ -0,0 +1,18 @@
+#pragma once
+
+#include "types.h"
+#include <glm/vec3.hpp>
+
+/* Exact two body motion, for moving a body along its orbit in one go instead of integrating it step by step. */
+class Kepler {
+public:
+    /* Move position and velocity (relative to a fixed body with mu = gravity constant * mass) forward by time.
+     * Uses universal variables so circular, elliptical, parabolic and hyperbolic orbits all work the same.
+     * Returns false and leaves both alone if the solver didn't converge, which can only really happen for
+     * orbits that pass through the center. */
+    EXPORT static bool drift(glm::dvec3& position, glm::dvec3& velocity, double mu, double time);
+
+    /* The Stumpff functions c2(z) = (1 - cos(sqrt(z))) / z and c3(z) = (sqrt(z) - sin(sqrt(z))) / sqrt(z)^3,
+     * with the hyperbolic versions for negative z and a series near 0. */
+    EXPORT static void stumpff(double z, double& c2, double& c3);
+};
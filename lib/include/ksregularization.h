@@ -0,0 +1,20 @@
+#pragma once
+
+#include "types.h"
+#include <glm/vec3.hpp>
+
+/* Kustaanheimo-Stiefel regularization of two body motion. The relative position is written as the square of a 4D vector
+ * and time is stretched by the distance, which turns the 1 / distance^2 pull into a harmonic oscillator that can be
+ * integrated with even steps right through a close approach. */
+class KSRegularization {
+public:
+    /* Integration steps for each oscillation of the regularized coordinates, and the most that will be taken in one call. */
+    constexpr static int stepsPerOscillation = 128;
+    constexpr static int maximumSteps = 100000;
+
+    /* Move position and velocity (of one body relative to the other, with mu = gravity constant * total mass) forward by time,
+     * with perturbation added to the relative acceleration the whole way. closest is set to the shortest distance seen.
+     * Returns false and leaves everything alone if it couldn't get there in maximumSteps. */
+    EXPORT static bool drift(glm::dvec3& position, glm::dvec3& velocity, double mu, const glm::dvec3& perturbation, double time,
+                             double& closest);
+};
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "types.h"
+#include "threadpool.h"
+#include <vector>
+#include <glm/vec3.hpp>
+
+/* Sorts points along a Z-curve, so points near each other in space mostly end up near each other in the list.
+ * Each point gets a 64 bit Morton code (21 bits of each coordinate within the bounding box, interleaved) and the codes
+ * are radix sorted a byte at a time, with each thread counting and moving its own part of the list. */
+class MortonSort {
+public:
+    /* Fill order with the index of each point in Z-curve order, so order[0] is the index of the first point along the curve.
+     * Points with the same code stay in the order they were in. */
+    EXPORT void sort(const glm::vec3* positions, size_t count, ThreadPool& pool, std::vector<uint32_t>& order);
+
+    /* How many points a thread takes at least, below this everything is done on the calling thread. */
+    constexpr static size_t block = 4096;
+
+    /* How many bits of each coordinate go into a code. */
+    constexpr static int coordinateBits = 21;
+
+private:
+    /* The codes and which point they're for, plus a second set to move them into each pass. */
+    std::vector<uint64_t> codes, sortedCodes;
+    std::vector<uint32_t> indices, sortedIndices;
+
+    /* Each thread's bounding box, and how many of its codes have each value of the current byte,
+     * turned into where the first one goes. */
+    std::vector<glm::vec3> threadMinimums, threadMaximums;
+    std::vector<std::vector<size_t>> threadCounts;
+};
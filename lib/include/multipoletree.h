@@ -0,0 +1,146 @@
+#pragma once
+
+#include "types.h"
+#include "threadpool.h"
+#include <vector>
+#include <glm/vec3.hpp>
+
+/* A fast multipole solver. Every node of an octree gets a Cartesian multipole expansion of the bodies inside it,
+ * and pairs of nodes far enough apart are turned straight into local expansions of each other's field.
+ * Each body then only needs its own leaf's local expansion and its direct neighbours, so the work grows about linearly with count. */
+class MultipoleTree {
+public:
+    /* The highest expansion order that can be used, the number of terms grows with the cube of it. */
+    constexpr static int maximumOrder = 8;
+    /* How many bodies a node can hold before it gets split into octants. */
+    constexpr static uint32_t leafCapacity = 32;
+    /* Stop subdividing at this depth, so bodies at the same position can't recurse forever. */
+    constexpr static uint32_t maximumDepth = 32;
+    /* How many bodies measureError() checks against direct summation. */
+    constexpr static size_t errorSamples = 64;
+
+    /* Sum of mass * direction / distance^3 from every other body onto each body (no gravity constant applied), written to result.
+     * Expansions are kept up to order (1 to maximumOrder), and how close approximated nodes can get is picked from the order
+     * so the RMS relative error comes out around tolerance. With Merging any pair of bodies that are overlapping are left out
+     * and added to merges instead (lower index first), without it they pull like any other and merges isn't touched.
+     * Each level of the tree is split between the threads in the pool. */
+    template<bool Merging>
+    EXPORT void accelerations(const glm::vec3* bodies, const float* masses, const float* radii, size_t count,
+                              int order, float tolerance, ThreadPool& pool, glm::vec3* result, pair_list& merges);
+
+    /* RMS relative difference between result and direct summation, over an evenly spread sample of the bodies.
+     * Merging should match what result was worked out with, so the same overlapping pairs are left out. */
+    template<bool Merging>
+    EXPORT static double measureError(const glm::vec3* positions, const float* masses, const float* radii, size_t count,
+                                      const glm::vec3* result);
+
+    inline size_t nodeCount() const { return nodes.size(); }
+
+private:
+    struct Node {
+        /* The cube this node covers, used for splitting it up. */
+        glm::vec3 boxCenter;
+        float halfSize;
+
+        /* The center of mass, which is what the expansions are around, and how far from it the furthest body is. */
+        glm::dvec3 center;
+        double radius;
+        double mass;
+
+        /* Largest radius of any body inside, used to make sure approximated pairs can't contain a merge when merging. */
+        float maxRadius;
+
+        /* Range of the bodies list covered by this node. */
+        uint32_t first, count;
+
+        /* Children are stored next to each other, only octants that contain bodies get one. */
+        uint32_t firstChild, childCount;
+
+        uint32_t parent, depth;
+    };
+
+    std::vector<Node> nodes;
+
+    /* Node indices sorted by depth, with where each depth starts, so a whole level can be handed out to the threads at once. */
+    std::vector<uint32_t> levelNodes;
+    std::vector<uint32_t> levelStart;
+
+    /* Bodies copied into tree order with the components split up, so every node covers a contiguous range and the direct
+     * loops can be vectorized. original is where each came from. */
+    std::vector<float> x, y, z, m, r;
+    std::vector<uint32_t> original;
+    /* Scratch space for partitioning bodies into octants. */
+    std::vector<uint32_t> scratch;
+    std::vector<uint8_t> octants;
+
+    /* Expansion coefficients, terms() of them for each node. Multipoles are stored as the expansion of the bodies' offsets
+     * from the center negated, which is what turning them into locals needs, so that doesn't need any signs. */
+    std::vector<double> multipoles, locals;
+
+    /* Everything about the multi-indices (x, y, z powers) of one expansion order, rebuilt when the order changes. */
+    struct Term {
+        uint8_t x, y, z, degree;
+        /* This term with one less power on axis, and with two less (or the first term if there aren't two to take). */
+        uint32_t parent, grandparent;
+        uint8_t axis, parentPower;
+    };
+    /* One contribution from term a to term b through term c = b - a, used for shifting expansions between centers. */
+    struct Shift {
+        uint32_t a, b, c;
+    };
+
+    int order = -1;
+    std::vector<Term> termList;
+    std::vector<uint32_t> termLookup;
+    /* How many terms there are up to each degree. */
+    std::vector<uint32_t> degreeEnd;
+    std::vector<Shift> shifts;
+    /* Turning a multipole into a local, local term a gets multipole term b times derivative a + b, for each a + b within the order.
+     * Grouped by multipole term, conversionStart[b] is where its pairs start. Each one in a group adds to a different local term,
+     * so they don't have to wait on each other. */
+    std::vector<uint32_t> conversionStart;
+    std::vector<uint16_t> conversionLocal, conversionDerivative;
+
+    inline size_t terms() const { return termList.size(); }
+    inline uint32_t termIndex(int x, int y, int z) const {
+        return termLookup[(x * (maximumOrder + 1) + y) * (maximumOrder + 1) + z];
+    }
+
+    void setOrder(int newOrder);
+
+    /* d^n / n! for every term n. */
+    void monomials(const glm::dvec3& d, double* out) const;
+    /* Every partial derivative of 1 / |r|, up to the order. */
+    void derivatives(const glm::dvec3& r, double* out) const;
+
+    /* Interaction lists built by walking pairs of nodes, far pairs get converted and near pairs are done directly. */
+    typedef std::vector<std::pair<uint32_t, uint32_t>> node_pairs;
+    struct Interactions {
+        node_pairs far, near;
+        /* Pairs that were left for later to split the walk between threads. */
+        node_pairs deferred;
+    };
+    std::vector<Interactions> threadInteractions;
+
+    /* The combined lists, grouped by target node. */
+    std::vector<uint32_t> farStart, farSources, nearStart, nearSources;
+
+    /* Each thread finds its own merges, they get combined at the end. */
+    std::vector<pair_list> threadMerges;
+
+    /* Only valid while building. */
+    const glm::vec3* positions = nullptr;
+
+    void build(const float* masses, const float* radii, size_t count);
+    void subdivide(uint32_t node, uint32_t depth);
+
+    /* Work out the center, radius, and multipole expansion of a node whose children are already done. */
+    void upward(uint32_t node);
+
+    /* Walk a pair of nodes (or a node with itself when a == b). Past deferDepth the pair is put off into deferred. */
+    template<bool Merging> void interact(uint32_t a, uint32_t b, double theta, uint32_t depth, uint32_t deferDepth, Interactions& out) const;
+
+    /* Combine each thread's interaction lists into lists grouped by target node. */
+    static void group(const std::vector<Interactions>& lists, node_pairs Interactions::* member, size_t nodeCount,
+                      std::vector<uint32_t>& start, std::vector<uint32_t>& sources);
+};
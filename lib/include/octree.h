@@ -0,0 +1,59 @@
+#pragma once
+
+#include "types.h"
+#include <vector>
+#include <glm/vec3.hpp>
+
+/* A Barnes-Hut octree, rebuilt from scratch every time the planets move. */
+class Octree {
+public:
+    /* How many bodies a node can hold before it gets split into octants. */
+    constexpr static uint32_t leafCapacity = 8;
+    /* Stop subdividing at this depth, so bodies at the same position can't recurse forever. */
+    constexpr static uint32_t maximumDepth = 32;
+
+    /* Rebuild the tree around the provided bodies. The arrays must stay valid until the next build. */
+    EXPORT void build(const glm::vec3* positions, const float* masses, const float* radii, size_t count);
+
+    /* Sum of mass * direction / distance^3 from every other body onto the body at index (no gravity constant applied).
+     * Nodes that pass the opening angle test are treated as a single point mass, anything closer is done pairwise.
+     * With Merging any body overlapping this one is skipped and the pair is added to merges (only once per pair, lower index first).
+     * Without it overlapping bodies pull like any other and merges isn't touched. */
+    template<bool Merging> EXPORT glm::vec3 acceleration(size_t index, float openingAngle, pair_list& merges) const;
+
+    inline size_t nodeCount() const { return nodes.size(); }
+
+private:
+    struct Node {
+        /* The cube this node covers. */
+        glm::vec3 center;
+        float halfSize;
+
+        /* Combined mass of all bodies inside, and the weighted average of their positions. */
+        glm::vec3 centerOfMass;
+        float mass;
+
+        /* Largest radius of any body inside, used to make sure approximated nodes can't contain a merge when merging. */
+        float maxRadius;
+
+        /* Range of the bodies list covered by this node. */
+        uint32_t first, count;
+
+        /* Children are stored next to each other, only octants that contain bodies get one. */
+        uint32_t firstChild, childCount;
+    };
+
+    std::vector<Node> nodes;
+
+    /* Body indices, ordered so that every node covers a contiguous range. */
+    std::vector<uint32_t> bodies;
+    /* Scratch space for partitioning bodies into octants. */
+    std::vector<uint32_t> scratch;
+    std::vector<uint8_t> octants;
+
+    const glm::vec3* positions = nullptr;
+    const float* masses = nullptr;
+    const float* radii = nullptr;
+
+    void subdivide(uint32_t node, uint32_t depth);
+};
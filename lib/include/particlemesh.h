@@ -0,0 +1,80 @@
+#pragma once
+
+#include "types.h"
+#include "threadpool.h"
+#include <vector>
+#include <complex>
+#include <glm/vec3.hpp>
+
+/* A particle-mesh solver. Mass is spread over a grid with cloud-in-cell weights, the potential comes from convolving it
+ * with 1 / distance using FFTs, and each body picks up the gradient from the grid cells around it.
+ * The grid is padded to twice its size so bodies don't feel copies of each other like they would in a periodic box.
+ * Forces between bodies closer than a couple of cells are smoothed out by the grid, so it's meant for large diffuse clouds
+ * where the bulk motion matters more than close encounters. */
+class ParticleMesh {
+public:
+    /* The range of grid sizes (cells along each side) that can be used, only powers of two in between. */
+    constexpr static uint32_t minimumSize = 8;
+    constexpr static uint32_t maximumSize = 256;
+    /* How far (in cells) the short range correction reaches. Past this the grid is close enough to the real thing. */
+    constexpr static float correctionRange = 3.0f;
+
+    /* Sum of mass * direction / distance^3 on each body from the grid (no gravity constant applied), written to result.
+     * size is rounded down to a power of two. When correct is set pairs closer than correctionRange cells get the difference
+     * between the direct force and the grid's version of it added, and with Merging any pair of bodies that are overlapping
+     * are added to merges (lower index first) and only get the grid's force from each other. Without correct nothing is merged. */
+    template<bool Merging>
+    EXPORT void accelerations(const glm::vec3* positions, const float* masses, const float* radii, size_t count,
+                              uint32_t size, bool correct, ThreadPool& pool, glm::vec3* result, pair_list& merges);
+
+private:
+    typedef std::complex<float> complex_type;
+
+    /* Cells along each side of the bodies' grid, and of the padded one the transforms run on. */
+    uint32_t size = 0, padded = 0;
+
+    /* The corners of the box around the bodies and how big each cell is, picked every call so the grid just covers them. */
+    glm::vec3 lower, upper;
+    float spacing = 1.0f;
+
+    /* The padded grid, holds the density and then the potential. */
+    std::vector<complex_type> grid;
+    /* Transform of the 1 / distance kernel for a spacing of 1, which is real since the kernel is symmetric.
+     * Includes the scale for the inverse transform. Only changes with size. */
+    std::vector<float> kernel;
+    /* exp(-2 pi i k / padded) for the first half of k, followed by the same for the inverse transform. */
+    std::vector<complex_type> twiddles;
+    /* Somewhere for each thread to copy one line of the grid into. */
+    std::vector<std::vector<complex_type>> lines;
+
+    /* Acceleration at each cell of the unpadded grid, one array per axis. */
+    std::vector<float> fieldX, fieldY, fieldZ;
+
+    /* Bodies sorted into buckets correctionRange cells wide for finding close pairs. */
+    uint32_t buckets[3];
+    float bucketSize = 1.0f;
+    std::vector<uint32_t> bucketStart, bucketBodies, bucketOf;
+
+    std::vector<pair_list> threadMerges;
+
+    /* Reallocate everything for a new grid size and transform the kernel. */
+    void resize(uint32_t newSize, ThreadPool& pool);
+
+    /* In-place FFT of every line along axis, only for lines whose other coordinates are under the limits. */
+    void transformAxis(int axis, uint32_t limitA, uint32_t limitB, bool inverse, ThreadPool& pool);
+    void transform(complex_type* line, bool inverse) const;
+
+    void deposit(const glm::vec3* positions, const float* masses, size_t count);
+    void gradient(ThreadPool& pool);
+
+    void fillBuckets(const glm::vec3* positions, size_t count, float reach);
+
+    /* Add the direct force minus the grid's version of it from every body within range of body i, finding merges with Merging. */
+    template<bool Merging>
+    void correction(const glm::vec3* positions, const float* masses, const float* radii, size_t i,
+                    glm::vec3& acceleration, pair_list& merges) const;
+
+    /* How strong the grid's pull is between two unit masses some distance apart (both in cells), averaged over where
+     * in their cells they are. Tabulated once since it doesn't depend on the grid size. */
+    static float meshForce(float distance);
+};
@@ -4,7 +4,11 @@
 #include <glm/mat4x4.hpp>
 
 class PlacingInterface {
-    PlanetsUniverse &universe;
+    /* The selected planet is read from the runner's current snapshot, new planets are posted to it. */
+    SimulationRunner& runner;
+
+    /* The origin of the snapshot planet was last placed in, see followOrigin(). */
+    glm::dvec3 origin;
 
 public:
     enum PlacingStep{
@@ -44,7 +48,11 @@ public:
     EXPORT void beginInteractiveCreation();
     EXPORT void beginOrbitalCreation();
 
-    EXPORT PlacingInterface(PlanetsUniverse& universe);
+    EXPORT PlacingInterface(SimulationRunner& runner);
+
+    /* Move planet along with the universe if it's been rebased since the last call. The other functions do this themselves,
+     * call it after acquiring a new snapshot so the planet being placed is drawn in the right place. */
+    EXPORT void followOrigin();
 
     EXPORT glm::mat4 getOrbitalCircleMat();
     EXPORT glm::mat4 getOrbitedCircleMat();
@@ -1,7 +1,6 @@
 #pragma once
 
 #include "types.h"
-#include <vector>
 #include <glm/vec3.hpp>
 
 class Planet {
@@ -15,13 +14,8 @@ public:
     glm::vec3 position;
     glm::vec3 velocity;
 
-    std::vector<glm::vec3> path;
-
     uint8_t materialID;
 
-    /* Add a point to the path if the planet is specified distance (in units squared) from the last point. */
-    void updatePath(size_t pathLength, float pathRecordDistance);
-
     /* Automatically set based on planet mass. */
     inline float radius() const { return radius_p; }
 
@@ -29,4 +23,34 @@ public:
     EXPORT void setMass(const float& m);
 
     inline float mass() const { return mass_p; }
+
+    /* The radius of a planet with the given mass. */
+    EXPORT static float radiusFromMass(const float& m);
+};
+
+/* A planet living inside a PlanetsUniverse. The data is spread out over the universe's arrays,
+ * this just holds references to it so it can be used (mostly) like a Planet. Don't keep one around after adding or removing planets. */
+class PlanetRef {
+private:
+    float& mass_p;
+    float& radius_p;
+
+public:
+    PlanetRef(glm::vec3& p, glm::vec3& v, float& m, float& r, uint8_t& mat)
+        : mass_p(m), radius_p(r), position(p), velocity(v), materialID(mat) {}
+
+    glm::vec3& position;
+    glm::vec3& velocity;
+
+    uint8_t& materialID;
+
+    inline float radius() const { return radius_p; }
+
+    /* Set the planet's mass and update the radius. */
+    inline void setMass(const float& m) { mass_p = m; radius_p = Planet::radiusFromMass(m); }
+
+    inline float mass() const { return mass_p; }
+
+    /* Make a standalone copy of the planet. */
+    EXPORT operator Planet() const;
 };
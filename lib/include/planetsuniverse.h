@@ -1,25 +1,320 @@
 #pragma once
 
 #include "types.h"
+#include "planet.h"
+#include "octree.h"
+#include "multipoletree.h"
+#include "particlemesh.h"
+#include "forcekernel.h"
+#include "threadpool.h"
+#include "trailarena.h"
+#include "stepcontroller.h"
+#include "gaussradau.h"
+#include "ksregularization.h"
+#include "spatialhash.h"
+#include "mortonsort.h"
 #include <map>
 #include <random>
 #include <string>
+#include <iterator>
+#include <stdexcept>
 #include <glm/mat4x4.hpp>
 
-#ifdef EMSCRIPTEN
-#include "planet.h"
-#endif
-
 class PlanetsUniverse {
 public:
-    typedef std::vector<Planet> list_type;
-    typedef list_type::iterator iterator;
-    typedef list_type::const_iterator const_iterator;
+    typedef std::vector<glm::vec3>::size_type size_type;
+
+    /* Walks over the planets in storage order, giving a PlanetRef for each. */
+    class iterator {
+        PlanetsUniverse* universe;
+        size_t index;
+
+    public:
+        typedef std::random_access_iterator_tag iterator_category;
+        typedef PlanetRef value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef void pointer;
+        typedef PlanetRef reference;
+
+        iterator(PlanetsUniverse* u, size_t i) : universe(u), index(i) {}
+
+        inline PlanetRef operator * () const { return universe->refAt(index); }
+        inline key_type key() const { return universe->keyAt(index); }
+
+        inline iterator& operator ++ () { ++index; return *this; }
+        inline iterator& operator -- () { --index; return *this; }
+        inline iterator operator + (std::ptrdiff_t n) const { return iterator(universe, index + n); }
+        inline iterator operator - (std::ptrdiff_t n) const { return iterator(universe, index - n); }
+        inline std::ptrdiff_t operator - (const iterator& other) const { return std::ptrdiff_t(index) - std::ptrdiff_t(other.index); }
+
+        inline bool operator == (const iterator& other) const { return index == other.index; }
+        inline bool operator != (const iterator& other) const { return index != other.index; }
+        inline bool operator < (const iterator& other) const { return index < other.index; }
+    };
 
     std::mt19937 generator;
 
+    /* Which method is used to calculate gravity between planets. */
+    enum GravitySolver {
+        DirectSum,
+        BarnesHut,
+        FastMultipole,
+        /* Forces come from a grid instead of other planets, only really meant for big clouds of planets. */
+        ParticleMeshFFT
+    };
+
+    /* How positions and velocities are moved forward each step. */
+    enum Integrator {
+        /* Semi-implicit Euler, one force calculation per step but only first order. */
+        Euler,
+        /* Kick-drift-kick leapfrog, second order and time reversible. Still about one force calculation per step. */
+        Leapfrog,
+        /* Yoshida's 4th order symplectic method, three force calculations per step. */
+        Yoshida4,
+        /* Wisdom-Holman map, orbits around the heaviest planet are followed exactly and only the pull between the others is
+         * integrated, so steps can be much longer when one planet dominates. Falls back to leapfrog when none does, or when
+         * two of the others are close enough that their pull on each other rivals the central planet's. */
+        WisdomHolman,
+        /* 4th order Hermite where each planet gets its own step, the step length divided by a power of two picked from how
+         * fast its acceleration is changing. Only planets whose step is up get their forces recalculated, the rest are
+         * predicted from their last ones. Always uses direct summation. */
+        BlockTimesteps,
+        /* 15th order Gauss-Radau (IAS15), picks its own steps to keep the error under gaussRadauTolerance so stepsPerFrame
+         * only limits how long they can be. Everything is done in double precision with direct summation, meant for
+         * long runs of small systems where accuracy matters more than speed. */
+        IAS15,
+        /* Leapfrog, except planets on bound orbits around a much heavier planet, with little else pulling on them, follow that
+         * orbit exactly between kicks. Like Wisdom-Holman but with any number of central planets, and planets that don't fit
+         * just get integrated normally instead of everything falling back to leapfrog. */
+        KeplerLeapfrog
+    };
+
+    /* What the Euler, leapfrog, and Yoshida integrators keep positions and velocities in between steps. The others always
+     * use float, except IAS15 which always uses double. */
+    enum Precision {
+        /* Everything in float, the fastest. */
+        Single,
+        /* Positions, velocities, and forces all in double. Forces always come from direct summation, and close pairs
+         * aren't regularized since that's only done in float. */
+        Double,
+        /* Positions and velocities in double, forces from the gravity solver in float. Most of the precision is lost adding
+         * small steps to big coordinates, which this avoids at about the same cost as float. */
+        Mixed
+    };
+
 private:
-    list_type planets;
+    /* Planet data is stored as separate arrays so the physics loops only touch what they need.
+     * Everything at the same index belongs to the same planet, and there are never any gaps. */
+    std::vector<key_type> keys;
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> velocities;
+    std::vector<float> masses;
+    std::vector<float> radii;
+    std::vector<uint8_t> materials;
+
+    /* Trails are indexed by slot rather than by index, so they stay put when planets move around in the list. */
+    TrailArena trails;
+
+    /* Keys point at a slot, which holds where the planet currently is in the arrays.
+     * When a planet is removed its slot's generation goes up, so any keys still pointing at it are no longer valid. */
+    struct Slot {
+        uint32_t index;
+        uint32_t generation;
+    };
+    std::vector<Slot> slots;
+    std::vector<uint32_t> freeSlots;
+
+    constexpr static uint32_t emptySlot = ~uint32_t(0);
+
+    /* Give the planet at index a new key. */
+    key_type allocateKey(size_t index);
+    /* Mark a key as no longer in use. */
+    void releaseKey(key_type key);
+
+    /* The Barnes-Hut tree, kept around so it doesn't get reallocated every step. */
+    Octree octree;
+    MultipoleTree multipoleTree;
+    ParticleMesh particleMesh;
+
+    /* Set at the start of each advance so the first fast multipole calculation gets checked against direct summation. */
+    bool measureMultipole = false;
+    double multipoleError_p = 0.0;
+
+    ForceKernel forceKernel;
+
+    /* Sum of mass * direction / distance^3 on each planet, without the gravity constant. */
+    std::vector<glm::vec3> accelerations;
+    /* Whether accelerations still match the current positions, so leapfrog can skip recalculating them. */
+    bool accelerationsValid = false;
+
+    /* Workers for the force calculations, kept for as long as the universe exists. */
+    ThreadPool threadPool;
+
+    /* Planets found touching during a step, merged once the step is done. */
+    pair_list merges;
+    /* Finds touching planets at the end of each step when hashCollisions is on. */
+    SpatialHash spatialHash;
+    /* Puts the planets in Z-curve order every sortInterval steps, and the order it came up with last time. */
+    MortonSort mortonSort;
+    std::vector<uint32_t> mortonOrder;
+    int stepsSinceSort = 0;
+
+    /* Each thread finds its own merges, they get combined before being resolved. */
+    std::vector<pair_list> threadMerges;
+
+    /* Do a single step of the given length with the current integrator, then merge anything that ended up touching if
+     * Merging is set. Tracers are only moved if Tracers is set, the caller has to check there are some. */
+    template<bool Merging, bool Tracers> void step(float time);
+
+    /* Do steps of the given length, then add to the trails if Paths is set. advance() picks the version to use based on
+     * mergePlanets, recordPaths, and whether there are any tracers, so none of those get checked while stepping. */
+    template<bool Merging, bool Paths, bool Tracers> void advanceSteps(int steps, float time);
+
+    /* Whether the trails were recorded the last time, so they can be cleared when recording stops. */
+    bool pathsRecorded = true;
+
+    glm::dvec3 origin_p;
+
+    /* Move the planets, tracers, and trails back towards the origin if they've drifted further than rebaseDistance. */
+    void rebase();
+
+    /* Fill accelerations using the current solver, adding any touching planets to merges if Merging is set.
+     * The version without it picks from mergePlanets, so the solvers' loops never check it. */
+    void computeAccelerations();
+    template<bool Merging> void computeAccelerations();
+
+    /* Positions and velocities relative to the central planet during a Wisdom-Holman step. */
+    std::vector<glm::dvec3> relativePositions, relativeVelocities;
+
+    /* Block timestep state for each planet, the acceleration and jerk (without the gravity constant) at its last update,
+     * when that was and how many times its step has been halved, and where it's predicted to be at the current time. */
+    std::vector<glm::vec3> jerks, predictedPositions, predictedVelocities;
+    std::vector<uint64_t> lastTicks;
+    std::vector<uint32_t> levels;
+    /* Which planets are being updated at the current time, and their new forces, kept separate until they've all been worked out. */
+    std::vector<uint32_t> activePlanets;
+    std::vector<glm::vec3> activeAccelerations, activeJerks;
+
+    /* Double precision copies of the planets for the Gauss-Radau integrator and the double and mixed precision modes, so the
+     * extra precision isn't lost between steps. Any planet whose float values don't match anymore gets reloaded from them. */
+    std::vector<glm::dvec3> precisePositions, preciseVelocities;
+    /* Accelerations with the gravity constant in double precision, only kept up to date in double precision mode. */
+    std::vector<glm::dvec3> preciseForces;
+    /* Whether the last step kept the double precision copies up to date, so merging and sorting should keep them that way. */
+    bool preciseValid = false;
+    GaussRadau gaussRadau;
+
+    /* Make the double precision copies match the planets. Returns true if any planets had to be reloaded. */
+    bool loadPrecise();
+    /* Fill preciseForces with direct summation from precisePositions, and accelerations from them. */
+    void computePreciseAccelerations();
+
+    /* Do one Euler, leapfrog, or Yoshida step with positions and velocities in the given precision. */
+    template<Precision P> void fixedStep(float time);
+
+    /* Do one step with the Gauss-Radau integrator, which takes as many steps of its own as it needs. */
+    void gaussRadauStep(float time);
+    /* Direct sum accelerations (with the gravity constant) in double precision, adding any touching planets to merges if Merging
+     * is set. The version without it picks from mergePlanets. */
+    void preciseAccelerations(const std::vector<glm::dvec3>& positions, std::vector<glm::dvec3>& result);
+    template<bool Merging> void preciseAccelerations(const std::vector<glm::dvec3>& positions, std::vector<glm::dvec3>& result);
+
+    /* Body force calculations done in the last advance, one per planet per calculation for the shared step integrators. */
+    uint64_t forceEvaluations_p = 0;
+
+    /* Do one step where each planet takes as many smaller steps as it needs. */
+    void blockStep(float time);
+    /* Acceleration and jerk on planet i from the predicted positions and velocities of every other planet, adding any touching
+     * planets to merges if Merging is set. */
+    template<bool Merging> void blockForce(size_t i, glm::vec3& acceleration, glm::vec3& jerk, pair_list& merges) const;
+
+    /* Do a Wisdom-Holman step if there's a dominant planet and no close encounters, otherwise return false without changing anything. */
+    bool wisdomHolmanStep(float time);
+    /* Kick everything but central with just the pull from other non-central planets.
+     * Returns false without kicking if that pull is more than closeEncounterRatio of the central pull for any of them. */
+    bool perturbationKick(size_t central, float time, bool checkEncounters);
+
+    /* The planet each planet is orbiting for the Kepler leapfrog, noPlanet for planets being integrated normally.
+     * Planets that are orbiting something never have anything orbiting them. */
+    std::vector<uint32_t> primaries;
+    /* Heaviest planets first, the ones that could be orbited. */
+    std::vector<uint32_t> primaryCandidates;
+
+    /* In primaries or partners, not pointing at any planet. */
+    constexpr static uint32_t noPlanet = ~uint32_t(0);
+
+    /* Pairs of planets close enough to be regularized during a leapfrog step (lower index first), and each planet's partner
+     * in one of them. A planet is never in more than one pair, planets are only paired up if they're each other's closest. */
+    pair_list closePairs;
+    std::vector<uint32_t> partners;
+    /* Planets sorted by the lowest x they could reach a partner at for finding close pairs, with a copy of their positions
+     * and how far they could reach in that order. */
+    std::vector<uint32_t> sweepOrder;
+    std::vector<float> sweepReach;
+    std::vector<glm::vec4> sweepPoints;
+    std::vector<float> partnerDistances;
+
+    /* Fill closePairs and partners with planets that come within regularizationRange of each other during a step of time,
+     * closer than the step can handle. */
+    void findClosePairs(float time);
+    /* Kick everything, planets in a close pair both get the pair's average acceleration so the pull between them cancels out. */
+    void regularizedKick(float time);
+    /* Move close pairs' centers of mass in a straight line and their relative motion with KS regularization, the rest normally. */
+    void regularizedDrift(float time);
+
+    /* Do one Kepler leapfrog step. */
+    void keplerStep(float time);
+    /* Fill primaries from the current positions, velocities, and accelerations. */
+    void findPrimaries();
+    /* Kick everything, leaving out the pull of each orbiting planet's primary which the drift already covers. */
+    void keplerKick(float time);
+    /* Move orbiting planets along their orbits relative to their primaries, and everything else in a straight line. */
+    void keplerDrift(float time);
+
+    /* Apply accelerations to velocities, and velocities to positions. In double or mixed precision the double precision
+     * copies are what's moved, and the planets get set from them. */
+    template<Precision P = Single> void kick(float time);
+    template<Precision P = Single> void drift(float time);
+
+    /* Tracers feel the planets' gravity but don't pull on anything themselves, so each one only costs a pass over the planets.
+     * Stored the same way as the planets, but without keys since nothing ever needs to find a particular one. */
+    std::vector<glm::vec3> tracerPositions, tracerVelocities, tracerAccelerations;
+    /* Where each tracer was at the start of the last advance, for drawing. */
+    std::vector<glm::vec3> tracerStarts;
+    bool tracerAccelerationsValid = false;
+    /* Tracers inside a planet as of the last force calculation, as (tracer, planet). */
+    pair_list tracerContacts;
+
+    /* Fill tracerAccelerations (without the gravity constant) from the planets' current positions.
+     * Tracers that are inside a planet get removed if tracerMerging is on. */
+    void computeTracerAccelerations();
+    /* Tracers take a leapfrog step alongside each step of the planets, since nothing they do affects the planets they can
+     * get the first half kick and drift out of the way first, and the second half kick once the planets have moved. */
+    void startTracers(float time);
+    void finishTracers(float time);
+
+    /* Where each planet ends up when resolving merges or deleting, its own index if it stays. */
+    std::vector<size_t> targets;
+
+    /* Which planets are having others merged into them while resolving merges, and their total mass in double precision
+     * when there are double precision copies to merge. */
+    std::vector<bool> merging;
+    std::vector<double> preciseMasses;
+
+    /* Merge everything in the merges list, planets touching several others are all merged together into one keeping the
+     * total momentum and the mass weighted average position. Returns false if there was nothing to merge. */
+    bool resolveMerges();
+
+    /* Remove every planet whose target isn't itself in a single pass, moving the rest down to fill the gaps.
+     * Selected and following move to the target of the planet they were on, targets must be planets that stay or -1. */
+    void compact();
+
+    /* Add a point to the trail of every planet that is far enough from its last point, or move the last point. */
+    void updatePaths();
+
+    inline PlanetRef refAt(size_t index) {
+        return PlanetRef(positions[index], velocities[index], masses[index], radii[index], materials[index]);
+    }
 
 public:
     /* The factor for apparent velocity.
@@ -30,8 +325,33 @@ public:
     constexpr static float minimumMass = 1.0f;
     constexpr static float maximumMass = 1.0e9f;
 
+    /* Keys have the slot in the low bits and the generation in the high bits, 32 bits total so they fit in a JavaScript number. */
+    constexpr static uint32_t slotBits = 22;
+    constexpr static uint32_t slotMask = (1u << slotBits) - 1;
+    constexpr static uint32_t generationMask = (1u << (32 - slotBits)) - 1;
+
+    /* Planets' block timesteps are never shorter than the step length divided by 2 to the power of this. */
+    constexpr static uint32_t maximumBlockLevel = 24;
+
+    /* The Wisdom-Holman integrator only treats the heaviest planet as the center if it's this many times heavier than the next. */
+    constexpr static float dominantMassRatio = 4.0f;
+    /* A planet is in a close encounter when the others pull on it more than this fraction of the central planet's pull. */
+    constexpr static float closeEncounterRatio = 0.1f;
+    /* Close pairs are only regularized when the step is longer than this fraction of sqrt(distance^3 / (G * total mass)),
+     * roughly how long their orbit takes to turn by a radian at that distance. Any shorter and leapfrog handles them fine. */
+    constexpr static float regularizationStepRatio = 0.01f;
+    /* How many of the heaviest planets the Kepler leapfrog considers as things to orbit. */
+    constexpr static size_t maximumPrimaries = 16;
+
+    /* Trails are sampled once per call to advance, no matter how many steps that does. Changing the length clears them. */
     std::vector<glm::vec3>::size_type pathLength = 200;
     float pathRecordDistance = 0.25f;
+    /* Trails are cleared and stop being recorded while this is off, for when they aren't being drawn. */
+    bool recordPaths = true;
+
+    /* Every trail, some may be empty. Trail number is the key's slot, see trailOf(). */
+    inline const TrailArena& getTrails() const { return trails; }
+    inline TrailArena::Spans trailOf(const key_type& key) const { return trails.spans(key & slotMask); }
 
     key_type selected = -1, following = -1;
 
@@ -39,13 +359,81 @@ public:
     float simulationSpeed = 1.0f;
     /* How many sub-steps to perform per frame for better accuracy. */
     int stepsPerFrame = 20;
+    /* When enabled, adds steps on top of stepsPerFrame while there's time for them, or slows down the simulation if
+     * even stepsPerFrame steps take too long. Check it after advance() to see what it decided. */
+    StepController stepController;
+
+    GravitySolver gravitySolver = DirectSum;
+    Integrator integrator = Euler;
+    Precision precision = Single;
+    /* How small a node in the Barnes-Hut tree has to look before it's treated as a single mass.
+     * (Node size / distance, larger values are faster and less accurate.) */
+    float openingAngle = 0.5f;
+    /* Highest term kept in the fast multipole expansions (1 to MultipoleTree::maximumOrder), higher is slower and more accurate. */
+    int multipoleOrder = 4;
+    /* The RMS relative force error the fast multipole solver aims for, check multipoleError() for what it actually got. */
+    float multipoleTolerance = 0.002f;
+    /* Cells along each side of the particle mesh grid, rounded down to a power of two. */
+    int meshSize = 32;
+    /* Add the real force back in for planets within a few cells of each other. Without it nothing ever merges. */
+    bool meshCorrection = true;
+    /* How short block timesteps are compared to how fast each planet's acceleration is changing, smaller is more accurate. */
+    float blockAccuracy = 0.02f;
+    /* How big the highest order term of the Gauss-Radau integrator can be compared to the accelerations, smaller is more accurate. */
+    float gaussRadauTolerance = 1.0e-9f;
+    /* Pairs of planets that come within this many times the distance they'd touch at during a leapfrog step have their
+     * relative motion regularized, so close passes stay accurate without shorter steps. 0 turns it off. */
+    float regularizationRange = 10.0f;
+
+    /* Merge planets that touch. With this off everything passes through everything else, and only gravity is simulated. */
+    bool mergePlanets = true;
+
+    /* Look for touching planets with a spatial hash at the end of every step, as well as whatever the gravity solver finds
+     * along the way. Solvers that approximate close planets can miss them otherwise, and without its correction the particle
+     * mesh never finds any. */
+    bool hashCollisions = true;
+
+    /* How many steps between putting the planets back in Z-curve order, so planets near each other in space are near each
+     * other in memory for the tree solvers and the spatial hash. 0 leaves them in the order they were added. Never done
+     * with IAS15, which would have to start its predictions over every time. */
+    int sortInterval = 16;
+
+    /* When the followed planet, or the weighted average position if nothing valid is being followed, gets further than this
+     * from the origin everything gets moved so it's back on it. Floats lose precision far from zero, which makes steps less
+     * accurate and trails jittery. 0 turns it off. */
+    float rebaseDistance = 1.0e4f;
+
+    /* How far everything has been moved by rebasing in total. Adding it to a position gives where it would be without any. */
+    inline const glm::dvec3& origin() const { return origin_p; }
+
+    /* Tracers that hit a planet disappear into it, otherwise they pass through without feeling it. They have no mass, so
+     * the planet doesn't change either way. */
+    bool tracerMerging = true;
+
+    /* Vector instructions used by the direct sum solver, defaults to the widest the CPU supports. */
+    ForceKernel::InstructionSet instructionSet = ForceKernel::detect();
+
+    /* How many threads are used to calculate forces (including the one calling advance), 0 uses all hardware threads. */
+    inline void setThreadCount(unsigned int count) { threadPool.setThreadCount(count); }
+    inline unsigned int threadCount() const { return threadPool.threadCount(); }
+
+    /* RMS relative force error of the fast multipole solver on a sample of planets, measured once per advance. */
+    inline double multipoleError() const { return multipoleError_p; }
+    /* How many times a force on a single planet was calculated during the last advance. */
+    inline uint64_t forceEvaluations() const { return forceEvaluations_p; }
 
     /* Make new planets. */
-    inline key_type addPlanet(const Planet& planet) { planets.push_back(planet); return planets.size() - 1; }
+    EXPORT key_type addPlanet(const Planet& planet);
     EXPORT void generateRandom(const size_t& count, const float& positionRange, const float& maxVelocity, const float& maxMass);
-    EXPORT key_type addOrbital(Planet& around, const float& radius, const float& mass, const glm::mat4& plane);
+    EXPORT key_type addOrbital(key_type around, const float& radius, const float& mass, const glm::mat4& plane);
     EXPORT void generateRandomOrbital(const size_t& count, key_type target);
 
+    /* Make new tracers, see tracerPositions. Orbital tracers go in circular orbits around target, all in the same plane and
+     * direction so they make a disk. */
+    EXPORT void addTracer(const glm::vec3& position, const glm::vec3& velocity);
+    EXPORT void generateRandomTracers(const size_t& count, const float& positionRange, const float& maxVelocity);
+    EXPORT void generateRandomOrbitalTracers(const size_t& count, key_type target);
+
 #ifndef EMSCRIPTEN
     /* Load and save from an XML file. Sets error string and returns false on an error. */
     EXPORT void save(const std::string& filename);
@@ -57,16 +445,31 @@ public:
     /* Advance the universe by the specified amount of time. */
     EXPORT void advance(float time);
 
-    inline bool isEmpty() const { return planets.size() == 0; }
-    /* As size_t is unsigned, any keys less than the universe size are valid and any others are not. */
-    inline bool isValid(const key_type& key) const { return key < planets.size(); }
-    inline Planet& operator [] (const key_type& key) { return planets.at(key); }
-    EXPORT iterator remove(const key_type key, const key_type replacement = -1);
+    /* Copy the planets, trails, and settings into snapshot, reusing its memory. */
+    EXPORT void writeSnapshot(Snapshot& snapshot) const;
+
+    inline bool isEmpty() const { return positions.size() == 0; }
+    /* Keys stay valid until their planet is removed or merged into another. */
+    inline bool isValid(const key_type& key) const {
+        const key_type slot = key & slotMask;
+        return slot < slots.size() && slots[slot].index != emptySlot && (key >> slotBits) == slots[slot].generation;
+    }
+    inline PlanetRef operator [] (const key_type& key) {
+        if (!isValid(key)) throw std::out_of_range("Invalid planet key!");
+        return refAt(indexOf(key));
+    }
+    /* Remove a planet, anything selecting or following it moves to replacement. The last planet takes its place in the list. */
+    EXPORT void remove(const key_type key, const key_type replacement = -1);
+
+    /* Convert between keys and where the planet currently is in the list (0 to size() - 1).
+     * Indices change whenever planets are removed, so only keep keys around. */
+    inline size_t indexOf(const key_type& key) const { return slots[key & slotMask].index; }
+    inline key_type keyAt(const size_t& index) const { return keys[index]; }
 
     /* Is a planet selected? */
     inline bool isSelectedValid() const { return isValid(selected); }
     /* Get the currently selected planet. Don't call without checking for validity first. */
-    inline Planet& getSelected() { return planets[selected]; }
+    inline PlanetRef getSelected() { return refAt(indexOf(selected)); }
     /* Deselect the currently selected planet. */
     inline void resetSelected() { selected = -1; }
 
@@ -74,11 +477,10 @@ public:
     EXPORT key_type getRandomPlanet();
 
     /* Iterators and stuff. */
-    inline iterator begin() { return planets.begin(); }
-    inline iterator end() { return planets.end(); }
-    inline const_iterator cbegin() const { return planets.cbegin(); }
-    inline const_iterator cend() const { return planets.cend(); }
-    inline list_type::size_type size() const { return planets.size(); }
+    inline iterator begin() { return iterator(this, 0); }
+    inline iterator end() { return iterator(this, positions.size()); }
+    inline size_type size() const { return positions.size(); }
+    inline size_type tracerCount() const { return tracerPositions.size(); }
 
     inline void randSeed(unsigned int seed) { generator.seed(seed); }
 
@@ -86,8 +488,15 @@ public:
      * After this if all the planets merged into one it would be stationary at the origin. */
     EXPORT void centerAll();
 
+    /* Put the planets in Z-curve order now. Keys stay the same, only indices change. */
+    EXPORT void sortPlanets();
+
+    /* Kinetic plus potential energy of everything, summed in double precision. Goes through every pair so it's slow. */
+    EXPORT double totalEnergy() const;
+
     /* Functions for destroying stuff. */
-    inline void deleteAll() { planets.clear(); resetSelected(); }
+    EXPORT void deleteAll();
     EXPORT void deleteEscapees();
+    EXPORT void deleteTracers();
     inline void deleteSelected() { if (isSelectedValid()) remove(selected); }
 };
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "types.h"
+#include "snapshot.h"
+#include "triplebuffer.h"
+#include <vector>
+#include <functional>
+
+#ifndef EMSCRIPTEN
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#endif
+
+/* Steps a universe on its own thread at a fixed rate, so drawing a frame and simulating one don't have to wait on each other.
+ * After every step a snapshot is published, which the renderer picks up with acquire() without ever blocking.
+ * Anything that changes the universe is posted as a command and gets run between steps.
+ * Until start() is called (and always in Emscripten builds) there is no thread, update() does the work on the calling thread instead. */
+class SimulationRunner {
+public:
+    /* Gets run with the universe, on the simulation thread if there is one. */
+    typedef std::function<void(PlanetsUniverse& universe)> command_type;
+
+    EXPORT explicit SimulationRunner(PlanetsUniverse& universe);
+    EXPORT ~SimulationRunner();
+
+    SimulationRunner(const SimulationRunner&) = delete;
+    SimulationRunner& operator = (const SimulationRunner&) = delete;
+
+    /* How much time the thread passes to advance() each step, in microseconds. It also waits this long between steps,
+     * so the simulation keeps up with real time unless steps take longer than this. Only change while stopped. */
+    float timestep = 1.0e6f / 60.0f;
+
+    /* How far past the newest snapshot drawing may guess when the next one is late, in steps. 0 holds still on the newest one. */
+    float maximumExtrapolation = 0.5f;
+
+    /* Start or stop the simulation thread. Stopping waits for the current step to finish. */
+    EXPORT void start();
+    EXPORT void stop();
+    EXPORT bool isRunning() const;
+
+    /* While paused commands still get run, the universe just doesn't advance. */
+    EXPORT void setPaused(bool paused);
+
+    /* Queue a change to the universe, it's done before the next step. Without a thread it's done right away. */
+    EXPORT void post(const command_type& command);
+
+    /* Post a command that sets a single setting of the universe. */
+    template <typename T> inline void set(T PlanetsUniverse::* setting, const T& value) {
+        post([setting, value](PlanetsUniverse& universe) { universe.*setting = value; });
+    }
+
+    /* Like post() but waits until the command has been done, any exception it throws gets thrown again here. */
+    EXPORT void execute(const command_type& command);
+
+    /* Without a thread, advance the universe by time (unless paused) and publish a snapshot. Does nothing while the thread is running. */
+    EXPORT void update(float time);
+
+    /* Switch to the newest snapshot if there is one, and work out the blend to draw it with for this frame.
+     * Only one thread should call this, and the snapshot stays put until it does again. */
+    EXPORT const Snapshot& acquire();
+    /* The snapshot last picked up by acquire(). */
+    inline const Snapshot& current() const { return snapshots.readBuffer(); }
+
+    /* How far from previousPositions to positions to draw the current snapshot, as of the last acquire().
+     * Drawing stays one step behind the simulation, so that it's between two known states rather than guessing ahead. */
+    inline float blend() const { return blend_p; }
+
+private:
+    PlanetsUniverse& universe;
+
+    TripleBuffer<Snapshot> snapshots;
+
+    /* How many times the universe has been advanced, only touched by whichever thread is doing the stepping. */
+    uint64_t frames = 0;
+
+    float blend_p = 1.0f;
+
+    /* Where every planet was before the last step, by key slot. Keeps the key too so a reused slot isn't mistaken for the same planet. */
+    std::vector<key_type> previousKeys;
+    std::vector<glm::vec3> previousPositions;
+    /* The universe's origin when they were stored, if it's been rebased since they have to move with it. */
+    glm::dvec3 previousOrigin;
+
+    /* Timing of the last step for the snapshots, see Snapshot::time and Snapshot::interval. */
+    double stepTime = 0.0;
+    float stepInterval = 0.0f;
+
+    /* Store every planet's position before stepping. */
+    void rememberPositions();
+
+    /* Copy the universe into the write buffer and hand it to the reader. */
+    void publish();
+
+#ifndef EMSCRIPTEN
+    std::thread thread;
+
+    std::atomic<bool> paused;
+
+    std::mutex mutex;
+    /* Woken when there's a new command or it's time to stop. */
+    std::condition_variable wake;
+    /* Woken when a command from execute() is done. */
+    std::condition_variable finished;
+
+    /* Posted commands waiting for the thread, swapped out in one go so posting never waits on a command. */
+    std::vector<command_type> commands;
+    bool stopping = false;
+
+    void loop();
+#else
+    bool paused = false;
+#endif
+};
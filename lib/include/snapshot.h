@@ -0,0 +1,105 @@
+#pragma once
+
+#include "types.h"
+#include "planet.h"
+#include "planetsuniverse.h"
+#include <vector>
+#include <glm/vec3.hpp>
+
+/* A copy of everything needed to draw and show the universe at one point in time, filled by PlanetsUniverse::writeSnapshot().
+ * Nothing in here changes while it's being read, so it can be used while the simulation keeps going on another thread. */
+class Snapshot {
+public:
+    /* Same layout as the arrays in PlanetsUniverse, everything at the same index belongs to the same planet. */
+    std::vector<key_type> keys;
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> velocities;
+    std::vector<float> masses;
+    std::vector<float> radii;
+    std::vector<uint8_t> materials;
+
+    /* Where each planet was before the last step, so drawing can go smoothly from there to positions. */
+    std::vector<glm::vec3> previousPositions;
+
+    /* Tracers, and where each one was before the last step. */
+    std::vector<glm::vec3> tracerPositions;
+    std::vector<glm::vec3> previousTracerPositions;
+
+    /* Where the planet using each key slot is, or emptySlot. */
+    std::vector<uint32_t> slots;
+    constexpr static uint32_t emptySlot = ~uint32_t(0);
+
+    TrailArena trails;
+
+    key_type selected = -1, following = -1;
+
+    /* The universe's settings when the snapshot was taken, for showing in the UI. */
+    float simulationSpeed = 1.0f;
+    int stepsPerFrame = 20;
+    PlanetsUniverse::GravitySolver gravitySolver = PlanetsUniverse::DirectSum;
+    PlanetsUniverse::Integrator integrator = PlanetsUniverse::Euler;
+    PlanetsUniverse::Precision precision = PlanetsUniverse::Single;
+    float openingAngle = 0.5f;
+    int multipoleOrder = 4;
+    float multipoleTolerance = 0.002f;
+    double multipoleError = 0.0;
+    int meshSize = 32;
+    bool meshCorrection = true;
+    float blockAccuracy = 0.02f;
+    float gaussRadauTolerance = 1.0e-9f;
+    float regularizationRange = 10.0f;
+    bool tracerMerging = true;
+    bool mergePlanets = true;
+    bool hashCollisions = true;
+    int sortInterval = 16;
+    float rebaseDistance = 1.0e4f;
+    size_t pathLength = 200;
+    bool recordPaths = true;
+    float pathRecordDistance = 0.25f;
+    unsigned int threadCount = 1;
+    StepController stepController;
+
+    /* How far the universe had been rebased when this was taken, see PlanetsUniverse::origin(). Anything that keeps positions
+     * between frames should move them by the change in this so they stay in the same place relative to the planets. */
+    glm::dvec3 origin;
+
+    /* How many times the universe had been advanced when this was taken. */
+    uint64_t frame = 0;
+
+    /* When the last step finished and how long it took to get from previousPositions to positions, both in microseconds.
+     * An interval of 0 means there is nothing to blend between and positions should be drawn as they are. */
+    double time = 0.0;
+    float interval = 0.0f;
+
+    inline size_t size() const { return positions.size(); }
+    inline bool isEmpty() const { return positions.empty(); }
+
+    inline bool isValid(const key_type& key) const {
+        const key_type slot = key & PlanetsUniverse::slotMask;
+        return slot < slots.size() && slots[slot] != emptySlot && keys[slots[slot]] == key;
+    }
+    inline size_t indexOf(const key_type& key) const { return slots[key & PlanetsUniverse::slotMask]; }
+
+    inline bool isSelectedValid() const { return isValid(selected); }
+    /* Don't call without checking for validity first. */
+    inline Planet getSelected(float blend = 1.0f) const { return planetAt(indexOf(selected), blend); }
+
+    /* The material of the planet at index, planets without a valid one get one picked from their key so it stays the same every frame. */
+    inline uint8_t materialAt(size_t index, uint8_t materialCount) const {
+        return materials[index] < materialCount ? materials[index] : uint8_t(keys[index] % materialCount);
+    }
+
+    /* Where the planet at index is, blend of the way from its previous position to its current one. Blend can go past 1 to extrapolate. */
+    inline glm::vec3 positionAt(size_t index, float blend) const {
+        return previousPositions[index] + (positions[index] - previousPositions[index]) * blend;
+    }
+
+    inline glm::vec3 tracerPositionAt(size_t index, float blend) const {
+        return previousTracerPositions[index] + (tracerPositions[index] - previousTracerPositions[index]) * blend;
+    }
+
+    /* Make a standalone copy of the planet at index, with its position blended like positionAt(). */
+    EXPORT Planet planetAt(size_t index, float blend = 1.0f) const;
+
+    inline TrailArena::Spans trailOf(const key_type& key) const { return trails.spans(key & PlanetsUniverse::slotMask); }
+};
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "types.h"
+#include "threadpool.h"
+#include <vector>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+/* Finds every pair of overlapping bodies without going through every pair, so merging doesn't depend on the gravity solver.
+ * Bodies go in a grid of cells at least as wide as they are, with a separate grid for every power of two so one big body
+ * doesn't make the cells huge for everything else. Cells are hashed into a table, so empty space costs nothing. */
+class SpatialHash {
+public:
+    /* Add every pair of bodies closer than the sum of their radii to overlaps, lower index first.
+     * The table is only rebuilt if a body changed cells since the last call, the lookups are split between the threads in the pool. */
+    EXPORT void overlaps(const glm::vec3* positions, const float* radii, size_t count, ThreadPool& pool, pair_list& overlaps);
+
+    /* How many bodies a thread takes at a time. */
+    constexpr static size_t block = 256;
+
+private:
+    /* Which cell of which grid a body is in, cells in level n are 2^n wide. */
+    struct Cell {
+        int64_t x, y, z;
+        int32_t level;
+
+        inline bool operator == (const Cell& other) const {
+            return x == other.x && y == other.y && z == other.z && level == other.level;
+        }
+        inline bool operator != (const Cell& other) const { return !(*this == other); }
+    };
+
+    /* Each body's cell as of the last call, and this call. */
+    std::vector<Cell> cells, newCells;
+
+    /* Bodies sorted by which bucket of the table their cell hashed to, where each bucket starts in that list, and the mask
+     * to turn a hash into a bucket. The table always has at least twice as many buckets as bodies. */
+    std::vector<uint32_t> entries, bucketStarts;
+    size_t bucketMask = 0;
+
+    /* The full hash of each body's cell by index, and in table order along with the body's position and radius. */
+    std::vector<uint64_t> cellHashes, entryHashes;
+    std::vector<glm::vec4> entryPoints;
+
+    /* Every level with a body in it, lowest first, and one over the size of its cells. */
+    std::vector<int32_t> levels;
+    std::vector<double> levelScales;
+
+    std::vector<pair_list> threadOverlaps;
+
+    /* Sort the bodies into the table by their cells. */
+    void rebuild(size_t count);
+};
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "types.h"
+
+/* Picks how many steps to do each frame so the simulation doesn't take longer than a set amount of time.
+ * Steps are never made longer than the minimum count would make them, when there isn't time for that many the
+ * simulation runs slower than real time instead. */
+class StepController {
+public:
+    /* Off by default, which means always doing exactly the minimum number of steps. */
+    bool enabled = false;
+
+    /* How long the steps in a frame should take in total, in milliseconds. */
+    double budget = 12.0;
+
+    /* Never do more than this many steps in a frame, no matter how cheap they are. */
+    int maximumSteps = 4000;
+
+    /* How many steps to do this frame, minimumSteps being what keeps the steps short enough to be accurate.
+     * Also updates timeScale() to match. */
+    EXPORT int plan(int minimumSteps);
+
+    /* Tell the controller how long the steps it planned took. */
+    EXPORT void measure(int steps, double milliseconds);
+
+    /* Forget any measurements, for when the cost of a step is going to be completely different. */
+    EXPORT void reset();
+
+    /* The steps picked for the last frame. */
+    inline int steps() const { return steps_p; }
+    /* How much of the requested time the last frame actually simulated, 1 unless there wasn't time for enough steps. */
+    inline float timeScale() const { return timeScale_p; }
+    /* Smoothed time taken by a single step in milliseconds, 0 if nothing has been measured yet. */
+    inline double stepCost() const { return stepCost_p; }
+
+    /* Whether the last frame had to slow down the simulation to stay within budget. */
+    inline bool isSlowed() const { return timeScale_p < 1.0f; }
+
+private:
+    int steps_p = 0;
+    float timeScale_p = 1.0f;
+    double stepCost_p = 0.0;
+};
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "types.h"
+#include <functional>
+
+#ifndef EMSCRIPTEN
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#endif
+
+/* A set of worker threads that stick around between jobs, so starting a parallel loop is just a wakeup.
+ * Emscripten builds don't have threads, everything just runs on the calling thread. */
+class ThreadPool {
+public:
+    /* Gets called once on every thread with that thread's index. */
+    typedef std::function<void(unsigned int thread)> job_type;
+    /* Gets called with a range of indices to do and the index of the thread doing them. */
+    typedef std::function<void(size_t begin, size_t end, unsigned int thread)> range_job_type;
+
+    /* A count of 0 uses one thread per hardware thread. */
+    EXPORT explicit ThreadPool(unsigned int count = 0);
+    EXPORT ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator = (const ThreadPool&) = delete;
+
+    /* How many threads the CPU can run at once, never less than 1. */
+    EXPORT static unsigned int hardwareThreads();
+
+    /* Change how many threads are used, including the calling thread. 0 uses one per hardware thread.
+     * Can't be called while a job is running. */
+    EXPORT void setThreadCount(unsigned int count);
+
+    /* The total number of threads jobs are run on, including the calling thread. */
+    EXPORT unsigned int threadCount() const;
+
+    /* Call job on every thread, the calling thread is always index 0. Returns once all of them are done.
+     * Jobs can't start other jobs on the same pool. */
+    EXPORT void run(const job_type& job);
+
+    /* Split 0 to count into blocks of blockSize, handed out to whichever thread is free next.
+     * Small ranges that are only a single block just run on the calling thread. */
+    EXPORT void parallelFor(size_t count, size_t blockSize, const range_job_type& job);
+
+#ifndef EMSCRIPTEN
+private:
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable wake, done;
+
+    /* The job currently running, each new one gets a new generation so workers know it's one they haven't done. */
+    const job_type* job = nullptr;
+    uint64_t generation = 0;
+    /* How many workers haven't finished the current job. */
+    size_t remaining = 0;
+    bool stopping = false;
+
+    void stop();
+    void worker(unsigned int index, uint64_t seen);
+#endif
+};
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "types.h"
+#include <vector>
+#include <glm/vec3.hpp>
+
+/* Every planet's trail in one block of memory, each one a fixed size ring buffer.
+ * Adding a point never moves anything else, once the ring is full the oldest point gets overwritten. */
+class TrailArena {
+public:
+    /* A run of points that are next to each other in memory, ready to be drawn as a line strip. */
+    struct Span {
+        const glm::vec3* data;
+        size_t size;
+    };
+
+    /* A trail is at most two spans, oldest points first. When the ring has wrapped the first span ends with
+     * a copy of the point the second one starts with, so drawing both as line strips leaves no gap. */
+    struct Spans {
+        Span first, second;
+    };
+
+    /* Drop every trail and change how many points each one holds. */
+    EXPORT void reset(size_t capacity);
+
+    /* Change how many trails there are, any new ones start out empty. */
+    EXPORT void resizeTrails(size_t count);
+
+    inline size_t capacity() const { return capacity_p; }
+    inline size_t trailCount() const { return starts.size(); }
+
+    /* How many points are in a trail. */
+    inline size_t size(size_t trail) const { return counts[trail]; }
+
+    /* Point index of a trail, counting from the oldest. */
+    inline const glm::vec3& at(size_t trail, size_t index) const {
+        return points[trail * stride() + (starts[trail] + index) % capacity_p];
+    }
+
+    inline void clear(size_t trail) { starts[trail] = counts[trail] = 0; }
+    EXPORT void clearAll();
+
+    /* Move every point of every trail by offset. */
+    EXPORT void translate(const glm::vec3& offset);
+
+    /* Add a point to the end of a trail, dropping the oldest one if it's full. */
+    EXPORT void push(size_t trail, const glm::vec3& point);
+    /* Move the newest point of a (non-empty) trail. */
+    EXPORT void setLast(size_t trail, const glm::vec3& point);
+
+    EXPORT Spans spans(size_t trail) const;
+
+private:
+    size_t capacity_p = 0;
+
+    /* Each trail gets one extra point past the end of its ring, which always matches the first point in the ring. */
+    inline size_t stride() const { return capacity_p + 1; }
+
+    std::vector<glm::vec3> points;
+
+    /* Where in its ring each trail's oldest point is, and how many points it has. */
+    std::vector<uint32_t> starts, counts;
+
+    void write(size_t trail, size_t position, const glm::vec3& point);
+};
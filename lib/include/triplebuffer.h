@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+/* Three copies of a value, so one thread can keep writing new versions while another reads the newest finished one.
+ * Neither side ever waits for the other, the writer just swaps its copy with whichever one the reader isn't using.
+ * Only meant for a single writer thread and a single reader thread. */
+template <typename T> class TripleBuffer {
+    T buffers[3];
+
+    /* The copy that's been handed off but not yet picked up, with freshBit set if the writer has put something new in it. */
+    std::atomic<uint8_t> middle;
+
+    /* Only touched by the writer and the reader respectively. */
+    uint8_t back = 0;
+    uint8_t front = 2;
+
+    constexpr static uint8_t indexMask = 3;
+    constexpr static uint8_t freshBit = 4;
+
+public:
+    TripleBuffer() : middle(1) {}
+
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator = (const TripleBuffer&) = delete;
+
+    /* The copy the writer is free to change. It may hold anything from an older version, so overwrite all of it. */
+    inline T& writeBuffer() { return buffers[back]; }
+
+    /* Hand the write buffer over to the reader, replacing anything it hasn't picked up yet. */
+    inline void publish() {
+        back = middle.exchange(back | freshBit, std::memory_order_acq_rel) & indexMask;
+    }
+
+    /* Switch the read buffer to the newest published copy, returns false (and keeps the old one) if nothing new has been published. */
+    inline bool acquire() {
+        if (!(middle.load(std::memory_order_relaxed) & freshBit))
+            return false;
+
+        front = middle.exchange(front, std::memory_order_acq_rel) & indexMask;
+        return true;
+    }
+
+    /* The copy the reader is using, nothing else touches it until the next acquire(). */
+    inline const T& readBuffer() const { return buffers[front]; }
+};
@@ -3,10 +3,17 @@
 #include "platform.h"
 #include <cstddef>
 #include <cstdint>
+#include <vector>
+#include <utility>
 
 typedef size_t key_type;
 
+/* Indices of pairs of planets that are touching and need to be merged, lower index first. */
+typedef std::vector<std::pair<size_t, size_t>> pair_list;
+
 class Camera;
+class Snapshot;
 class Planet;
 class PlanetsUniverse;
 class PlacingInterface;
+class SimulationRunner;
@@ -1,12 +1,13 @@
 #include "camera.h"
 #include "planet.h"
 #include "planetsuniverse.h"
+#include "simulationrunner.h"
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/transform.hpp>
 #include <glm/gtx/norm.hpp>
 
-Camera::Camera(PlanetsUniverse& u) : universe(u) {
+Camera::Camera(SimulationRunner& r) : runner(r) {
     reset();
 }
 
@@ -37,30 +38,47 @@ void Camera::resizeViewport(const float& width, const float& height) {
 }
 
 const glm::mat4& Camera::setup() {
+    const Snapshot& snapshot = runner.current();
+    /* Follow planets where they're drawn, not where the simulation has them. */
+    const float blend = runner.blend();
+
+    /* Keep looking at the same spot when everything gets moved back to the origin. */
+    if (snapshot.origin != origin) {
+        position -= glm::vec3(snapshot.origin - origin);
+        origin = snapshot.origin;
+    }
+
     /* If universe is empty following is useless. */
-    if (!universe.isEmpty()) {
+    if (!snapshot.isEmpty()) {
         switch (followingState) {
-        case Single:
-            if (universe.isValid(universe.following))
-                position = universe[universe.following].position;
+        case Single: {
+            /* Snapshots keep having the old target until the runner gets to the change. */
+            if (snapshot.following == followRequest)
+                followRequest = -1;
+
+            const key_type target = followRequest != key_type(-1) ? followRequest : snapshot.following;
+
+            if (snapshot.isValid(target))
+                position = snapshot.positionAt(snapshot.indexOf(target), blend);
             else
                 /* If the following target is invalid, reset following state. */
                 followingState = FollowNone;
             break;
+        }
         case PlainAverage:
             position = glm::vec3();
-            for (const auto& i : universe)
-                position += i.position;
+            for (size_t i = 0; i < snapshot.size(); ++i)
+                position += snapshot.positionAt(i, blend);
 
-            position /= universe.size();
+            position /= snapshot.size();
             break;
         case WeightedAverage:
             position = glm::vec3();
             float totalMass = 0.0f;
 
-            for (const auto& i : universe) {
-                position += i.position * i.mass();
-                totalMass += i.mass();
+            for (size_t i = 0; i < snapshot.size(); ++i) {
+                position += snapshot.positionAt(i, blend) * snapshot.masses[i];
+                totalMass += snapshot.masses[i];
             }
             position /= totalMass;
             break;
@@ -103,7 +121,9 @@ Ray Camera::getRay(const glm::ivec2& pos, float startDepth, float endDepth) cons
 }
 
 key_type Camera::selectUnder(const glm::ivec2& pos, float scale) {
-    universe.resetSelected();
+    const Snapshot& snapshot = runner.current();
+
+    key_type selected = -1;
     float nearest = std::numeric_limits<float>::max();
 
     /* Square the scale value, because we need it squared later. */
@@ -112,9 +132,9 @@ key_type Camera::selectUnder(const glm::ivec2& pos, float scale) {
     Ray ray = getRay(pos);
 
     /* Go through each planet and see if the ray intersects it. */
-    for (int i = 0; i < universe.size(); ++i) {
+    for (size_t i = 0; i < snapshot.size(); ++i) {
         /* Find the directional vector from the ray origin to the planet. */
-        glm::vec3 difference = universe[i].position - ray.origin;
+        glm::vec3 difference = snapshot.positionAt(i, runner.blend()) - ray.origin;
 
         float dot = glm::dot(difference, ray.direction);
 
@@ -123,37 +143,58 @@ key_type Camera::selectUnder(const glm::ivec2& pos, float scale) {
 
         /* distance^2 - dot^2 is the closest the ray gets to the planet's center point.
          * Comparing to the planet radius tells whether or not it intersects. */
-        if (distance < nearest && (distance2 - dot * dot) <= (universe[i].radius() * universe[i].radius() * scale)) {
-            universe.selected = i;
+        if (distance < nearest && (distance2 - dot * dot) <= (snapshot.radii[i] * snapshot.radii[i] * scale)) {
+            selected = snapshot.keys[i];
             nearest = distance2;
         }
     }
 
-	return universe.selected;
+    runner.post([selected](PlanetsUniverse& universe) { universe.selected = selected; });
+
+    return selected;
+}
+
+void Camera::follow(key_type key) {
+    followRequest = key;
+    runner.post([key](PlanetsUniverse& universe) { universe.following = key; });
+
+    /* This may already be set, but set it anyway in case it isn't. */
+    followingState = Single;
 }
 
 void Camera::clearFollow() {
-    universe.following = -1;
+    followRequest = -1;
+    runner.post([](PlanetsUniverse& universe) { universe.following = -1; });
     followingState = FollowNone;
 }
 
 void Camera::followNext() {
-    if (universe.isValid(++universe.following) || universe.isValid(universe.following = 0))
-        /* This may already be set, but set it anyway in case it isn't. */
-        followingState = Single;
+    const Snapshot& snapshot = runner.current();
+
+    if (!snapshot.isEmpty()) {
+        /* Go to the next planet in the list, wrapping around to the start (or starting there if nothing is being followed). */
+        const key_type current = followRequest != key_type(-1) ? followRequest : snapshot.following;
+        size_t index = snapshot.isValid(current) ? snapshot.indexOf(current) + 1 : 0;
+        follow(snapshot.keys[index < snapshot.size() ? index : 0]);
+    }
 }
 
 void Camera::followPrevious() {
-    if (universe.isValid(--universe.following) || universe.isValid(universe.following = universe.size() - 1))
-        /* This may already be set, but set it anyway in case it isn't. */
-        followingState = Single;
+    const Snapshot& snapshot = runner.current();
+
+    if (!snapshot.isEmpty()) {
+        /* Go to the previous planet in the list, wrapping around to the end (or starting there if nothing is being followed). */
+        const key_type current = followRequest != key_type(-1) ? followRequest : snapshot.following;
+        size_t index = snapshot.isValid(current) ? snapshot.indexOf(current) : 0;
+        follow(snapshot.keys[index > 0 ? index - 1 : snapshot.size() - 1]);
+    }
 }
 
 void Camera::followSelection() {
-    if (universe.isSelectedValid()) {
-        universe.following = universe.selected;
-        followingState = Single;
-    }
+    const Snapshot& snapshot = runner.current();
+
+    if (snapshot.isSelectedValid())
+        follow(snapshot.selected);
 }
 
 glm::ivec2 Camera::getCenterScreen() const {
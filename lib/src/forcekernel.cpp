@@ -0,0 +1,646 @@
+#include "forcekernel.h"
+#include <algorithm>
+#include <atomic>
+
+/* Vector versions only exist for x86, everything else (including Emscripten) just gets the scalar loop. */
+#if !defined(EMSCRIPTEN) && (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86))
+#define PLANETS3D_X86
+
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+/* MSVC lets any function use any intrinsic. */
+#define TARGET(x)
+#else
+/* GCC and Clang need each function marked with what it uses, so the rest of the library can still run on anything. */
+#define TARGET(x) __attribute__((target(x)))
+#endif
+#endif
+
+namespace {
+
+/* Pointers to the split up arrays, passed to whichever version of the loop is being used. */
+struct Bodies {
+    const float* x;
+    const float* y;
+    const float* z;
+    const float* m;
+    const float* r;
+    float* ax;
+    float* ay;
+    float* az;
+    size_t count;
+};
+
+/* Basically the Quake method, tweaked for as much performance as I could get. */
+inline float fastInverseSqrt(float x) {
+    float halfx = x * 0.5f;
+    int32_t& i = reinterpret_cast<int32_t&>(x);
+    i = 0x5f3759df - (i >> 1);
+    return x*(1.5f - halfx*x*x);
+}
+
+/* A single pair, used for the whole scalar loop and for leftovers that don't fill a full vector.
+ * Without Merging only bodies at exactly the same position are left out, since there's no direction to pull them in. */
+template<bool Merging> inline void pair(const Bodies& b, size_t i, size_t j, float& axi, float& ayi, float& azi, pair_list& merges) {
+    float dx = b.x[j] - b.x[i];
+    float dy = b.y[j] - b.y[i];
+    float dz = b.z[j] - b.z[i];
+    float distance2 = dx * dx + dy * dy + dz * dz;
+
+    if (Merging) {
+        float touching = b.r[i] + b.r[j];
+
+        if (distance2 < touching * touching) {
+            merges.push_back(std::make_pair(i, j));
+            return;
+        }
+    } else if (distance2 == 0.0f) {
+        return;
+    }
+
+    float inverse = fastInverseSqrt(distance2);
+    float force = inverse * inverse * inverse;
+
+    axi += force * b.m[j] * dx;
+    ayi += force * b.m[j] * dy;
+    azi += force * b.m[j] * dz;
+
+    b.ax[j] -= force * b.m[i] * dx;
+    b.ay[j] -= force * b.m[i] * dy;
+    b.az[j] -= force * b.m[i] * dz;
+}
+
+/* Add every lane set in mask to the merge list, lanes are offset from first. */
+inline void addMerges(unsigned int mask, size_t i, size_t first, pair_list& merges) {
+    for (size_t lane = 0; mask != 0; ++lane, mask >>= 1)
+        if (mask & 1)
+            merges.push_back(std::make_pair(i, first + lane));
+}
+
+/* Every version of the loop does rows first to last, adding to both bodies of each pair. Merges are only looked for with Merging. */
+typedef void (*sweep_function)(const Bodies& b, size_t first, size_t last, pair_list& merges);
+
+template<bool Merging> void sweepScalar(const Bodies& b, size_t first, size_t last, pair_list& merges) {
+    for (size_t i = first; i < last; ++i) {
+        float axi = 0.0f, ayi = 0.0f, azi = 0.0f;
+
+        /* Each pair only needs to be done once, the other body gets the opposite force. */
+        for (size_t j = i + 1; j < b.count; ++j)
+            pair<Merging>(b, i, j, axi, ayi, azi, merges);
+
+        b.ax[i] += axi;
+        b.ay[i] += ayi;
+        b.az[i] += azi;
+    }
+}
+
+/* Tracers split into components with somewhere to put their accelerations, and the bodies pulling on them. */
+struct Tracers {
+    const float* x;
+    const float* y;
+    const float* z;
+    float* ax;
+    float* ay;
+    float* az;
+    Bodies bodies;
+};
+
+/* Add every lane set in mask to the contact list, lanes are tracers offset from first. */
+inline void addContacts(unsigned int mask, size_t first, size_t j, pair_list& contacts) {
+    for (size_t lane = 0; mask != 0; ++lane, mask >>= 1)
+        if (mask & 1)
+            contacts.push_back(std::make_pair(first + lane, j));
+}
+
+/* Every version does tracers first to last against all of the bodies, overwriting their accelerations. */
+typedef void (*tracer_function)(const Tracers& t, size_t first, size_t last, pair_list& contacts);
+
+void tracersScalar(const Tracers& t, size_t first, size_t last, pair_list& contacts) {
+    const Bodies& b = t.bodies;
+
+    for (size_t i = first; i < last; ++i) {
+        float ax = 0.0f, ay = 0.0f, az = 0.0f;
+
+        for (size_t j = 0; j < b.count; ++j) {
+            float dx = b.x[j] - t.x[i];
+            float dy = b.y[j] - t.y[i];
+            float dz = b.z[j] - t.z[i];
+            float distance2 = dx * dx + dy * dy + dz * dz;
+
+            if (distance2 < b.r[j] * b.r[j]) {
+                contacts.push_back(std::make_pair(i, j));
+                continue;
+            }
+
+            float inverse = fastInverseSqrt(distance2);
+            float force = inverse * inverse * inverse * b.m[j];
+
+            ax += force * dx;
+            ay += force * dy;
+            az += force * dz;
+        }
+
+        t.ax[i] = ax;
+        t.ay[i] = ay;
+        t.az[i] = az;
+    }
+}
+
+#ifdef PLANETS3D_X86
+
+template<bool Merging> TARGET("sse2") void sweepSSE(const Bodies& b, size_t first, size_t last, pair_list& merges) {
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 threeHalves = _mm_set1_ps(1.5f);
+
+    for (size_t i = first; i < last; ++i) {
+        const __m128 xi = _mm_set1_ps(b.x[i]), yi = _mm_set1_ps(b.y[i]), zi = _mm_set1_ps(b.z[i]);
+        const __m128 mi = _mm_set1_ps(b.m[i]), ri = _mm_set1_ps(b.r[i]);
+
+        __m128 axi = _mm_setzero_ps(), ayi = _mm_setzero_ps(), azi = _mm_setzero_ps();
+
+        size_t j = i + 1;
+        for (; j + 4 <= b.count; j += 4) {
+            __m128 dx = _mm_sub_ps(_mm_loadu_ps(b.x + j), xi);
+            __m128 dy = _mm_sub_ps(_mm_loadu_ps(b.y + j), yi);
+            __m128 dz = _mm_sub_ps(_mm_loadu_ps(b.z + j), zi);
+            __m128 distance2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+            /* Touching pairs get no force, they're merged after the sweep instead. Without merging only bodies at the same
+             * position are left out, their estimate is infinite. */
+            __m128 skip;
+            if (Merging) {
+                __m128 touching = _mm_add_ps(ri, _mm_loadu_ps(b.r + j));
+                skip = _mm_cmplt_ps(distance2, _mm_mul_ps(touching, touching));
+            } else {
+                skip = _mm_cmpeq_ps(distance2, _mm_setzero_ps());
+            }
+
+            /* Hardware estimate plus one Newton-Raphson step. */
+            __m128 inverse = _mm_rsqrt_ps(distance2);
+            inverse = _mm_mul_ps(inverse, _mm_sub_ps(threeHalves, _mm_mul_ps(_mm_mul_ps(half, distance2), _mm_mul_ps(inverse, inverse))));
+
+            __m128 force = _mm_andnot_ps(skip, _mm_mul_ps(inverse, _mm_mul_ps(inverse, inverse)));
+
+            __m128 fj = _mm_mul_ps(force, _mm_loadu_ps(b.m + j));
+            axi = _mm_add_ps(axi, _mm_mul_ps(fj, dx));
+            ayi = _mm_add_ps(ayi, _mm_mul_ps(fj, dy));
+            azi = _mm_add_ps(azi, _mm_mul_ps(fj, dz));
+
+            __m128 fi = _mm_mul_ps(force, mi);
+            _mm_storeu_ps(b.ax + j, _mm_sub_ps(_mm_loadu_ps(b.ax + j), _mm_mul_ps(fi, dx)));
+            _mm_storeu_ps(b.ay + j, _mm_sub_ps(_mm_loadu_ps(b.ay + j), _mm_mul_ps(fi, dy)));
+            _mm_storeu_ps(b.az + j, _mm_sub_ps(_mm_loadu_ps(b.az + j), _mm_mul_ps(fi, dz)));
+
+            if (Merging)
+                addMerges(unsigned(_mm_movemask_ps(skip)), i, j, merges);
+        }
+
+        float sum[3][4];
+        _mm_storeu_ps(sum[0], axi);
+        _mm_storeu_ps(sum[1], ayi);
+        _mm_storeu_ps(sum[2], azi);
+
+        float ax = sum[0][0] + sum[0][1] + sum[0][2] + sum[0][3];
+        float ay = sum[1][0] + sum[1][1] + sum[1][2] + sum[1][3];
+        float az = sum[2][0] + sum[2][1] + sum[2][2] + sum[2][3];
+
+        for (; j < b.count; ++j)
+            pair<Merging>(b, i, j, ax, ay, az, merges);
+
+        b.ax[i] += ax;
+        b.ay[i] += ay;
+        b.az[i] += az;
+    }
+}
+
+TARGET("avx,avx2,fma") inline float sum256(__m256 v) {
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+    return _mm_cvtss_f32(s);
+}
+
+template<bool Merging> TARGET("avx,avx2,fma") void sweepAVX2(const Bodies& b, size_t first, size_t last, pair_list& merges) {
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 threeHalves = _mm256_set1_ps(1.5f);
+
+    for (size_t i = first; i < last; ++i) {
+        const __m256 xi = _mm256_set1_ps(b.x[i]), yi = _mm256_set1_ps(b.y[i]), zi = _mm256_set1_ps(b.z[i]);
+        const __m256 mi = _mm256_set1_ps(b.m[i]), ri = _mm256_set1_ps(b.r[i]);
+
+        __m256 axi = _mm256_setzero_ps(), ayi = _mm256_setzero_ps(), azi = _mm256_setzero_ps();
+
+        size_t j = i + 1;
+        for (; j + 8 <= b.count; j += 8) {
+            __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(b.x + j), xi);
+            __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(b.y + j), yi);
+            __m256 dz = _mm256_sub_ps(_mm256_loadu_ps(b.z + j), zi);
+            __m256 distance2 = _mm256_fmadd_ps(dx, dx, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dz, dz)));
+
+            /* Touching pairs get no force, they're merged after the sweep instead. Without merging only bodies at the same
+             * position are left out, their estimate is infinite. */
+            __m256 skip;
+            if (Merging) {
+                __m256 touching = _mm256_add_ps(ri, _mm256_loadu_ps(b.r + j));
+                skip = _mm256_cmp_ps(distance2, _mm256_mul_ps(touching, touching), _CMP_LT_OQ);
+            } else {
+                skip = _mm256_cmp_ps(distance2, _mm256_setzero_ps(), _CMP_EQ_OQ);
+            }
+
+            /* Hardware estimate plus one Newton-Raphson step. */
+            __m256 inverse = _mm256_rsqrt_ps(distance2);
+            inverse = _mm256_mul_ps(inverse, _mm256_fnmadd_ps(_mm256_mul_ps(half, distance2), _mm256_mul_ps(inverse, inverse), threeHalves));
+
+            __m256 force = _mm256_andnot_ps(skip, _mm256_mul_ps(inverse, _mm256_mul_ps(inverse, inverse)));
+
+            __m256 fj = _mm256_mul_ps(force, _mm256_loadu_ps(b.m + j));
+            axi = _mm256_fmadd_ps(fj, dx, axi);
+            ayi = _mm256_fmadd_ps(fj, dy, ayi);
+            azi = _mm256_fmadd_ps(fj, dz, azi);
+
+            __m256 fi = _mm256_mul_ps(force, mi);
+            _mm256_storeu_ps(b.ax + j, _mm256_fnmadd_ps(fi, dx, _mm256_loadu_ps(b.ax + j)));
+            _mm256_storeu_ps(b.ay + j, _mm256_fnmadd_ps(fi, dy, _mm256_loadu_ps(b.ay + j)));
+            _mm256_storeu_ps(b.az + j, _mm256_fnmadd_ps(fi, dz, _mm256_loadu_ps(b.az + j)));
+
+            if (Merging)
+                addMerges(unsigned(_mm256_movemask_ps(skip)), i, j, merges);
+        }
+
+        float ax = sum256(axi), ay = sum256(ayi), az = sum256(azi);
+
+        for (; j < b.count; ++j)
+            pair<Merging>(b, i, j, ax, ay, az, merges);
+
+        b.ax[i] += ax;
+        b.ay[i] += ay;
+        b.az[i] += az;
+    }
+}
+
+template<bool Merging> TARGET("avx512f") void sweepAVX512(const Bodies& b, size_t first, size_t last, pair_list& merges) {
+    const __m512 half = _mm512_set1_ps(0.5f);
+    const __m512 threeHalves = _mm512_set1_ps(1.5f);
+
+    for (size_t i = first; i < last; ++i) {
+        const __m512 xi = _mm512_set1_ps(b.x[i]), yi = _mm512_set1_ps(b.y[i]), zi = _mm512_set1_ps(b.z[i]);
+        const __m512 mi = _mm512_set1_ps(b.m[i]), ri = _mm512_set1_ps(b.r[i]);
+
+        __m512 axi = _mm512_setzero_ps(), ayi = _mm512_setzero_ps(), azi = _mm512_setzero_ps();
+
+        /* AVX-512 can mask off the lanes past the end, so there's no scalar leftover loop. */
+        for (size_t j = i + 1; j < b.count; j += 16) {
+            const size_t remaining = b.count - j;
+            const __mmask16 active = remaining >= 16 ? __mmask16(0xffff) : __mmask16((1u << remaining) - 1);
+
+            __m512 dx = _mm512_sub_ps(_mm512_maskz_loadu_ps(active, b.x + j), xi);
+            __m512 dy = _mm512_sub_ps(_mm512_maskz_loadu_ps(active, b.y + j), yi);
+            __m512 dz = _mm512_sub_ps(_mm512_maskz_loadu_ps(active, b.z + j), zi);
+            __m512 distance2 = _mm512_fmadd_ps(dx, dx, _mm512_fmadd_ps(dy, dy, _mm512_mul_ps(dz, dz)));
+
+            /* Touching pairs (or without merging, bodies at the same position) and lanes past the end get no force. */
+            __mmask16 skip;
+            if (Merging) {
+                __m512 touching = _mm512_add_ps(ri, _mm512_maskz_loadu_ps(active, b.r + j));
+                skip = _mm512_mask_cmp_ps_mask(active, distance2, _mm512_mul_ps(touching, touching), _CMP_LT_OQ);
+            } else {
+                skip = _mm512_mask_cmp_ps_mask(active, distance2, _mm512_setzero_ps(), _CMP_EQ_OQ);
+            }
+
+            /* The estimate is good to 14 bits, one Newton-Raphson step covers the rest. */
+            __m512 inverse = _mm512_rsqrt14_ps(distance2);
+            inverse = _mm512_mul_ps(inverse, _mm512_fnmadd_ps(_mm512_mul_ps(half, distance2), _mm512_mul_ps(inverse, inverse), threeHalves));
+
+            const __mmask16 apply = active & ~skip;
+            __m512 force = _mm512_maskz_mul_ps(apply, inverse, _mm512_mul_ps(inverse, inverse));
+
+            __m512 fj = _mm512_mul_ps(force, _mm512_maskz_loadu_ps(active, b.m + j));
+            axi = _mm512_fmadd_ps(fj, dx, axi);
+            ayi = _mm512_fmadd_ps(fj, dy, ayi);
+            azi = _mm512_fmadd_ps(fj, dz, azi);
+
+            __m512 fi = _mm512_mul_ps(force, mi);
+            _mm512_mask_storeu_ps(b.ax + j, active, _mm512_fnmadd_ps(fi, dx, _mm512_maskz_loadu_ps(active, b.ax + j)));
+            _mm512_mask_storeu_ps(b.ay + j, active, _mm512_fnmadd_ps(fi, dy, _mm512_maskz_loadu_ps(active, b.ay + j)));
+            _mm512_mask_storeu_ps(b.az + j, active, _mm512_fnmadd_ps(fi, dz, _mm512_maskz_loadu_ps(active, b.az + j)));
+
+            if (Merging)
+                addMerges(skip, i, j, merges);
+        }
+
+        b.ax[i] += _mm512_reduce_add_ps(axi);
+        b.ay[i] += _mm512_reduce_add_ps(ayi);
+        b.az[i] += _mm512_reduce_add_ps(azi);
+    }
+}
+
+TARGET("sse2") void tracersSSE(const Tracers& t, size_t first, size_t last, pair_list& contacts) {
+    const Bodies& b = t.bodies;
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 threeHalves = _mm_set1_ps(1.5f);
+
+    size_t i = first;
+    for (; i + 4 <= last; i += 4) {
+        const __m128 xi = _mm_loadu_ps(t.x + i), yi = _mm_loadu_ps(t.y + i), zi = _mm_loadu_ps(t.z + i);
+
+        __m128 ax = _mm_setzero_ps(), ay = _mm_setzero_ps(), az = _mm_setzero_ps();
+
+        for (size_t j = 0; j < b.count; ++j) {
+            __m128 dx = _mm_sub_ps(_mm_set1_ps(b.x[j]), xi);
+            __m128 dy = _mm_sub_ps(_mm_set1_ps(b.y[j]), yi);
+            __m128 dz = _mm_sub_ps(_mm_set1_ps(b.z[j]), zi);
+            __m128 distance2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+            __m128 contact = _mm_cmplt_ps(distance2, _mm_set1_ps(b.r[j] * b.r[j]));
+
+            __m128 inverse = _mm_rsqrt_ps(distance2);
+            inverse = _mm_mul_ps(inverse, _mm_sub_ps(threeHalves, _mm_mul_ps(_mm_mul_ps(half, distance2), _mm_mul_ps(inverse, inverse))));
+
+            __m128 force = _mm_andnot_ps(contact, _mm_mul_ps(_mm_mul_ps(inverse, _mm_mul_ps(inverse, inverse)), _mm_set1_ps(b.m[j])));
+            ax = _mm_add_ps(ax, _mm_mul_ps(force, dx));
+            ay = _mm_add_ps(ay, _mm_mul_ps(force, dy));
+            az = _mm_add_ps(az, _mm_mul_ps(force, dz));
+
+            addContacts(unsigned(_mm_movemask_ps(contact)), i, j, contacts);
+        }
+
+        _mm_storeu_ps(t.ax + i, ax);
+        _mm_storeu_ps(t.ay + i, ay);
+        _mm_storeu_ps(t.az + i, az);
+    }
+
+    tracersScalar(t, i, last, contacts);
+}
+
+TARGET("avx,avx2,fma") void tracersAVX2(const Tracers& t, size_t first, size_t last, pair_list& contacts) {
+    const Bodies& b = t.bodies;
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 threeHalves = _mm256_set1_ps(1.5f);
+
+    size_t i = first;
+    for (; i + 8 <= last; i += 8) {
+        const __m256 xi = _mm256_loadu_ps(t.x + i), yi = _mm256_loadu_ps(t.y + i), zi = _mm256_loadu_ps(t.z + i);
+
+        __m256 ax = _mm256_setzero_ps(), ay = _mm256_setzero_ps(), az = _mm256_setzero_ps();
+
+        for (size_t j = 0; j < b.count; ++j) {
+            __m256 dx = _mm256_sub_ps(_mm256_set1_ps(b.x[j]), xi);
+            __m256 dy = _mm256_sub_ps(_mm256_set1_ps(b.y[j]), yi);
+            __m256 dz = _mm256_sub_ps(_mm256_set1_ps(b.z[j]), zi);
+            __m256 distance2 = _mm256_fmadd_ps(dx, dx, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dz, dz)));
+
+            __m256 contact = _mm256_cmp_ps(distance2, _mm256_set1_ps(b.r[j] * b.r[j]), _CMP_LT_OQ);
+
+            __m256 inverse = _mm256_rsqrt_ps(distance2);
+            inverse = _mm256_mul_ps(inverse, _mm256_fnmadd_ps(_mm256_mul_ps(half, distance2), _mm256_mul_ps(inverse, inverse), threeHalves));
+
+            __m256 force = _mm256_andnot_ps(contact, _mm256_mul_ps(_mm256_mul_ps(inverse, _mm256_mul_ps(inverse, inverse)), _mm256_set1_ps(b.m[j])));
+            ax = _mm256_fmadd_ps(force, dx, ax);
+            ay = _mm256_fmadd_ps(force, dy, ay);
+            az = _mm256_fmadd_ps(force, dz, az);
+
+            addContacts(unsigned(_mm256_movemask_ps(contact)), i, j, contacts);
+        }
+
+        _mm256_storeu_ps(t.ax + i, ax);
+        _mm256_storeu_ps(t.ay + i, ay);
+        _mm256_storeu_ps(t.az + i, az);
+    }
+
+    tracersScalar(t, i, last, contacts);
+}
+
+TARGET("avx512f") void tracersAVX512(const Tracers& t, size_t first, size_t last, pair_list& contacts) {
+    const Bodies& b = t.bodies;
+    const __m512 half = _mm512_set1_ps(0.5f);
+    const __m512 threeHalves = _mm512_set1_ps(1.5f);
+
+    /* The last few tracers get masked off instead of going through the scalar loop. */
+    for (size_t i = first; i < last; i += 16) {
+        const size_t remaining = last - i;
+        const __mmask16 active = remaining >= 16 ? __mmask16(0xffff) : __mmask16((1u << remaining) - 1);
+
+        const __m512 xi = _mm512_maskz_loadu_ps(active, t.x + i);
+        const __m512 yi = _mm512_maskz_loadu_ps(active, t.y + i);
+        const __m512 zi = _mm512_maskz_loadu_ps(active, t.z + i);
+
+        __m512 ax = _mm512_setzero_ps(), ay = _mm512_setzero_ps(), az = _mm512_setzero_ps();
+
+        for (size_t j = 0; j < b.count; ++j) {
+            __m512 dx = _mm512_sub_ps(_mm512_set1_ps(b.x[j]), xi);
+            __m512 dy = _mm512_sub_ps(_mm512_set1_ps(b.y[j]), yi);
+            __m512 dz = _mm512_sub_ps(_mm512_set1_ps(b.z[j]), zi);
+            __m512 distance2 = _mm512_fmadd_ps(dx, dx, _mm512_fmadd_ps(dy, dy, _mm512_mul_ps(dz, dz)));
+
+            __mmask16 contact = _mm512_mask_cmp_ps_mask(active, distance2, _mm512_set1_ps(b.r[j] * b.r[j]), _CMP_LT_OQ);
+
+            __m512 inverse = _mm512_rsqrt14_ps(distance2);
+            inverse = _mm512_mul_ps(inverse, _mm512_fnmadd_ps(_mm512_mul_ps(half, distance2), _mm512_mul_ps(inverse, inverse), threeHalves));
+
+            __m512 force = _mm512_maskz_mul_ps(active & ~contact, _mm512_mul_ps(inverse, _mm512_mul_ps(inverse, inverse)), _mm512_set1_ps(b.m[j]));
+            ax = _mm512_fmadd_ps(force, dx, ax);
+            ay = _mm512_fmadd_ps(force, dy, ay);
+            az = _mm512_fmadd_ps(force, dz, az);
+
+            addContacts(contact, i, j, contacts);
+        }
+
+        _mm512_mask_storeu_ps(t.ax + i, active, ax);
+        _mm512_mask_storeu_ps(t.ay + i, active, ay);
+        _mm512_mask_storeu_ps(t.az + i, active, az);
+    }
+}
+
+ForceKernel::InstructionSet checkCPU() {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    const int maxLeaf = info[0];
+
+    __cpuid(info, 1);
+    const bool sse2 = (info[3] & (1 << 26)) != 0;
+    const bool fma = (info[2] & (1 << 12)) != 0;
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+
+    bool avx2 = false, avx512 = false;
+    if (maxLeaf >= 7 && osxsave) {
+        /* The OS has to save the wider registers, otherwise they can't be used even if the CPU has them. */
+        const unsigned long long xcr0 = _xgetbv(0);
+        __cpuidex(info, 7, 0);
+        avx2 = fma && (info[1] & (1 << 5)) != 0 && (xcr0 & 0x6) == 0x6;
+        avx512 = avx2 && (info[1] & (1 << 16)) != 0 && (xcr0 & 0xe6) == 0xe6;
+    }
+
+    if (avx512) return ForceKernel::AVX512;
+    if (avx2) return ForceKernel::AVX2;
+    if (sse2) return ForceKernel::SSE;
+#else
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx512f")) return ForceKernel::AVX512;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return ForceKernel::AVX2;
+    if (__builtin_cpu_supports("sse2")) return ForceKernel::SSE;
+#endif
+    return ForceKernel::Scalar;
+}
+
+#else
+
+ForceKernel::InstructionSet checkCPU() {
+    return ForceKernel::Scalar;
+}
+
+#endif /* PLANETS3D_X86 */
+
+}
+
+ForceKernel::InstructionSet ForceKernel::detect() {
+    static const InstructionSet supported = checkCPU();
+    return supported;
+}
+
+const char* ForceKernel::name(InstructionSet instructionSet) {
+    switch (instructionSet) {
+    case SSE:    return "sse";
+    case AVX2:   return "avx2";
+    case AVX512: return "avx512";
+    default:     return "scalar";
+    }
+}
+
+template<bool Merging> void ForceKernel::accelerations(const glm::vec3* positions, const float* masses, const float* radii, size_t count,
+                                                       InstructionSet instructionSet, ThreadPool& pool, glm::vec3* result, pair_list& merges) {
+    x.resize(count);
+    y.resize(count);
+    z.resize(count);
+    m.assign(masses, masses + count);
+    r.assign(radii, radii + count);
+
+    for (size_t i = 0; i < count; ++i) {
+        x[i] = positions[i].x;
+        y[i] = positions[i].y;
+        z[i] = positions[i].z;
+    }
+
+    sweep_function sweep;
+    switch (std::min(instructionSet, detect())) {
+#ifdef PLANETS3D_X86
+    case AVX512: sweep = sweepAVX512<Merging>; break;
+    case AVX2:   sweep = sweepAVX2<Merging>;   break;
+    case SSE:    sweep = sweepSSE<Merging>;    break;
+#endif
+    default:     sweep = sweepScalar<Merging>; break;
+    }
+
+    const unsigned int threads = count < parallelThreshold ? 1 : pool.threadCount();
+    accumulators.resize(threads);
+
+    std::atomic<size_t> nextRow(0);
+
+    auto sweepRows = [&](unsigned int thread) {
+        Accumulator& accumulator = accumulators[thread];
+        accumulator.ax.assign(count, 0.0f);
+        accumulator.ay.assign(count, 0.0f);
+        accumulator.az.assign(count, 0.0f);
+        accumulator.merges.clear();
+
+        Bodies bodies = { x.data(), y.data(), z.data(), m.data(), r.data(),
+                          accumulator.ax.data(), accumulator.ay.data(), accumulator.az.data(), count };
+
+        size_t first;
+        while ((first = nextRow.fetch_add(rowBlock)) < count)
+            sweep(bodies, first, std::min(first + rowBlock, count), accumulator.merges);
+    };
+
+    if (threads == 1) {
+        sweepRows(0);
+    } else {
+        pool.run(sweepRows);
+    }
+
+    /* Add up what every thread found, each thread takes an even slice of the bodies. */
+    auto sum = [&](unsigned int thread) {
+        const size_t begin = count * thread / threads, end = count * (thread + 1) / threads;
+
+        for (size_t i = begin; i < end; ++i) {
+            glm::vec3 total;
+            for (const Accumulator& accumulator : accumulators)
+                total += glm::vec3(accumulator.ax[i], accumulator.ay[i], accumulator.az[i]);
+            result[i] = total;
+        }
+    };
+
+    if (threads == 1) {
+        sum(0);
+    } else {
+        pool.run(sum);
+    }
+
+    if (Merging)
+        for (const Accumulator& accumulator : accumulators)
+            merges.insert(merges.end(), accumulator.merges.begin(), accumulator.merges.end());
+}
+
+template void ForceKernel::accelerations<false>(const glm::vec3* positions, const float* masses, const float* radii, size_t count,
+                                                InstructionSet instructionSet, ThreadPool& pool, glm::vec3* result, pair_list& merges);
+template void ForceKernel::accelerations<true>(const glm::vec3* positions, const float* masses, const float* radii, size_t count,
+                                               InstructionSet instructionSet, ThreadPool& pool, glm::vec3* result, pair_list& merges);
+
+void ForceKernel::tracerAccelerations(const glm::vec3* tracers, size_t tracerCount, const glm::vec3* positions, const float* masses,
+                                     const float* radii, size_t count, InstructionSet instructionSet, ThreadPool& pool,
+                                     glm::vec3* result, pair_list& contacts) {
+    x.resize(count);
+    y.resize(count);
+    z.resize(count);
+    m.assign(masses, masses + count);
+    r.assign(radii, radii + count);
+
+    for (size_t i = 0; i < count; ++i) {
+        x[i] = positions[i].x;
+        y[i] = positions[i].y;
+        z[i] = positions[i].z;
+    }
+
+    tx.resize(tracerCount);
+    ty.resize(tracerCount);
+    tz.resize(tracerCount);
+    tax.resize(tracerCount);
+    tay.resize(tracerCount);
+    taz.resize(tracerCount);
+
+    for (size_t i = 0; i < tracerCount; ++i) {
+        tx[i] = tracers[i].x;
+        ty[i] = tracers[i].y;
+        tz[i] = tracers[i].z;
+    }
+
+    tracer_function function;
+    switch (std::min(instructionSet, detect())) {
+#ifdef PLANETS3D_X86
+    case AVX512: function = tracersAVX512; break;
+    case AVX2:   function = tracersAVX2;   break;
+    case SSE:    function = tracersSSE;    break;
+#endif
+    default:     function = tracersScalar; break;
+    }
+
+    const Tracers t = { tx.data(), ty.data(), tz.data(), tax.data(), tay.data(), taz.data(),
+                        { x.data(), y.data(), z.data(), m.data(), r.data(), nullptr, nullptr, nullptr, count } };
+
+    contactLists.resize(pool.threadCount());
+    for (pair_list& list : contactLists)
+        list.clear();
+
+    /* Every tracer only writes its own acceleration, so blocks can go to whichever thread is free. */
+    pool.parallelFor(tracerCount, tracerBlock, [&](size_t begin, size_t end, unsigned int thread) {
+        function(t, begin, end, contactLists[thread]);
+
+        for (size_t i = begin; i < end; ++i)
+            result[i] = glm::vec3(tax[i], tay[i], taz[i]);
+    });
+
+    for (const pair_list& list : contactLists)
+        contacts.insert(contacts.end(), list.begin(), list.end());
+}
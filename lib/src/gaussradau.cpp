@@ -0,0 +1,252 @@
+#include "gaussradau.h"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+/* Where the nodes are as a fraction of the step, the start followed by the 7 Gauss-Radau points. */
+constexpr double nodes[8] = {
+    0.0, 0.0562625605369221464656521910318, 0.180240691736892364987579942780, 0.352624717113169637373907769648,
+    0.547153626330555383001448554766, 0.734210177215410531523210605558, 0.885320946839095768090359771030, 0.977520613561287501891174488626
+};
+
+/* Steps can't grow or shrink by more than this factor at once, shrinking by more than that means the step gets redone. */
+constexpr double safetyFactor = 0.25;
+/* Past this much growth the fit from the last step isn't worth extrapolating. */
+constexpr double maximumPredictionRatio = 20.0;
+/* The iterations have converged as far as doubles go once changes are this small. */
+constexpr double convergedError = 1.0e-16;
+
+/* Converts between the two forms of the polynomial, b[k] = sum of toPower[j][k] * g[j] and g[j] = sum of toNewton[k][j] * b[k].
+ * The Newton form's jth term is t * (t - h1) * ... * (t - hj), so both are lower triangular with 1s on the diagonal. */
+struct Coefficients {
+    double toPower[7][7], toNewton[7][7], binomial[8][8];
+
+    Coefficients() {
+        for (int j = 0; j < 7; ++j) {
+            /* Multiply out (t - h1) * ... * (t - hj), term k is the coefficient of t^k. */
+            double product[8] = { 1.0 };
+            for (int i = 1; i <= j; ++i)
+                for (int k = i; k >= 0; --k)
+                    product[k] = (k > 0 ? product[k - 1] : 0.0) - nodes[i] * product[k];
+
+            for (int k = 0; k < 7; ++k)
+                toPower[j][k] = k <= j ? product[k] : 0.0;
+        }
+
+        for (int j = 0; j < 7; ++j) {
+            for (int i = 0; i < 7; ++i) {
+                double sum = i == j ? 1.0 : 0.0;
+                for (int k = j; k < i; ++k)
+                    sum -= toPower[i][k] * toNewton[k][j];
+                toNewton[i][j] = i < j ? 0.0 : sum;
+            }
+        }
+
+        for (int n = 0; n < 8; ++n)
+            for (int k = 0; k <= n; ++k)
+                binomial[n][k] = (k == 0 || k == n) ? 1.0 : binomial[n - 1][k - 1] + binomial[n - 1][k];
+    }
+};
+
+const Coefficients coefficients;
+
+inline double maxComponent(const glm::dvec3& v) {
+    return std::max(std::abs(v.x), std::max(std::abs(v.y), std::abs(v.z)));
+}
+
+}
+
+void GaussRadau::reset() {
+    step = 0.0;
+    lastStep = 0.0;
+    steps = iterations = 0;
+
+    for (int k = 0; k < 7; ++k) {
+        fit[k].clear();
+        correction[k].clear();
+    }
+}
+
+void GaussRadau::integrate(std::vector<glm::dvec3>& positions, std::vector<glm::dvec3>& velocities, double time, double tolerance,
+                           const force_function& forces) {
+    const size_t count = positions.size();
+
+    if (count == 0 || time <= 0.0)
+        return;
+
+    if (fit[0].size() != count) {
+        reset();
+        for (int k = 0; k < 7; ++k) {
+            fit[k].assign(count, glm::dvec3());
+            correction[k].assign(count, glm::dvec3());
+            predicted[k].resize(count);
+            b[k].resize(count);
+            g[k].resize(count);
+        }
+        startAcceleration.resize(count);
+        nodePositions.resize(count);
+        nodeAccelerations.resize(count);
+    }
+
+    /* Anything shorter than this gets taken even if the error is too big, so a collision can't stall things forever. */
+    const double minimum = time * 1.0e-9;
+
+    double remaining = time;
+    while (remaining > minimum) {
+        const double planned = step > 0.0 ? step : remaining;
+        const bool clipped = planned >= remaining;
+
+        double next = planned;
+        remaining -= attempt(positions, velocities, clipped ? remaining : planned, tolerance, minimum, forces, next);
+
+        /* Getting cut short by the end of the time isn't a reason to make the next step shorter. */
+        step = clipped ? std::min(next, planned) : next;
+    }
+}
+
+void GaussRadau::predict(double ratio) {
+    const size_t count = fit[0].size();
+
+    if (lastStep <= 0.0 || ratio > maximumPredictionRatio) {
+        for (int k = 0; k < 7; ++k) {
+            std::fill(predicted[k].begin(), predicted[k].end(), glm::dvec3());
+            std::fill(b[k].begin(), b[k].end(), glm::dvec3());
+        }
+        return;
+    }
+
+    /* Shift the last step's polynomial to start where it ended and rescale it to the new step length,
+     * then add how far off the prediction for the last step was since that tends to repeat. */
+    double powers[7];
+    powers[0] = ratio;
+    for (int k = 1; k < 7; ++k)
+        powers[k] = powers[k - 1] * ratio;
+
+    for (size_t i = 0; i < count; ++i) {
+        for (int k = 0; k < 7; ++k) {
+            glm::dvec3 sum;
+            for (int j = k; j < 7; ++j)
+                sum += fit[j][i] * coefficients.binomial[j + 1][k + 1];
+            predicted[k][i] = sum * powers[k];
+            b[k][i] = predicted[k][i] + correction[k][i];
+        }
+    }
+}
+
+double GaussRadau::attempt(std::vector<glm::dvec3>& positions, std::vector<glm::dvec3>& velocities, double dt, double tolerance,
+                           double minimum, const force_function& forces, double& next) {
+    const size_t count = positions.size();
+
+    forces(positions, startAcceleration);
+
+    for (int rejections = 0;; ++rejections) {
+        predict(lastStep > 0.0 ? dt / lastStep : 0.0);
+
+        for (int j = 0; j < 7; ++j)
+            for (size_t i = 0; i < count; ++i) {
+                glm::dvec3 sum;
+                for (int k = j; k < 7; ++k)
+                    sum += b[k][i] * coefficients.toNewton[k][j];
+                g[j][i] = sum;
+            }
+
+        double previousError = std::numeric_limits<double>::infinity();
+
+        for (int iteration = 0; iteration < maximumIterations; ++iteration) {
+            double maxChange = 0.0, maxAcceleration = 0.0;
+
+            for (int n = 1; n < 8; ++n) {
+                const double h = nodes[n];
+
+                /* Integrate the polynomial twice to get the positions at this node. */
+                for (size_t i = 0; i < count; ++i) {
+                    glm::dvec3 sum = startAcceleration[i] * 0.5;
+                    double power = h;
+                    for (int k = 0; k < 7; ++k, power *= h)
+                        sum += b[k][i] * (power / double((k + 2) * (k + 3)));
+
+                    nodePositions[i] = positions[i] + (velocities[i] + sum * (dt * h)) * (dt * h);
+                }
+
+                forces(nodePositions, nodeAccelerations);
+
+                /* The new acceleration only changes the Newton term for this node, and which power terms it feeds into. */
+                const int j = n - 1;
+                for (size_t i = 0; i < count; ++i) {
+                    glm::dvec3 term = (nodeAccelerations[i] - startAcceleration[i]) / h;
+                    for (int k = 0; k < j; ++k)
+                        term = (term - g[k][i]) / (h - nodes[k + 1]);
+
+                    const glm::dvec3 change = term - g[j][i];
+                    g[j][i] = term;
+
+                    for (int k = 0; k <= j; ++k)
+                        b[k][i] += change * coefficients.toPower[j][k];
+
+                    if (n == 7) {
+                        maxChange = std::max(maxChange, maxComponent(change));
+                        maxAcceleration = std::max(maxAcceleration, maxComponent(nodeAccelerations[i]));
+                    }
+                }
+            }
+
+            ++iterations;
+
+            /* Stop once the fit stops changing, or starts getting worse because of rounding. */
+            const double error = maxAcceleration > 0.0 ? maxChange / maxAcceleration : 0.0;
+            if (error < convergedError || error >= previousError)
+                break;
+            previousError = error;
+        }
+
+        /* The highest term is about how big the error in the 15th order terms would be. */
+        double maxHighest = 0.0, maxAcceleration = 0.0;
+        for (size_t i = 0; i < count; ++i) {
+            maxHighest = std::max(maxHighest, maxComponent(b[6][i]));
+            maxAcceleration = std::max(maxAcceleration, maxComponent(nodeAccelerations[i]));
+        }
+
+        const double error = maxAcceleration > 0.0 ? maxHighest / maxAcceleration : 0.0;
+        double ratio = 1.0 / safetyFactor;
+        if (error > 0.0 && std::isfinite(error))
+            ratio = std::min(std::pow(tolerance / error, 1.0 / 7.0), ratio);
+        else if (!std::isfinite(error))
+            ratio = safetyFactor * safetyFactor;
+
+        if (ratio < safetyFactor && dt > minimum && rejections < maximumRejections) {
+            dt = std::max(dt * ratio, minimum);
+            continue;
+        }
+
+        next = dt * ratio;
+        break;
+    }
+
+    /* The end of the step is t = 1, where every power term is just its coefficient. */
+    for (size_t i = 0; i < count; ++i) {
+        glm::dvec3 positionSum = startAcceleration[i] * 0.5, velocitySum = startAcceleration[i];
+        for (int k = 0; k < 7; ++k) {
+            positionSum += b[k][i] / double((k + 2) * (k + 3));
+            velocitySum += b[k][i] / double(k + 2);
+        }
+
+        positions[i] += (velocities[i] + positionSum * dt) * dt;
+        velocities[i] += velocitySum * dt;
+    }
+
+    /* Keep the fit for predicting the next step, and how far its own prediction was off. */
+    for (int k = 0; k < 7; ++k) {
+        for (size_t i = 0; i < count; ++i) {
+            correction[k][i] = b[k][i] - predicted[k][i];
+            fit[k][i] = b[k][i];
+        }
+    }
+
+    lastStep = dt;
+    ++steps;
+
+    return dt;
+}
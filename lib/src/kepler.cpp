@@ -0,0 +1,91 @@
+#include "kepler.h"
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+#include <cmath>
+
+/* Give up on the solver after this many iterations. */
+constexpr int maximumIterations = 50;
+
+void Kepler::stumpff(double z, double& c2, double& c3) {
+    if (z > 1.0e-4) {
+        const double s = std::sqrt(z);
+        c2 = (1.0 - std::cos(s)) / z;
+        c3 = (s - std::sin(s)) / (z * s);
+    } else if (z < -1.0e-4) {
+        const double s = std::sqrt(-z);
+        c2 = (std::cosh(s) - 1.0) / -z;
+        c3 = (std::sinh(s) - s) / (-z * s);
+    } else {
+        /* The closed forms lose everything to cancellation near 0. */
+        c2 = 1.0 / 2.0 - z / 24.0 + z * z / 720.0;
+        c3 = 1.0 / 6.0 - z / 120.0 + z * z / 5040.0;
+    }
+}
+
+bool Kepler::drift(glm::dvec3& position, glm::dvec3& velocity, double mu, double time) {
+    const double r0 = glm::length(position);
+
+    if (time == 0.0 || r0 <= 0.0 || mu <= 0.0)
+        return time == 0.0;
+
+    const double sqrtMu = std::sqrt(mu);
+    /* r0 * radial velocity / sqrt(mu). */
+    const double sigma = glm::dot(position, velocity) / sqrtMu;
+    /* 1 / semi-major axis, positive for bound orbits. */
+    const double alpha = 2.0 / r0 - glm::dot(velocity, velocity) / mu;
+
+    /* Whole orbits don't change anything, so only the leftover part needs solving. */
+    if (alpha > 0.0) {
+        const double period = 2.0 * glm::pi<double>() / (sqrtMu * alpha * std::sqrt(alpha));
+        time = std::fmod(time, period);
+    }
+
+    /* Solve sigma * x^2 * c2 + (1 - alpha * r0) * x^3 * c3 + r0 * x = sqrt(mu) * time for the universal anomaly x,
+     * with Laguerre's method since it converges from pretty much any starting point. */
+    const double target = sqrtMu * time;
+    double x = alpha > 0.0 ? target * alpha : target / r0;
+    double c2 = 0.5, c3 = 1.0 / 6.0, r = r0;
+    bool converged = false;
+
+    for (int i = 0; i < maximumIterations && !converged; ++i) {
+        const double z = alpha * x * x;
+        stumpff(z, c2, c3);
+
+        const double f = sigma * x * x * c2 + (1.0 - alpha * r0) * x * x * x * c3 + r0 * x - target;
+        /* The first derivative is the distance at x. */
+        r = sigma * x * (1.0 - z * c3) + (1.0 - alpha * r0) * x * x * c2 + r0;
+        const double d2 = sigma * (1.0 - z * c2) + (1.0 - alpha * r0) * x * (1.0 - z * c3);
+
+        constexpr double n = 5.0;
+        const double root = std::sqrt(std::abs((n - 1.0) * (n - 1.0) * r * r - n * (n - 1.0) * f * d2));
+        const double denominator = r + (r >= 0.0 ? root : -root);
+
+        if (denominator == 0.0)
+            break;
+
+        const double delta = n * f / denominator;
+        x -= delta;
+
+        converged = std::abs(delta) <= 1.0e-12 * std::max(std::abs(x), 1.0);
+    }
+
+    if (!converged || !std::isfinite(x) || r <= 0.0)
+        return false;
+
+    /* Recompute with the final x so everything matches. */
+    const double z = alpha * x * x;
+    stumpff(z, c2, c3);
+    r = sigma * x * (1.0 - z * c3) + (1.0 - alpha * r0) * x * x * c2 + r0;
+
+    /* Lagrange coefficients, new position and velocity are both combinations of the old ones. */
+    const double f = 1.0 - x * x * c2 / r0;
+    const double g = time - x * x * x * c3 / sqrtMu;
+    const double fDot = sqrtMu / (r * r0) * x * (z * c3 - 1.0);
+    const double gDot = 1.0 - x * x * c2 / r;
+
+    const glm::dvec3 p = position;
+    position = f * p + g * velocity;
+    velocity = fDot * p + gDot * velocity;
+
+    return true;
+}
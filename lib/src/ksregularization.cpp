@@ -0,0 +1,99 @@
+#include "ksregularization.h"
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+#include <cmath>
+
+namespace {
+
+/* The 4D regularized coordinates, their derivatives in the stretched time s, the energy of the relative orbit, and real time. */
+struct State {
+    glm::dvec4 u, w;
+    double energy, time;
+};
+
+/* The KS matrix, L(u) * u gives the position (the 4th component is always 0). */
+inline glm::dvec4 multiplyL(const glm::dvec4& u, const glm::dvec4& v) {
+    return glm::dvec4(u.x * v.x - u.y * v.y - u.z * v.z + u.w * v.w,
+                      u.y * v.x + u.x * v.y - u.w * v.z - u.z * v.w,
+                      u.z * v.x + u.w * v.y + u.x * v.z + u.y * v.w,
+                      u.w * v.x - u.z * v.y + u.y * v.z - u.x * v.w);
+}
+inline glm::dvec4 multiplyLTransposed(const glm::dvec4& u, const glm::dvec4& v) {
+    return glm::dvec4( u.x * v.x + u.y * v.y + u.z * v.z + u.w * v.w,
+                      -u.y * v.x + u.x * v.y + u.w * v.z - u.z * v.w,
+                      -u.z * v.x - u.w * v.y + u.x * v.z + u.y * v.w,
+                       u.w * v.x - u.z * v.y + u.y * v.z - u.x * v.w);
+}
+
+/* u'' = energy / 2 * u + r / 2 * L(u)^T * P, energy' = 2 * u' . L(u)^T * P, and time' = r. */
+inline State derivative(const State& state, const glm::dvec4& perturbation) {
+    const double r = glm::dot(state.u, state.u);
+    const glm::dvec4 pull = multiplyLTransposed(state.u, perturbation);
+
+    return State{ state.w, state.u * (state.energy * 0.5) + pull * (r * 0.5), 2.0 * glm::dot(state.w, pull), r };
+}
+
+inline State advance(const State& state, const State& rate, double step) {
+    return State{ state.u + rate.u * step, state.w + rate.w * step, state.energy + rate.energy * step, state.time + rate.time * step };
+}
+
+}
+
+bool KSRegularization::drift(glm::dvec3& position, glm::dvec3& velocity, double mu, const glm::dvec3& perturbation, double time,
+                             double& closest) {
+    const double r0 = glm::length(position);
+    closest = r0;
+
+    if (time == 0.0 || r0 <= 0.0 || mu <= 0.0)
+        return time == 0.0;
+
+    /* Pick whichever square root of the position avoids dividing by something near 0. */
+    State state;
+    if (position.x >= 0.0) {
+        const double u1 = std::sqrt((r0 + position.x) * 0.5);
+        state.u = glm::dvec4(u1, position.y / (2.0 * u1), position.z / (2.0 * u1), 0.0);
+    } else {
+        const double u2 = std::sqrt((r0 - position.x) * 0.5);
+        state.u = glm::dvec4(position.y / (2.0 * u2), u2, 0.0, position.z / (2.0 * u2));
+    }
+    state.w = multiplyLTransposed(state.u, glm::dvec4(velocity, 0.0)) * 0.5;
+    state.energy = 0.5 * glm::dot(velocity, velocity) - mu / r0;
+    state.time = 0.0;
+
+    /* The regularized coordinates oscillate at sqrt(-energy / 2), or grow at that rate for unbound orbits.
+     * Near parabolic that goes to 0 so there's also a minimum number of steps based on how far apart they start. */
+    const double frequency = std::sqrt(std::abs(state.energy) * 0.5);
+    double maximumStep = time / (32.0 * r0);
+    if (frequency > 0.0)
+        maximumStep = std::min(maximumStep, 2.0 * glm::pi<double>() / (stepsPerOscillation * frequency));
+
+    const glm::dvec4 p(perturbation, 0.0);
+
+    /* Plain RK4 in the stretched time, the last steps are sized from the current distance to land on the right real time. */
+    int steps = 0;
+    for (; steps < maximumSteps && std::abs(time - state.time) > 1.0e-13 * time; ++steps) {
+        const double r = glm::dot(state.u, state.u);
+        const double step = glm::clamp((time - state.time) / r, -maximumStep, maximumStep);
+
+        const State k1 = derivative(state, p);
+        const State k2 = derivative(advance(state, k1, step * 0.5), p);
+        const State k3 = derivative(advance(state, k2, step * 0.5), p);
+        const State k4 = derivative(advance(state, k3, step), p);
+
+        state.u += (k1.u + (k2.u + k3.u) * 2.0 + k4.u) * (step / 6.0);
+        state.w += (k1.w + (k2.w + k3.w) * 2.0 + k4.w) * (step / 6.0);
+        state.energy += (k1.energy + (k2.energy + k3.energy) * 2.0 + k4.energy) * (step / 6.0);
+        state.time += (k1.time + (k2.time + k3.time) * 2.0 + k4.time) * (step / 6.0);
+
+        closest = std::min(closest, glm::dot(state.u, state.u));
+    }
+
+    const double r = glm::dot(state.u, state.u);
+    if (steps == maximumSteps || !std::isfinite(r) || r <= 0.0)
+        return false;
+
+    position = glm::dvec3(multiplyL(state.u, state.u));
+    velocity = glm::dvec3(multiplyL(state.u, state.w)) * (2.0 / r);
+
+    return true;
+}
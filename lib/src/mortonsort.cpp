@@ -0,0 +1,134 @@
+#include "mortonsort.h"
+#include <algorithm>
+
+namespace {
+
+/* Spread the low 21 bits of x out so there are two zero bits between each of them. */
+inline uint64_t spreadBits(uint64_t x) {
+    x &= 0x1fffff;
+    x = (x | x << 32) & 0x1f00000000ffffull;
+    x = (x | x << 16) & 0x1f0000ff0000ffull;
+    x = (x | x << 8) & 0x100f00f00f00f00full;
+    x = (x | x << 4) & 0x10c30c30c30c30c3ull;
+    x = (x | x << 2) & 0x1249249249249249ull;
+    return x;
+}
+
+/* Radix sort a byte at a time. */
+constexpr size_t radixBits = 8;
+constexpr size_t radixSize = size_t(1) << radixBits;
+
+}
+
+void MortonSort::sort(const glm::vec3* positions, size_t count, ThreadPool& pool, std::vector<uint32_t>& order) {
+    if (count == 0) {
+        order.clear();
+        return;
+    }
+
+    /* Each thread always gets the same part of the list, so it knows where its share of each byte value goes.
+     * That also keeps every pass stable, which the passes after the first one rely on. */
+    const size_t chunks = std::max<size_t>(1, std::min<size_t>(count / block, pool.threadCount()));
+
+    auto forChunks = [&](const std::function<void(size_t begin, size_t end, size_t chunk)>& job) {
+        if (chunks == 1) {
+            job(0, count, 0);
+            return;
+        }
+        pool.run([&](unsigned int thread) {
+            if (thread < chunks)
+                job(count * thread / chunks, count * (thread + 1) / chunks, thread);
+        });
+    };
+
+    threadMinimums.assign(chunks, positions[0]);
+    threadMaximums.assign(chunks, positions[0]);
+
+    forChunks([&](size_t begin, size_t end, size_t chunk) {
+        glm::vec3 minimum = positions[begin], maximum = positions[begin];
+        for (size_t i = begin + 1; i < end; ++i) {
+            minimum = glm::min(minimum, positions[i]);
+            maximum = glm::max(maximum, positions[i]);
+        }
+        threadMinimums[chunk] = minimum;
+        threadMaximums[chunk] = maximum;
+    });
+
+    glm::vec3 minimum = threadMinimums[0], maximum = threadMaximums[0];
+    for (size_t c = 1; c < chunks; ++c) {
+        minimum = glm::min(minimum, threadMinimums[c]);
+        maximum = glm::max(maximum, threadMaximums[c]);
+    }
+
+    /* The same scale on every axis, so the cells a code stands for are cubes. */
+    const glm::vec3 extent = maximum - minimum;
+    const float largest = std::max(std::max(extent.x, extent.y), std::max(extent.z, 1.0e-30f));
+    const float maximumCoordinate = float((1 << coordinateBits) - 1);
+    const float scale = maximumCoordinate / largest;
+
+    codes.resize(count);
+    indices.resize(count);
+    sortedCodes.resize(count);
+    sortedIndices.resize(count);
+
+    forChunks([&](size_t begin, size_t end, size_t) {
+        for (size_t i = begin; i < end; ++i) {
+            uint64_t code = 0;
+            for (int axis = 0; axis < 3; ++axis) {
+                /* Anything that isn't a number goes at the start rather than turning into who knows what. */
+                const float coordinate = (positions[i][axis] - minimum[axis]) * scale;
+                code |= spreadBits(coordinate > 0.0f ? uint64_t(std::min(coordinate, maximumCoordinate)) : 0) << axis;
+            }
+            codes[i] = code;
+            indices[i] = uint32_t(i);
+        }
+    });
+
+    threadCounts.resize(chunks);
+    for (std::vector<size_t>& counts : threadCounts)
+        counts.resize(radixSize);
+
+    for (size_t shift = 0; shift < coordinateBits * 3; shift += radixBits) {
+        forChunks([&](size_t begin, size_t end, size_t chunk) {
+            std::vector<size_t>& counts = threadCounts[chunk];
+            std::fill(counts.begin(), counts.end(), 0);
+            for (size_t i = begin; i < end; ++i)
+                ++counts[(codes[i] >> shift) & (radixSize - 1)];
+        });
+
+        /* Points that are all in the same box of space share the high bits, there's no point moving them for those. */
+        bool allSame = false;
+        for (size_t digit = 0; digit < radixSize && !allSame; ++digit) {
+            size_t total = 0;
+            for (size_t c = 0; c < chunks; ++c)
+                total += threadCounts[c][digit];
+            allSame = total == count;
+        }
+        if (allSame)
+            continue;
+
+        /* Everything with a lower byte goes first, then the same byte from lower chunks. */
+        size_t start = 0;
+        for (size_t digit = 0; digit < radixSize; ++digit) {
+            for (size_t c = 0; c < chunks; ++c) {
+                const size_t n = threadCounts[c][digit];
+                threadCounts[c][digit] = start;
+                start += n;
+            }
+        }
+
+        forChunks([&](size_t begin, size_t end, size_t chunk) {
+            std::vector<size_t>& starts = threadCounts[chunk];
+            for (size_t i = begin; i < end; ++i) {
+                const size_t n = starts[(codes[i] >> shift) & (radixSize - 1)]++;
+                sortedCodes[n] = codes[i];
+                sortedIndices[n] = indices[i];
+            }
+        });
+
+        codes.swap(sortedCodes);
+        indices.swap(sortedIndices);
+    }
+
+    order.assign(indices.begin(), indices.end());
+}
@@ -0,0 +1,642 @@
+#include "multipoletree.h"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+
+/* SSE2 is always there on 64 bit x86, so the direct part gets a vector loop without needing any checks. */
+#if !defined(EMSCRIPTEN) && (defined(__x86_64__) || defined(_M_X64))
+#define PLANETS3D_SSE2
+#include <emmintrin.h>
+#endif
+
+/* Enough room for every term of the highest order. */
+constexpr size_t maximumTerms = (MultipoleTree::maximumOrder + 1) * (MultipoleTree::maximumOrder + 2) * (MultipoleTree::maximumOrder + 3) / 6;
+
+namespace {
+
+/* Add the pull of bodies first to last onto the body at p with radius, counting how many are too close to add (including itself).
+ * Without Merging only bodies at exactly the same position (the body itself) are too close, and nothing is counted. */
+template<bool Merging> inline void nearField(const float* x, const float* y, const float* z, const float* m, const float* r, uint32_t first, uint32_t last,
+                      const glm::vec3& p, float radius, glm::vec3& acceleration, int& overlapping) {
+    uint32_t j = first;
+
+#ifdef PLANETS3D_SSE2
+    const __m128 xi = _mm_set1_ps(p.x), yi = _mm_set1_ps(p.y), zi = _mm_set1_ps(p.z), ri = _mm_set1_ps(radius);
+    const __m128 half = _mm_set1_ps(0.5f), threeHalves = _mm_set1_ps(1.5f), zero = _mm_setzero_ps();
+
+    __m128 ax = _mm_setzero_ps(), ay = _mm_setzero_ps(), az = _mm_setzero_ps();
+
+    for (; j + 4 <= last; j += 4) {
+        const __m128 dx = _mm_sub_ps(_mm_loadu_ps(x + j), xi);
+        const __m128 dy = _mm_sub_ps(_mm_loadu_ps(y + j), yi);
+        const __m128 dz = _mm_sub_ps(_mm_loadu_ps(z + j), zi);
+        const __m128 distance2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+        __m128 skip = _mm_cmpeq_ps(distance2, zero);
+        if (Merging) {
+            const __m128 touching = _mm_add_ps(ri, _mm_loadu_ps(r + j));
+            skip = _mm_or_ps(_mm_cmplt_ps(distance2, _mm_mul_ps(touching, touching)), skip);
+        }
+
+        /* Hardware estimate plus one Newton-Raphson step, same as the direct sum. */
+        __m128 inverse = _mm_rsqrt_ps(distance2);
+        inverse = _mm_mul_ps(inverse, _mm_sub_ps(threeHalves, _mm_mul_ps(_mm_mul_ps(half, distance2), _mm_mul_ps(inverse, inverse))));
+
+        const __m128 force = _mm_mul_ps(_mm_andnot_ps(skip, _mm_mul_ps(inverse, _mm_mul_ps(inverse, inverse))), _mm_loadu_ps(m + j));
+        ax = _mm_add_ps(ax, _mm_mul_ps(force, dx));
+        ay = _mm_add_ps(ay, _mm_mul_ps(force, dy));
+        az = _mm_add_ps(az, _mm_mul_ps(force, dz));
+
+        if (Merging)
+            for (int mask = _mm_movemask_ps(skip); mask != 0; mask >>= 1)
+                overlapping += mask & 1;
+    }
+
+    float sum[3][4];
+    _mm_storeu_ps(sum[0], ax);
+    _mm_storeu_ps(sum[1], ay);
+    _mm_storeu_ps(sum[2], az);
+
+    for (int lane = 0; lane < 4; ++lane)
+        acceleration += glm::vec3(sum[0][lane], sum[1][lane], sum[2][lane]);
+#endif
+
+    for (; j < last; ++j) {
+        const float dx = x[j] - p.x, dy = y[j] - p.y, dz = z[j] - p.z;
+        const float distance2 = dx * dx + dy * dy + dz * dz;
+        const float touching = radius + r[j];
+
+        if ((Merging && distance2 < touching * touching) || distance2 == 0.0f) {
+            if (Merging)
+                ++overlapping;
+        } else {
+            const float force = m[j] / (distance2 * std::sqrt(distance2));
+            acceleration += glm::vec3(dx, dy, dz) * force;
+        }
+    }
+}
+
+}
+
+void MultipoleTree::setOrder(int newOrder) {
+    order = newOrder;
+
+    termList.clear();
+    degreeEnd.clear();
+    termLookup.assign((maximumOrder + 1) * (maximumOrder + 1) * (maximumOrder + 1), ~uint32_t(0));
+
+    /* Lowest degree first, so every term comes after the ones it's built from. */
+    for (int degree = 0; degree <= order; ++degree) {
+        for (int x = degree; x >= 0; --x) {
+            for (int y = degree - x; y >= 0; --y) {
+                const int z = degree - x - y;
+
+                termLookup[(x * (maximumOrder + 1) + y) * (maximumOrder + 1) + z] = uint32_t(termList.size());
+
+                Term term;
+                term.x = uint8_t(x);
+                term.y = uint8_t(y);
+                term.z = uint8_t(z);
+                term.degree = uint8_t(degree);
+                term.parent = term.grandparent = 0;
+                term.axis = term.parentPower = 0;
+                termList.push_back(term);
+            }
+        }
+
+        degreeEnd.push_back(uint32_t(termList.size()));
+    }
+
+    for (Term& term : termList) {
+        if (term.degree == 0)
+            continue;
+
+        int power[3] = { term.x, term.y, term.z };
+        term.axis = uint8_t(term.x > 0 ? 0 : term.y > 0 ? 1 : 2);
+
+        --power[term.axis];
+        term.parentPower = uint8_t(power[term.axis]);
+        term.parent = termIndex(power[0], power[1], power[2]);
+
+        if (power[term.axis] > 0) {
+            --power[term.axis];
+            term.grandparent = termIndex(power[0], power[1], power[2]);
+        }
+    }
+
+    shifts.clear();
+    conversionStart.clear();
+    conversionLocal.clear();
+    conversionDerivative.clear();
+
+    for (uint32_t a = 0; a < terms(); ++a) {
+        const Term& ta = termList[a];
+
+        for (uint32_t b = 0; b < terms(); ++b) {
+            const Term& tb = termList[b];
+
+            if (ta.x <= tb.x && ta.y <= tb.y && ta.z <= tb.z)
+                shifts.push_back({ a, b, termIndex(tb.x - ta.x, tb.y - ta.y, tb.z - ta.z) });
+        }
+    }
+
+    for (uint32_t b = 0; b < terms(); ++b) {
+        const Term& tb = termList[b];
+        conversionStart.push_back(uint32_t(conversionLocal.size()));
+
+        for (uint32_t a = 0; a < terms() && termList[a].degree + tb.degree <= order; ++a) {
+            const Term& ta = termList[a];
+            conversionLocal.push_back(uint16_t(a));
+            conversionDerivative.push_back(uint16_t(termIndex(ta.x + tb.x, ta.y + tb.y, ta.z + tb.z)));
+        }
+    }
+    conversionStart.push_back(uint32_t(conversionLocal.size()));
+}
+
+void MultipoleTree::monomials(const glm::dvec3& d, double* out) const {
+    out[0] = 1.0;
+
+    for (size_t t = 1; t < terms(); ++t) {
+        const Term& term = termList[t];
+        out[t] = out[term.parent] * d[term.axis] / double(term.parentPower + 1);
+    }
+}
+
+void MultipoleTree::derivatives(const glm::dvec3& r, double* out) const {
+    /* The McMurchie-Davidson recurrence for point masses, R[j][t] is the t derivative of the jth auxiliary function.
+     * Only R[0] is wanted in the end, but the others are needed to get there. */
+    double R[maximumOrder * maximumTerms];
+    const size_t count = terms();
+    const double axes[3] = { r.x, r.y, r.z };
+
+    const double inverse2 = 1.0 / glm::dot(r, r);
+
+    /* R[j][0] = (-1)^j (2j - 1)!! / |r|^(2j + 1) */
+    double base[maximumOrder + 1];
+    base[0] = std::sqrt(inverse2);
+    for (int j = 1; j <= order; ++j)
+        base[j] = base[j - 1] * -double(2 * j - 1) * inverse2;
+
+    /* Each row only needs the one after it, and only up to the degree that's left. R[0] is written straight to out. */
+    for (int j = order; j >= 0; --j) {
+        double* row = j > 0 ? &R[(j - 1) * count] : out;
+        const double* next = &R[j * count];
+
+        row[0] = base[j];
+
+        if (j == order)
+            continue;
+
+        const uint32_t end = degreeEnd[order - j];
+        for (uint32_t t = 1; t < end; ++t) {
+            const Term& term = termList[t];
+            row[t] = axes[term.axis] * next[term.parent] + double(term.parentPower) * next[term.grandparent];
+        }
+    }
+}
+
+void MultipoleTree::build(const float* masses, const float* radii, size_t count) {
+    nodes.clear();
+    x.resize(count);
+    y.resize(count);
+    z.resize(count);
+    m.resize(count);
+    r.resize(count);
+    original.resize(count);
+    scratch.resize(count);
+    octants.resize(count);
+
+    if (count == 0)
+        return;
+
+    /* Find the bounding box of everything. */
+    glm::vec3 minimum = positions[0], maximum = positions[0];
+    for (size_t i = 0; i < count; ++i) {
+        minimum = glm::min(minimum, positions[i]);
+        maximum = glm::max(maximum, positions[i]);
+        original[i] = uint32_t(i);
+    }
+
+    glm::vec3 size = maximum - minimum;
+
+    Node root;
+    root.boxCenter = (minimum + maximum) * 0.5f;
+    /* The root is a cube containing the whole box, never let it be completely flat. */
+    root.halfSize = std::max(std::max(size.x, size.y), std::max(size.z, 1.0e-3f)) * 0.5f;
+    root.first = 0;
+    root.count = uint32_t(count);
+    root.parent = 0;
+
+    nodes.push_back(root);
+
+    /* The partitioning only moves the original indices around, the body data is copied over once it's done. */
+    subdivide(0, 0);
+
+    for (size_t i = 0; i < count; ++i) {
+        const glm::vec3& position = positions[original[i]];
+        x[i] = position.x;
+        y[i] = position.y;
+        z[i] = position.z;
+        m[i] = masses[original[i]];
+        r[i] = radii[original[i]];
+    }
+
+    /* Sort the nodes by depth. */
+    uint32_t depths = 0;
+    for (const Node& node : nodes)
+        depths = std::max(depths, node.depth + 1);
+
+    levelStart.assign(depths + 1, 0);
+    for (const Node& node : nodes)
+        ++levelStart[node.depth + 1];
+    for (uint32_t d = 1; d <= depths; ++d)
+        levelStart[d] += levelStart[d - 1];
+
+    levelNodes.resize(nodes.size());
+    std::vector<uint32_t> next(levelStart.begin(), levelStart.end() - 1);
+    for (uint32_t i = 0; i < nodes.size(); ++i)
+        levelNodes[next[nodes[i].depth]++] = i;
+}
+
+void MultipoleTree::subdivide(uint32_t index, uint32_t depth) {
+    /* Work on a copy, nodes may be reallocated when children get added. */
+    Node node = nodes[index];
+
+    node.depth = depth;
+    node.firstChild = 0;
+    node.childCount = 0;
+
+    if (node.count > leafCapacity && depth < maximumDepth) {
+        /* Sort the bodies into octants, bit 0 is x, bit 1 is y, and bit 2 is z. */
+        uint32_t counts[8] = {};
+        for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+            const glm::vec3& p = positions[original[i]];
+            octants[i] = (p.x > node.boxCenter.x ? 1 : 0) | (p.y > node.boxCenter.y ? 2 : 0) | (p.z > node.boxCenter.z ? 4 : 0);
+            ++counts[octants[i]];
+        }
+
+        uint32_t offsets[8];
+        offsets[0] = node.first;
+        for (int i = 1; i < 8; ++i)
+            offsets[i] = offsets[i - 1] + counts[i - 1];
+
+        /* Scatter into the scratch space and copy back, so each octant ends up contiguous. */
+        for (uint32_t i = node.first; i < node.first + node.count; ++i)
+            scratch[offsets[octants[i]]++] = original[i];
+        std::copy(scratch.begin() + node.first, scratch.begin() + node.first + node.count, original.begin() + node.first);
+
+        node.firstChild = uint32_t(nodes.size());
+
+        const float childHalf = node.halfSize * 0.5f;
+        uint32_t first = node.first;
+
+        for (uint32_t octant = 0; octant < 8; ++octant) {
+            if (counts[octant] == 0)
+                continue;
+
+            Node child;
+            child.boxCenter = node.boxCenter + glm::vec3(octant & 1 ? childHalf : -childHalf,
+                                                         octant & 2 ? childHalf : -childHalf,
+                                                         octant & 4 ? childHalf : -childHalf);
+            child.halfSize = childHalf;
+            child.first = first;
+            child.count = counts[octant];
+            child.parent = index;
+
+            first += counts[octant];
+
+            nodes.push_back(child);
+            ++node.childCount;
+        }
+
+        nodes[index] = node;
+
+        for (uint32_t child = node.firstChild; child < node.firstChild + node.childCount; ++child)
+            subdivide(child, depth + 1);
+    } else {
+        nodes[index] = node;
+    }
+}
+
+void MultipoleTree::upward(uint32_t index) {
+    Node& node = nodes[index];
+    double* multipole = &multipoles[index * terms()];
+
+    std::fill(multipole, multipole + terms(), 0.0);
+
+    node.mass = 0.0;
+    node.center = glm::dvec3();
+    node.radius = 0.0;
+    node.maxRadius = 0.0f;
+
+    if (node.childCount == 0) {
+        for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+            node.mass += m[i];
+            node.center += glm::dvec3(x[i], y[i], z[i]) * double(m[i]);
+            node.maxRadius = std::max(node.maxRadius, r[i]);
+        }
+    } else {
+        for (uint32_t child = node.firstChild; child < node.firstChild + node.childCount; ++child) {
+            node.mass += nodes[child].mass;
+            node.center += nodes[child].center * nodes[child].mass;
+            node.maxRadius = std::max(node.maxRadius, nodes[child].maxRadius);
+        }
+    }
+
+    /* Massless nodes don't have a center of mass, they won't add anything anyway. */
+    node.center = node.mass > 0.0 ? node.center / node.mass : glm::dvec3(node.boxCenter);
+
+    double powers[maximumTerms];
+
+    if (node.childCount == 0) {
+        for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+            const glm::dvec3 offset = glm::dvec3(x[i], y[i], z[i]) - node.center;
+            node.radius = std::max(node.radius, glm::length(offset));
+
+            monomials(-offset, powers);
+            for (size_t t = 0; t < terms(); ++t)
+                multipole[t] += powers[t] * m[i];
+        }
+    } else {
+        for (uint32_t child = node.firstChild; child < node.firstChild + node.childCount; ++child) {
+            const glm::dvec3 offset = nodes[child].center - node.center;
+            node.radius = std::max(node.radius, glm::length(offset) + nodes[child].radius);
+
+            /* Move the child's expansion over to this node's center. */
+            monomials(-offset, powers);
+            const double* source = &multipoles[child * terms()];
+            for (const Shift& shift : shifts)
+                multipole[shift.b] += source[shift.a] * powers[shift.c];
+        }
+    }
+}
+
+template<bool Merging> void MultipoleTree::interact(uint32_t a, uint32_t b, double theta, uint32_t depth, uint32_t deferDepth,
+                                                    Interactions& out) const {
+    if (depth >= deferDepth) {
+        out.deferred.emplace_back(a, b);
+        return;
+    }
+
+    const Node& na = nodes[a];
+
+    if (a == b) {
+        if (na.childCount == 0) {
+            out.near.emplace_back(a, a);
+        } else {
+            /* Every pair of children, including each child with itself. */
+            for (uint32_t i = na.firstChild; i < na.firstChild + na.childCount; ++i)
+                for (uint32_t j = i; j < na.firstChild + na.childCount; ++j)
+                    interact<Merging>(i, j, theta, depth + 1, deferDepth, out);
+        }
+        return;
+    }
+
+    const Node& nb = nodes[b];
+
+    const double distance = glm::length(na.center - nb.center);
+
+    /* Far enough apart for the expansions to be good enough, and with merging nothing in one can possibly be touching anything in the other. */
+    if (na.radius + nb.radius < theta * distance && (!Merging || distance - na.radius - nb.radius > double(na.maxRadius + nb.maxRadius))) {
+        out.far.emplace_back(a, b);
+        out.far.emplace_back(b, a);
+        return;
+    }
+
+    if (na.childCount == 0 && nb.childCount == 0) {
+        out.near.emplace_back(a, b);
+        out.near.emplace_back(b, a);
+        return;
+    }
+
+    /* Split up the bigger one. */
+    if (nb.childCount == 0 || (na.childCount != 0 && na.radius >= nb.radius)) {
+        for (uint32_t child = na.firstChild; child < na.firstChild + na.childCount; ++child)
+            interact<Merging>(child, b, theta, depth + 1, deferDepth, out);
+    } else {
+        for (uint32_t child = nb.firstChild; child < nb.firstChild + nb.childCount; ++child)
+            interact<Merging>(a, child, theta, depth + 1, deferDepth, out);
+    }
+}
+
+void MultipoleTree::group(const std::vector<Interactions>& lists, node_pairs Interactions::* member, size_t nodeCount,
+                          std::vector<uint32_t>& start, std::vector<uint32_t>& sources) {
+    start.assign(nodeCount + 1, 0);
+
+    size_t total = 0;
+    for (const Interactions& list : lists) {
+        for (const std::pair<uint32_t, uint32_t>& pair : list.*member)
+            ++start[pair.first + 1];
+        total += (list.*member).size();
+    }
+
+    for (size_t i = 1; i <= nodeCount; ++i)
+        start[i] += start[i - 1];
+
+    sources.resize(total);
+    std::vector<uint32_t> next(start.begin(), start.end() - 1);
+
+    for (const Interactions& list : lists)
+        for (const std::pair<uint32_t, uint32_t>& pair : list.*member)
+            sources[next[pair.first]++] = pair.second;
+}
+
+template<bool Merging> void MultipoleTree::accelerations(const glm::vec3* bodies, const float* masses, const float* radii, size_t count,
+                                                         int newOrder, float tolerance, ThreadPool& pool, glm::vec3* result,
+                                                         pair_list& merges) {
+    newOrder = glm::clamp(newOrder, 1, maximumOrder);
+    if (newOrder != order)
+        setOrder(newOrder);
+
+    positions = bodies;
+    build(masses, radii, count);
+    positions = nullptr;
+
+    if (count == 0)
+        return;
+
+    const size_t termCount = terms();
+    const uint32_t levels = uint32_t(levelStart.size() - 1);
+
+    multipoles.resize(nodes.size() * termCount);
+    locals.resize(nodes.size() * termCount);
+
+    /* Multipoles go from the leaves up, every node in a level only needs the level below it. */
+    for (uint32_t level = levels; level-- > 0;) {
+        const uint32_t* levelBegin = &levelNodes[levelStart[level]];
+
+        pool.parallelFor(levelStart[level + 1] - levelStart[level], 16, [&](size_t begin, size_t end, unsigned int) {
+            for (size_t i = begin; i < end; ++i)
+                upward(levelBegin[i]);
+        });
+    }
+
+    /* The error from a pair of nodes is bounded by ((size of both) / distance)^(order + 1), so that decides how close they can be.
+     * Errors from different pairs mostly cancel out, the total ends up around a hundredth of the bound, hence the scale. */
+    const double theta = std::min(std::pow(double(std::max(tolerance, 1.0e-12f)) * 100.0, 1.0 / double(order + 1)), 0.9);
+
+    threadInteractions.resize(pool.threadCount());
+    for (Interactions& list : threadInteractions) {
+        list.far.clear();
+        list.near.clear();
+        list.deferred.clear();
+    }
+
+    /* Walk the top few levels here, and hand what's left over to the threads. */
+    interact<Merging>(0, 0, theta, 0, pool.threadCount() > 1 ? 3 : ~uint32_t(0), threadInteractions[0]);
+
+    const node_pairs deferred = threadInteractions[0].deferred;
+
+    pool.parallelFor(deferred.size(), 1, [&](size_t begin, size_t end, unsigned int thread) {
+        for (size_t i = begin; i < end; ++i)
+            interact<Merging>(deferred[i].first, deferred[i].second, theta, 0, ~uint32_t(0), threadInteractions[thread]);
+    });
+
+    group(threadInteractions, &Interactions::far, nodes.size(), farStart, farSources);
+    group(threadInteractions, &Interactions::near, nodes.size(), nearStart, nearSources);
+
+    /* Locals go from the root down, each node gets its parent's expansion plus everything far from it. */
+    for (uint32_t level = 0; level < levels; ++level) {
+        const uint32_t* levelBegin = &levelNodes[levelStart[level]];
+
+        pool.parallelFor(levelStart[level + 1] - levelStart[level], 16, [&](size_t begin, size_t end, unsigned int) {
+            double powers[maximumTerms], derivative[maximumTerms];
+
+            for (size_t i = begin; i < end; ++i) {
+                const uint32_t index = levelBegin[i];
+                const Node& node = nodes[index];
+                double* local = &locals[index * termCount];
+
+                std::fill(local, local + termCount, 0.0);
+
+                if (index != 0) {
+                    monomials(node.center - nodes[node.parent].center, powers);
+                    const double* parent = &locals[node.parent * termCount];
+                    for (const Shift& shift : shifts)
+                        local[shift.a] += parent[shift.b] * powers[shift.c];
+                }
+
+                for (uint32_t f = farStart[index]; f < farStart[index + 1]; ++f) {
+                    const uint32_t source = farSources[f];
+
+                    derivatives(node.center - nodes[source].center, derivative);
+                    const double* multipole = &multipoles[source * termCount];
+
+                    for (size_t b = 0; b < termCount; ++b) {
+                        const double m = multipole[b];
+                        for (uint32_t k = conversionStart[b]; k < conversionStart[b + 1]; ++k)
+                            local[conversionLocal[k]] += derivative[conversionDerivative[k]] * m;
+                    }
+                }
+            }
+        });
+    }
+
+    threadMerges.resize(pool.threadCount());
+    for (pair_list& list : threadMerges)
+        list.clear();
+
+    /* Finally each leaf's bodies get the local expansion's gradient, plus everything in the near leaves directly. */
+    pool.parallelFor(nodes.size(), 16, [&](size_t begin, size_t end, unsigned int thread) {
+        double powers[maximumTerms];
+
+        for (size_t index = begin; index < end; ++index) {
+            const Node& node = nodes[index];
+
+            if (node.childCount != 0)
+                continue;
+
+            const double* local = &locals[index * termCount];
+
+            for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+                monomials(glm::dvec3(x[i], y[i], z[i]) - node.center, powers);
+
+                glm::dvec3 far;
+                for (size_t t = 0; t < termCount; ++t) {
+                    const Term& term = termList[t];
+                    if (term.degree == order)
+                        break;
+
+                    far.x += powers[t] * local[termIndex(term.x + 1, term.y, term.z)];
+                    far.y += powers[t] * local[termIndex(term.x, term.y + 1, term.z)];
+                    far.z += powers[t] * local[termIndex(term.x, term.y, term.z + 1)];
+                }
+
+                const glm::vec3 position(x[i], y[i], z[i]);
+                const float radius = r[i];
+                glm::vec3 near;
+                int overlapping = 0;
+
+                /* The body itself and anything touching it are left out. */
+                for (uint32_t n = nearStart[index]; n < nearStart[index + 1]; ++n) {
+                    const Node& source = nodes[nearSources[n]];
+                    nearField<Merging>(x.data(), y.data(), z.data(), m.data(), r.data(), source.first, source.first + source.count,
+                              position, radius, near, overlapping);
+                }
+
+                /* Anything other than the body itself overlapping means going back to find out what it was. */
+                if (Merging && overlapping > 1) {
+                    for (uint32_t n = nearStart[index]; n < nearStart[index + 1]; ++n) {
+                        const Node& source = nodes[nearSources[n]];
+
+                        for (uint32_t j = source.first; j < source.first + source.count; ++j) {
+                            const float dx = x[j] - position.x, dy = y[j] - position.y, dz = z[j] - position.z;
+                            const float touching = radius + r[j];
+
+                            /* Both bodies will find each other, only report it from the first one. */
+                            if (j != i && dx * dx + dy * dy + dz * dz < touching * touching && original[i] < original[j])
+                                threadMerges[thread].push_back(std::make_pair(size_t(original[i]), size_t(original[j])));
+                        }
+                    }
+                }
+
+                result[original[i]] = glm::vec3(far) + near;
+            }
+        }
+    });
+
+    if (Merging)
+        for (const pair_list& list : threadMerges)
+            merges.insert(merges.end(), list.begin(), list.end());
+}
+
+template void MultipoleTree::accelerations<false>(const glm::vec3* bodies, const float* masses, const float* radii, size_t count,
+                                                  int order, float tolerance, ThreadPool& pool, glm::vec3* result, pair_list& merges);
+template void MultipoleTree::accelerations<true>(const glm::vec3* bodies, const float* masses, const float* radii, size_t count,
+                                                 int order, float tolerance, ThreadPool& pool, glm::vec3* result, pair_list& merges);
+
+template<bool Merging> double MultipoleTree::measureError(const glm::vec3* positions, const float* masses, const float* radii,
+                                                          size_t count, const glm::vec3* result) {
+    const size_t samples = std::min(size_t(errorSamples), count);
+
+    double error = 0.0, total = 0.0;
+
+    for (size_t s = 0; s < samples; ++s) {
+        const size_t i = s * count / samples;
+
+        glm::dvec3 direct;
+        for (size_t j = 0; j < count; ++j) {
+            if (j == i)
+                continue;
+
+            const glm::dvec3 direction = glm::dvec3(positions[j]) - glm::dvec3(positions[i]);
+            const double distance2 = glm::dot(direction, direction);
+            const double touching = radii[i] + radii[j];
+
+            /* Touching pairs get merged instead, so they only count without merging. */
+            if (Merging ? distance2 >= touching * touching : distance2 > 0.0)
+                direct += direction * (masses[j] / (distance2 * std::sqrt(distance2)));
+        }
+
+        const glm::dvec3 difference = glm::dvec3(result[i]) - direct;
+        error += glm::dot(difference, difference);
+        total += glm::dot(direct, direct);
+    }
+
+    return total > 0.0 ? std::sqrt(error / total) : 0.0;
+}
+
+template double MultipoleTree::measureError<false>(const glm::vec3* positions, const float* masses, const float* radii, size_t count,
+                                                   const glm::vec3* result);
+template double MultipoleTree::measureError<true>(const glm::vec3* positions, const float* masses, const float* radii, size_t count,
+                                                  const glm::vec3* result);
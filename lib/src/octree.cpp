@@ -0,0 +1,187 @@
+#include "octree.h"
+#include <glm/glm.hpp>
+#include <algorithm>
+
+void Octree::build(const glm::vec3* p, const float* m, const float* r, size_t count) {
+    positions = p;
+    masses = m;
+    radii = r;
+
+    nodes.clear();
+    bodies.resize(count);
+    scratch.resize(count);
+    octants.resize(count);
+
+    if (count == 0)
+        return;
+
+    /* Find the bounding box of everything. */
+    glm::vec3 minimum = positions[0], maximum = positions[0];
+    for (size_t i = 0; i < count; ++i) {
+        minimum = glm::min(minimum, positions[i]);
+        maximum = glm::max(maximum, positions[i]);
+        bodies[i] = uint32_t(i);
+    }
+
+    glm::vec3 size = maximum - minimum;
+
+    Node root;
+    root.center = (minimum + maximum) * 0.5f;
+    /* The root is a cube containing the whole box, never let it be completely flat. */
+    root.halfSize = std::max(std::max(size.x, size.y), std::max(size.z, 1.0e-3f)) * 0.5f;
+    root.first = 0;
+    root.count = uint32_t(count);
+
+    nodes.push_back(root);
+
+    subdivide(0, 0);
+}
+
+void Octree::subdivide(uint32_t index, uint32_t depth) {
+    /* Work on a copy, nodes may be reallocated when children get added. */
+    Node node = nodes[index];
+
+    node.mass = 0.0f;
+    node.centerOfMass = glm::vec3();
+    node.maxRadius = 0.0f;
+    node.firstChild = 0;
+    node.childCount = 0;
+
+    if (node.count > leafCapacity && depth < maximumDepth) {
+        /* Sort the bodies into octants, bit 0 is x, bit 1 is y, and bit 2 is z. */
+        uint32_t counts[8] = {};
+        for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+            const glm::vec3& p = positions[bodies[i]];
+            octants[i] = (p.x > node.center.x ? 1 : 0) | (p.y > node.center.y ? 2 : 0) | (p.z > node.center.z ? 4 : 0);
+            ++counts[octants[i]];
+        }
+
+        uint32_t offsets[8];
+        offsets[0] = node.first;
+        for (int i = 1; i < 8; ++i)
+            offsets[i] = offsets[i - 1] + counts[i - 1];
+
+        /* Scatter into the scratch space and copy back, so each octant ends up contiguous. */
+        for (uint32_t i = node.first; i < node.first + node.count; ++i)
+            scratch[offsets[octants[i]]++] = bodies[i];
+        std::copy(scratch.begin() + node.first, scratch.begin() + node.first + node.count, bodies.begin() + node.first);
+
+        node.firstChild = uint32_t(nodes.size());
+
+        const float childHalf = node.halfSize * 0.5f;
+        uint32_t first = node.first;
+
+        for (uint32_t octant = 0; octant < 8; ++octant) {
+            if (counts[octant] == 0)
+                continue;
+
+            Node child;
+            child.center = node.center + glm::vec3(octant & 1 ? childHalf : -childHalf,
+                                                   octant & 2 ? childHalf : -childHalf,
+                                                   octant & 4 ? childHalf : -childHalf);
+            child.halfSize = childHalf;
+            child.first = first;
+            child.count = counts[octant];
+
+            first += counts[octant];
+
+            nodes.push_back(child);
+            ++node.childCount;
+        }
+
+        for (uint32_t child = node.firstChild; child < node.firstChild + node.childCount; ++child) {
+            subdivide(child, depth + 1);
+
+            const Node& c = nodes[child];
+            node.mass += c.mass;
+            node.centerOfMass += c.centerOfMass * c.mass;
+            node.maxRadius = std::max(node.maxRadius, c.maxRadius);
+        }
+    } else {
+        /* This is a leaf, just add up the bodies directly. */
+        for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+            uint32_t body = bodies[i];
+            node.mass += masses[body];
+            node.centerOfMass += positions[body] * masses[body];
+            node.maxRadius = std::max(node.maxRadius, radii[body]);
+        }
+    }
+
+    /* Finish the weighted average. */
+    node.centerOfMass = node.mass > 0.0f ? node.centerOfMass / node.mass : node.center;
+
+    nodes[index] = node;
+}
+
+template<bool Merging> glm::vec3 Octree::acceleration(size_t index, float openingAngle, pair_list& merges) const {
+    glm::vec3 result;
+
+    if (nodes.empty())
+        return result;
+
+    const glm::vec3 position = positions[index];
+    const float radius = radii[index];
+
+    /* Compare squared values so we don't need a square root for the opening test. */
+    const float openingAngle2 = openingAngle * openingAngle;
+
+    /* Depth first traversal, every level can add at most 8 nodes to the stack. */
+    uint32_t stack[8 * (maximumDepth + 1)];
+    uint32_t top = 0;
+    stack[top++] = 0;
+
+    while (top > 0) {
+        const Node& node = nodes[stack[--top]];
+
+        if (node.childCount == 0) {
+            /* Leaves are close enough that we do everything in them exactly. */
+            for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+                uint32_t body = bodies[i];
+
+                if (body == index)
+                    continue;
+
+                glm::vec3 direction = positions[body] - position;
+                float distance2 = direction.x * direction.x + direction.y * direction.y + direction.z * direction.z;
+
+                if (Merging) {
+                    float touching = radius + radii[body];
+
+                    if (distance2 < touching * touching) {
+                        /* Both planets will find each other, only report it from the first one. */
+                        if (index < body)
+                            merges.push_back(std::make_pair(index, size_t(body)));
+                        continue;
+                    }
+                } else if (distance2 == 0.0f) {
+                    continue;
+                }
+
+                result += direction * (masses[body] / (distance2 * std::sqrt(distance2)));
+            }
+            continue;
+        }
+
+        glm::vec3 direction = node.centerOfMass - position;
+        float distance2 = direction.x * direction.x + direction.y * direction.y + direction.z * direction.z;
+
+        /* How far outside of the node's cube the body is, zero on any axis where it is inside. */
+        glm::vec3 outside = glm::max(glm::abs(position - node.center) - glm::vec3(node.halfSize), glm::vec3());
+        float gap = Merging ? radius + node.maxRadius : 0.0f;
+
+        float size = node.halfSize * 2.0f;
+
+        /* Far enough away to treat as a single mass, and the body isn't inside it (or with merging, can't be touching anything in it). */
+        if (size * size < openingAngle2 * distance2 && glm::dot(outside, outside) > gap * gap) {
+            result += direction * (node.mass / (distance2 * std::sqrt(distance2)));
+        } else {
+            for (uint32_t child = node.firstChild; child < node.firstChild + node.childCount; ++child)
+                stack[top++] = child;
+        }
+    }
+
+    return result;
+}
+
+template glm::vec3 Octree::acceleration<false>(size_t index, float openingAngle, pair_list& merges) const;
+template glm::vec3 Octree::acceleration<true>(size_t index, float openingAngle, pair_list& merges) const;
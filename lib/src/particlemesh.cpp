@@ -0,0 +1,422 @@
+#include "particlemesh.h"
+#include <glm/glm.hpp>
+#include <glm/gtx/norm.hpp>
+#include <glm/gtx/component_wise.hpp>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+/* Cloud-in-cell, the cell a grid coordinate falls in (kept in the range that has a cell after it) and how far into it it is. */
+inline void cell(float x, uint32_t last, uint32_t& index, float& fraction) {
+    const float floor = std::floor(x);
+    index = uint32_t(std::min(std::max(floor, 1.0f), float(last)));
+    fraction = std::min(std::max(x - float(index), 0.0f), 1.0f);
+}
+
+/* The kernel the potential is convolved with, in cells. The cell itself gets the same value as one cell away. */
+inline float kernelAt(float x, float y, float z) {
+    const float distance2 = x * x + y * y + z * z;
+    return distance2 > 0.0f ? -1.0f / std::sqrt(distance2) : -1.0f;
+}
+
+}
+
+void ParticleMesh::resize(uint32_t newSize, ThreadPool& pool) {
+    size = newSize;
+    padded = newSize * 2;
+
+    const size_t cells = size_t(padded) * padded * padded;
+    grid.resize(cells);
+    fieldX.assign(size_t(size) * size * size, 0.0f);
+    fieldY.assign(fieldX.size(), 0.0f);
+    fieldZ.assign(fieldX.size(), 0.0f);
+
+    twiddles.resize(padded);
+    for (uint32_t k = 0; k < padded / 2; ++k) {
+        twiddles[k] = std::polar(1.0f, float(-2.0 * glm::pi<double>() * double(k) / double(padded)));
+        twiddles[k + padded / 2] = std::conj(twiddles[k]);
+    }
+
+    /* Distances wrap around the padded grid, so every body sees the others the short way round and never a copy. */
+    for (uint32_t z = 0; z < padded; ++z) {
+        const float dz = float(std::min(z, padded - z));
+        for (uint32_t y = 0; y < padded; ++y) {
+            const float dy = float(std::min(y, padded - y));
+            for (uint32_t x = 0; x < padded; ++x)
+                grid[(size_t(z) * padded + y) * padded + x] = kernelAt(float(std::min(x, padded - x)), dy, dz);
+        }
+    }
+
+    for (int axis = 0; axis < 3; ++axis)
+        transformAxis(axis, padded, padded, false, pool);
+
+    /* Fold the inverse transform's scale in, so it doesn't need its own pass. */
+    const float scale = 1.0f / float(cells);
+    kernel.resize(cells);
+    for (size_t i = 0; i < cells; ++i)
+        kernel[i] = grid[i].real() * scale;
+}
+
+void ParticleMesh::transform(complex_type* line, bool inverse) const {
+    /* Iterative radix 2, reorder by reversed bits first. */
+    for (uint32_t i = 1, j = 0; i < padded; ++i) {
+        uint32_t bit = padded >> 1;
+        for (; j & bit; bit >>= 1)
+            j ^= bit;
+        j ^= bit;
+
+        if (i < j)
+            std::swap(line[i], line[j]);
+    }
+
+    const complex_type* table = &twiddles[inverse ? padded / 2 : 0];
+
+    for (uint32_t length = 2; length <= padded; length <<= 1) {
+        const uint32_t half = length / 2, step = padded / length;
+
+        for (uint32_t start = 0; start < padded; start += length) {
+            for (uint32_t k = 0; k < half; ++k) {
+                const complex_type twiddle = table[k * step], value = line[start + k + half];
+
+                /* Written out since std::complex's multiply has to check for infinities. */
+                const complex_type odd(value.real() * twiddle.real() - value.imag() * twiddle.imag(),
+                                       value.real() * twiddle.imag() + value.imag() * twiddle.real());
+
+                line[start + k + half] = line[start + k] - odd;
+                line[start + k] += odd;
+            }
+        }
+    }
+}
+
+void ParticleMesh::transformAxis(int axis, uint32_t limitA, uint32_t limitB, bool inverse, ThreadPool& pool) {
+    const size_t strides[] = { 1, padded, size_t(padded) * padded };
+    /* The two axes that aren't being transformed, in order. */
+    const size_t strideA = strides[axis == 0 ? 1 : 0], strideB = strides[axis == 2 ? 1 : 2], stride = strides[axis];
+
+    lines.resize(pool.threadCount());
+
+    pool.parallelFor(size_t(limitA) * limitB, 16, [&](size_t begin, size_t end, unsigned int thread) {
+        std::vector<complex_type>& line = lines[thread];
+        line.resize(padded);
+
+        for (size_t l = begin; l < end; ++l) {
+            complex_type* start = &grid[(l % limitA) * strideA + (l / limitA) * strideB];
+
+            for (uint32_t i = 0; i < padded; ++i)
+                line[i] = start[i * stride];
+
+            transform(line.data(), inverse);
+
+            for (uint32_t i = 0; i < padded; ++i)
+                start[i * stride] = line[i];
+        }
+    });
+}
+
+void ParticleMesh::deposit(const glm::vec3* positions, const float* masses, size_t count) {
+    std::fill(grid.begin(), grid.end(), complex_type());
+
+    for (size_t i = 0; i < count; ++i) {
+        const glm::vec3 g = (positions[i] - lower) / spacing + 1.0f;
+
+        uint32_t x, y, z;
+        glm::vec3 f;
+        cell(g.x, size - 2, x, f.x);
+        cell(g.y, size - 2, y, f.y);
+        cell(g.z, size - 2, z, f.z);
+
+        for (int corner = 0; corner < 8; ++corner) {
+            const uint32_t cx = corner & 1, cy = (corner >> 1) & 1, cz = corner >> 2;
+            const float weight = (cx ? f.x : 1.0f - f.x) * (cy ? f.y : 1.0f - f.y) * (cz ? f.z : 1.0f - f.z);
+
+            grid[(size_t(z + cz) * padded + y + cy) * padded + x + cx] += masses[i] * weight;
+        }
+    }
+}
+
+void ParticleMesh::gradient(ThreadPool& pool) {
+    /* The potential uses a kernel with a spacing of 1, so it needs dividing by spacing once for that and once for the difference. */
+    const float scale = -0.5f / (spacing * spacing);
+    const size_t row = padded, slice = size_t(padded) * padded;
+
+    /* Only cells 1 to size - 1 ever get used, those all have a neighbour on each side that's still valid. */
+    pool.parallelFor(size - 1, 1, [&](size_t begin, size_t end, unsigned int) {
+        for (size_t z = begin + 1; z < end + 1; ++z) {
+            for (size_t y = 1; y < size; ++y) {
+                for (size_t x = 1; x < size; ++x) {
+                    const complex_type* potential = &grid[z * slice + y * row + x];
+                    const size_t out = (z * size + y) * size + x;
+
+                    fieldX[out] = (potential[1].real() - potential[-1].real()) * scale;
+                    fieldY[out] = (potential[row].real() - potential[-ptrdiff_t(row)].real()) * scale;
+                    fieldZ[out] = (potential[slice].real() - potential[-ptrdiff_t(slice)].real()) * scale;
+                }
+            }
+        }
+    });
+}
+
+void ParticleMesh::fillBuckets(const glm::vec3* positions, size_t count, float reach) {
+    bucketSize = reach;
+
+    size_t total = 1;
+    for (int axis = 0; axis < 3; ++axis) {
+        buckets[axis] = uint32_t((upper[axis] - lower[axis]) / bucketSize) + 1;
+        total *= buckets[axis];
+    }
+
+    bucketStart.assign(total + 1, 0);
+    bucketBodies.resize(count);
+    bucketOf.resize(count);
+
+    /* Counting sort, so each bucket's bodies end up next to each other. */
+    for (size_t i = 0; i < count; ++i) {
+        const glm::uvec3 b = glm::min(glm::uvec3((positions[i] - lower) / bucketSize), glm::uvec3(buckets[0], buckets[1], buckets[2]) - 1u);
+        bucketOf[i] = (b.z * buckets[1] + b.y) * buckets[0] + b.x;
+        ++bucketStart[bucketOf[i] + 1];
+    }
+
+    for (size_t b = 0; b < total; ++b)
+        bucketStart[b + 1] += bucketStart[b];
+
+    std::vector<uint32_t> next(bucketStart.begin(), bucketStart.end() - 1);
+    for (size_t i = 0; i < count; ++i)
+        bucketBodies[next[bucketOf[i]]++] = uint32_t(i);
+}
+
+template<bool Merging> void ParticleMesh::correction(const glm::vec3* positions, const float* masses, const float* radii, size_t i,
+                                                     glm::vec3& acceleration, pair_list& merges) const {
+    const glm::vec3& position = positions[i];
+    const float range = correctionRange * spacing, range2 = range * range, reach2 = bucketSize * bucketSize;
+
+    const glm::ivec3 b = glm::min(glm::ivec3((position - lower) / bucketSize), glm::ivec3(buckets[0], buckets[1], buckets[2]) - 1);
+
+    for (int z = std::max(b.z - 1, 0); z <= std::min(b.z + 1, int(buckets[2]) - 1); ++z) {
+        for (int y = std::max(b.y - 1, 0); y <= std::min(b.y + 1, int(buckets[1]) - 1); ++y) {
+            for (int x = std::max(b.x - 1, 0); x <= std::min(b.x + 1, int(buckets[0]) - 1); ++x) {
+                const size_t bucket = (size_t(z) * buckets[1] + y) * buckets[0] + x;
+
+                for (uint32_t n = bucketStart[bucket]; n < bucketStart[bucket + 1]; ++n) {
+                    const size_t j = bucketBodies[n];
+                    const glm::vec3 direction = positions[j] - position;
+                    const float distance2 = glm::length2(direction);
+
+                    if (j == i || distance2 >= reach2)
+                        continue;
+
+                    bool overlapping = false;
+                    if (Merging) {
+                        const float touching = radii[i] + radii[j];
+                        overlapping = distance2 < touching * touching || distance2 == 0.0f;
+
+                        if (overlapping && i < j)
+                            merges.push_back(std::make_pair(i, j));
+                    }
+
+                    if (distance2 >= range2 || distance2 == 0.0f)
+                        continue;
+
+                    /* Take the grid's version of this pair out, and put the real one in unless they're about to merge. */
+                    const float distance = std::sqrt(distance2);
+                    float force = -meshForce(distance / spacing) / (spacing * spacing * distance);
+                    if (!overlapping)
+                        force += 1.0f / (distance2 * distance);
+
+                    acceleration += direction * (force * masses[j]);
+                }
+            }
+        }
+    }
+}
+
+float ParticleMesh::meshForce(float distance) {
+    constexpr int bins = 96;
+    /* Midpoint rule steps along each axis of where the source is in its cell, and across equal area bands of directions
+     * and around each band. Against a much finer version of the same sums every bin is within 0.2%. */
+    constexpr int sourceSteps = 4;
+    constexpr int bands = 16, turns = 32;
+
+    /* Put a unit mass somewhere in a cell, and measure the pull in every direction the right distance away the same way
+     * the grid would. Reflecting the source in the middle of the cell reflects the whole grid, so only the corner of the
+     * cell nearest the origin is needed. Only the cells near the source matter, so the kernel is used directly instead of
+     * a transform, and the field at each node is worked out once per source position rather than once per target. */
+    static const std::vector<float> table = [] {
+        const int low = -int(std::ceil(correctionRange)), high = int(std::ceil(correctionRange)) + 1;
+        const int nodes = high - low + 1, side = nodes + 2;
+
+        std::vector<glm::vec3> directions;
+        for (int band = 0; band < bands; ++band) {
+            const float cosTheta = (float(band) + 0.5f) / float(bands) * 2.0f - 1.0f;
+            const float sinTheta = std::sqrt(1.0f - cosTheta * cosTheta);
+
+            for (int turn = 0; turn < turns; ++turn) {
+                const float phi = (float(turn) + 0.5f) / float(turns) * 2.0f * glm::pi<float>();
+                directions.push_back(glm::vec3(sinTheta * std::cos(phi), sinTheta * std::sin(phi), cosTheta));
+            }
+        }
+
+        std::vector<double> sums(bins + 1, 0.0);
+        /* The potential from low - 1 to high + 1 on each axis, and the field at the nodes in between. */
+        std::vector<float> potential(size_t(side) * side * side);
+        std::vector<glm::vec3> field(size_t(nodes) * nodes * nodes);
+
+        auto potentialAt = [&](int x, int y, int z) { return potential[(size_t(z + 1) * side + y + 1) * side + x + 1]; };
+
+        for (int sz = 0; sz < sourceSteps; ++sz) for (int sy = 0; sy < sourceSteps; ++sy) for (int sx = 0; sx < sourceSteps; ++sx) {
+            const glm::vec3 source = (glm::vec3(sx, sy, sz) + 0.5f) / float(sourceSteps * 2);
+
+            for (int z = 0; z < side; ++z) {
+                for (int y = 0; y < side; ++y) {
+                    for (int x = 0; x < side; ++x) {
+                        const glm::vec3 at = glm::vec3(x, y, z) + float(low - 1);
+                        float result = 0.0f;
+                        for (int corner = 0; corner < 8; ++corner) {
+                            const glm::vec3 offset(corner & 1, (corner >> 1) & 1, corner >> 2);
+                            const glm::vec3 weights = glm::mix(1.0f - source, source, offset);
+                            const glm::vec3 d = at - offset;
+                            result += weights.x * weights.y * weights.z * kernelAt(d.x, d.y, d.z);
+                        }
+                        potential[(size_t(z) * side + y) * side + x] = result;
+                    }
+                }
+            }
+
+            for (int z = 0; z < nodes; ++z) {
+                for (int y = 0; y < nodes; ++y) {
+                    for (int x = 0; x < nodes; ++x) {
+                        field[(size_t(z) * nodes + y) * nodes + x] = -0.5f *
+                                glm::vec3(potentialAt(x + 1, y, z) - potentialAt(x - 1, y, z),
+                                          potentialAt(x, y + 1, z) - potentialAt(x, y - 1, z),
+                                          potentialAt(x, y, z + 1) - potentialAt(x, y, z - 1));
+                    }
+                }
+            }
+
+            for (int bin = 1; bin <= bins; ++bin) {
+                const float s = correctionRange * float(bin) / float(bins);
+                double sum = 0.0;
+
+                for (const glm::vec3& direction : directions) {
+                    const glm::vec3 target = source + direction * s;
+                    const glm::vec3 base = glm::floor(target), f = target - base;
+                    const glm::ivec3 index = glm::ivec3(base) - low;
+
+                    glm::vec3 pull;
+                    for (int corner = 0; corner < 8; ++corner) {
+                        const glm::ivec3 offset(corner & 1, (corner >> 1) & 1, corner >> 2);
+                        const glm::vec3 weights = glm::mix(1.0f - f, f, glm::vec3(offset));
+                        const glm::ivec3 node = index + offset;
+                        pull += weights.x * weights.y * weights.z * field[(size_t(node.z) * nodes + node.y) * nodes + node.x];
+                    }
+
+                    /* The pull back toward the source. */
+                    sum -= glm::dot(pull, direction);
+                }
+
+                sums[bin] += sum;
+            }
+        }
+
+        std::vector<float> table(bins + 1, 0.0f);
+        for (int bin = 1; bin <= bins; ++bin)
+            table[bin] = float(sums[bin] / (double(sourceSteps * sourceSteps * sourceSteps) * double(directions.size())));
+
+        return table;
+    }();
+
+    const float position = std::min(distance / correctionRange, 1.0f) * bins;
+    const int bin = std::min(int(position), bins - 1);
+    return glm::mix(table[bin], table[bin + 1], position - float(bin));
+}
+
+template<bool Merging> void ParticleMesh::accelerations(const glm::vec3* positions, const float* masses, const float* radii, size_t count,
+                                                        uint32_t requestedSize, bool correct, ThreadPool& pool, glm::vec3* result,
+                                                        pair_list& merges) {
+    if (count == 0)
+        return;
+
+    /* Round down to a power of two in the allowed range. */
+    uint32_t newSize = minimumSize;
+    while (newSize * 2 <= std::min(requestedSize, uint32_t(maximumSize)))
+        newSize *= 2;
+
+    if (newSize != size)
+        resize(newSize, pool);
+
+    lower = upper = positions[0];
+    float largest = 0.0f;
+    for (size_t i = 1; i < count; ++i) {
+        lower = glm::min(lower, positions[i]);
+        upper = glm::max(upper, positions[i]);
+        largest = std::max(largest, radii[i]);
+    }
+    largest = std::max(largest, radii[0]);
+
+    /* Bodies land in cells 1 to size - 2, leaving room for the cloud-in-cell spread and the gradient around them. */
+    const float extent = std::max(glm::compMax(upper - lower), 1.0e-3f);
+    spacing = extent / float(size - 3);
+
+    deposit(positions, masses, count);
+
+    /* Everything is in the corner of the padded grid, so the first passes only need the lines that go through it. */
+    transformAxis(0, size, size, false, pool);
+    transformAxis(1, padded, size, false, pool);
+    transformAxis(2, padded, padded, false, pool);
+
+    pool.parallelFor(grid.size(), 4096, [&](size_t begin, size_t end, unsigned int) {
+        for (size_t i = begin; i < end; ++i)
+            grid[i] *= kernel[i];
+    });
+
+    /* And only a corner of the result is needed, one cell bigger than the bodies' grid so the gradient has both neighbours. */
+    transformAxis(2, padded, padded, true, pool);
+    transformAxis(1, padded, size + 1, true, pool);
+    transformAxis(0, size + 1, size + 1, true, pool);
+
+    gradient(pool);
+
+    /* Merges have to be found out to the biggest pair of planets, otherwise only as far as the correction goes. */
+    if (correct)
+        fillBuckets(positions, count, Merging ? std::max(correctionRange * spacing, largest * 2.0f) : correctionRange * spacing);
+
+    threadMerges.resize(pool.threadCount());
+    for (pair_list& list : threadMerges)
+        list.clear();
+
+    pool.parallelFor(count, 64, [&](size_t begin, size_t end, unsigned int thread) {
+        for (size_t i = begin; i < end; ++i) {
+            const glm::vec3 g = (positions[i] - lower) / spacing + 1.0f;
+
+            uint32_t x, y, z;
+            glm::vec3 f;
+            cell(g.x, size - 2, x, f.x);
+            cell(g.y, size - 2, y, f.y);
+            cell(g.z, size - 2, z, f.z);
+
+            glm::vec3 acceleration;
+            for (int corner = 0; corner < 8; ++corner) {
+                const uint32_t cx = corner & 1, cy = (corner >> 1) & 1, cz = corner >> 2;
+                const float weight = (cx ? f.x : 1.0f - f.x) * (cy ? f.y : 1.0f - f.y) * (cz ? f.z : 1.0f - f.z);
+                const size_t index = (size_t(z + cz) * size + y + cy) * size + x + cx;
+
+                acceleration += glm::vec3(fieldX[index], fieldY[index], fieldZ[index]) * weight;
+            }
+
+            if (correct)
+                correction<Merging>(positions, masses, radii, i, acceleration, threadMerges[thread]);
+
+            result[i] = acceleration;
+        }
+    });
+
+    if (Merging)
+        for (const pair_list& list : threadMerges)
+            merges.insert(merges.end(), list.begin(), list.end());
+}
+
+template void ParticleMesh::accelerations<false>(const glm::vec3* positions, const float* masses, const float* radii, size_t count,
+                                                 uint32_t size, bool correct, ThreadPool& pool, glm::vec3* result, pair_list& merges);
+template void ParticleMesh::accelerations<true>(const glm::vec3* positions, const float* masses, const float* radii, size_t count,
+                                                uint32_t size, bool correct, ThreadPool& pool, glm::vec3* result, pair_list& merges);
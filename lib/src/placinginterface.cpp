@@ -1,16 +1,29 @@
 #include "placinginterface.h"
 #include "planetsuniverse.h"
 #include "camera.h"
+#include "simulationrunner.h"
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/transform.hpp>
 #include <glm/gtx/rotate_vector.hpp>
 
-PlacingInterface::PlacingInterface(PlanetsUniverse& u) : universe(u), firingSpeed(PlanetsUniverse::velocityFactor * 10.0f), rotation(1.0f) {
+PlacingInterface::PlacingInterface(SimulationRunner& r) : runner(r), firingSpeed(PlanetsUniverse::velocityFactor * 10.0f), rotation(1.0f) {
     planet.velocity.y = PlanetsUniverse::velocityFactor;
 }
 
+void PlacingInterface::followOrigin() {
+    const glm::dvec3& current = runner.current().origin;
+
+    if (current != origin) {
+        planet.position -= glm::vec3(current - origin);
+        origin = current;
+    }
+}
+
 bool PlacingInterface::handleMouseMove(const glm::ivec2& pos, const glm::ivec2& delta, const Camera& camera, bool& holdMouse) {
+    const Snapshot& snapshot = runner.current();
+    followOrigin();
+
     switch (step) {
     case FreePositionXY: {
         /* Set placing position on the XY plane. */
@@ -33,14 +46,14 @@ bool PlacingInterface::handleMouseMove(const glm::ivec2& pos, const glm::ivec2&
         holdMouse = true;
         return true;
     case OrbitalPlanet:
-        if (universe.isSelectedValid()) {
+        if (snapshot.isSelectedValid()) {
             Ray ray = camera.getRay(pos);
 
             /* Set the position on an XY plane at the Z of the target planet. */
-            planet.position = ray.origin + (ray.direction * ((universe.getSelected().position.z - ray.origin.z) / ray.direction.z));
+            planet.position = ray.origin + (ray.direction * ((snapshot.getSelected().position.z - ray.origin.z) / ray.direction.z));
 
             /* Get the radius from the position of the orbiting planet relative to the target planet. */
-            glm::vec3 relative = planet.position - universe.getSelected().position;
+            glm::vec3 relative = planet.position - snapshot.getSelected().position;
             orbitalRadius = glm::length(relative);
 
             /* Use the normalized direction between the orbit planet and target to create the rotation matrix. */
@@ -54,13 +67,13 @@ bool PlacingInterface::handleMouseMove(const glm::ivec2& pos, const glm::ivec2&
         }
         break;
     case OrbitalPlane:
-        if (universe.isSelectedValid()) {
+        if (snapshot.isSelectedValid()) {
             /* Put mouse delta directly into rotation. */
             rotation *= glm::rotate(delta.x * 1.0e-3f, glm::vec3(1.0f, 0.0f, 0.0f));
             rotation *= glm::rotate(delta.y * 1.0e-3f, glm::vec3(0.0f, 1.0f, 0.0f));
 
             /* Set the position based on radius and rotation matrix. */
-            planet.position = universe.getSelected().position + glm::vec3(rotation[0] * orbitalRadius);
+            planet.position = snapshot.getSelected().position + glm::vec3(rotation[0] * orbitalRadius);
             holdMouse = true;
             return true;
         }
@@ -70,6 +83,9 @@ bool PlacingInterface::handleMouseMove(const glm::ivec2& pos, const glm::ivec2&
 }
 
 bool PlacingInterface::handleMouseClick(const glm::ivec2& pos, const Camera& camera) {
+    const Snapshot& snapshot = runner.current();
+    followOrigin();
+
     switch (step) {
     case FreePositionXY:
         step = FreePositionZ;
@@ -77,20 +93,35 @@ bool PlacingInterface::handleMouseClick(const glm::ivec2& pos, const Camera& cam
     case FreePositionZ:
         step = FreeVelocity;
         return true;
-    case FreeVelocity:
+    case FreeVelocity: {
         step = NotPlacing;
         planet.velocity = glm::vec3(rotation[2]) * glm::length(planet.velocity);
-        universe.selected = universe.addPlanet(planet);
+
+        const Planet placed = planet;
+        const glm::dvec3 from = origin;
+        runner.post([=](PlanetsUniverse& universe) {
+            /* The universe may have been rebased again since the snapshot it was placed in. */
+            Planet moved = placed;
+            moved.position -= glm::vec3(universe.origin() - from);
+            universe.selected = universe.addPlanet(moved);
+        });
         return true;
+    }
     case Firing: {
         Ray ray = camera.getRay(pos);
 
-        universe.addPlanet(Planet(ray.origin, ray.direction * firingSpeed, firingMass));
+        const Planet fired(ray.origin, ray.direction * firingSpeed, firingMass);
+        const glm::dvec3 from = origin;
+        runner.post([=](PlanetsUniverse& universe) {
+            Planet moved = fired;
+            moved.position -= glm::vec3(universe.origin() - from);
+            universe.addPlanet(moved);
+        });
         return true;
     }
     case OrbitalPlanet:
         /* If a planet is selected go to the next step. */
-        if (universe.isSelectedValid()) {
+        if (snapshot.isSelectedValid()) {
             step = OrbitalPlane;
             return true;
         }
@@ -103,8 +134,16 @@ bool PlacingInterface::handleMouseClick(const glm::ivec2& pos, const Camera& cam
         /* No matter what exit placing mode. */
         step = NotPlacing;
 
-        if (universe.isSelectedValid()) {
-            universe.addOrbital(universe.getSelected(), orbitalRadius, planet.mass(), rotation);
+        if (snapshot.isSelectedValid()) {
+            const key_type target = snapshot.selected;
+            const float radius = orbitalRadius, mass = planet.mass();
+            const glm::mat4 plane = rotation;
+
+            /* The target could have merged with something before this gets run. */
+            runner.post([=](PlanetsUniverse& universe) {
+                if (universe.isValid(target))
+                    universe.addOrbital(target, radius, mass, plane);
+            });
 
             orbitalRadius = 0.0f;
             return true;
@@ -131,6 +170,9 @@ bool PlacingInterface::handleMouseWheel(float delta) {
 }
 
 bool PlacingInterface::handleAnalogStick(const glm::vec2& pos, const bool& modifier, Camera& camera) {
+    const Snapshot& snapshot = runner.current();
+    followOrigin();
+
     if (modifier) {
         float y = pos.y * 10.0f;
         switch (step) {
@@ -163,16 +205,16 @@ bool PlacingInterface::handleAnalogStick(const glm::vec2& pos, const bool& modif
         planet.velocity = glm::vec3(rotation[2]) * glm::length(planet.velocity);
         return true;
     case OrbitalPlanet:
-        if (universe.isSelectedValid()) {
+        if (snapshot.isSelectedValid()) {
             /* In this step the planet is locked at the same z coord as the one it's orbiting. */
-            planet.position.z = universe.getSelected().position.z;
+            planet.position.z = snapshot.getSelected().position.z;
 
             /* Set placing position on XY plane. */
             planet.position += glm::rotateZ(glm::vec3(pos.x, -pos.y, 0.0f) * camera.distance, -camera.zrotation);
             camera.position = planet.position;
 
             /* Calculate the radius and rotation matrix from the planet's position */
-            glm::vec3 relative = planet.position - universe.getSelected().position;
+            glm::vec3 relative = planet.position - snapshot.getSelected().position;
             orbitalRadius = glm::length(relative);
             relative /= orbitalRadius;
             rotation = glm::mat4(glm::vec4(relative, 0.0f),
@@ -183,13 +225,13 @@ bool PlacingInterface::handleAnalogStick(const glm::vec2& pos, const bool& modif
         }
         break;
     case OrbitalPlane:
-        if (universe.isSelectedValid()) {
+        if (snapshot.isSelectedValid()) {
             rotation *= glm::rotate(pos.x, glm::vec3(1.0f, 0.0f, 0.0f));
             rotation *= glm::rotate(pos.y, glm::vec3(0.0f, 1.0f, 0.0f));
-            planet.position = universe.getSelected().position + glm::vec3(rotation[0] * orbitalRadius);
+            planet.position = snapshot.getSelected().position + glm::vec3(rotation[0] * orbitalRadius);
 
             /* Center the camera on the selected planet for this step. */
-            camera.position = universe.getSelected().position;
+            camera.position = snapshot.getSelected().position;
             return true;
         }
         break;
@@ -200,23 +242,26 @@ bool PlacingInterface::handleAnalogStick(const glm::vec2& pos, const bool& modif
 void PlacingInterface::enableFiringMode(bool enable) {
     if (enable) {
         step = Firing;
-        universe.resetSelected();
+        runner.post([](PlanetsUniverse& universe) { universe.resetSelected(); });
     } else if (step == Firing) {
         step = NotPlacing;
     }
 }
 
 void PlacingInterface::beginInteractiveCreation() {
-    step = FreePositionXY; universe.resetSelected();
+    step = FreePositionXY;
+    runner.post([](PlanetsUniverse& universe) { universe.resetSelected(); });
 }
 
 void PlacingInterface::beginOrbitalCreation() {
-    if (universe.isSelectedValid()) step = OrbitalPlanet;
+    if (runner.current().isSelectedValid()) step = OrbitalPlanet;
 }
 
 glm::mat4 PlacingInterface::getOrbitalCircleMat() {
+    followOrigin();
+
     /* This is how large the orbit of the planet being placed will be. */
-    float radius = orbitalRadius / (1 + (planet.mass() / universe.getSelected().mass()));
+    float radius = orbitalRadius / (1 + (planet.mass() / runner.current().getSelected().mass()));
 
     /* Start at the placing planet location and move -1 (* the radius value) on x to locate the center. */
     glm::mat4 matrix = glm::translate(planet.position);
@@ -228,11 +273,13 @@ glm::mat4 PlacingInterface::getOrbitalCircleMat() {
 }
 
 glm::mat4 PlacingInterface::getOrbitedCircleMat() {
+    const Planet selected = runner.current().getSelected();
+
     /* This is how much the planet being orbited around will be displaced by the new planet. */
-    float radius = orbitalRadius / (1 + (universe.getSelected().mass() / planet.mass()));
+    float radius = orbitalRadius / (1 + (selected.mass() / planet.mass()));
 
     /* Start at the selected planet location and move 1 (* the radius value) on x to locate the center. */
-    glm::mat4 matrix = glm::translate(universe.getSelected().position);
+    glm::mat4 matrix = glm::translate(selected.position);
     matrix = glm::scale(matrix, glm::vec3(radius));
     matrix *= rotation;
     matrix = glm::translate(matrix, glm::vec3( 1.0f, 0.0f, 0.0f));
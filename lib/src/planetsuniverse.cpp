@@ -1,5 +1,7 @@
 #include "planetsuniverse.h"
 #include "planet.h"
+#include "snapshot.h"
+#include "kepler.h"
 #include <glm/gtx/norm.hpp>
 #include <glm/gtx/vector_query.hpp>
 #include <glm/gtx/rotate_vector.hpp>
@@ -8,12 +10,15 @@
 #include <algorithm>
 #include <functional>
 #include <array>
+#include <chrono>
 
 using std::uniform_int_distribution;
 using std::uniform_real_distribution;
 
 /* The gravity constant. */
 constexpr float gravityConstant = 6.667e-11f;
+/* The same thing for double precision, so it doesn't get rounded to a float first. */
+constexpr double preciseGravityConstant = 6.667e-11;
 
 PlanetsUniverse::PlanetsUniverse() {
     /* This should be a better way to seed a mersenne twister engine than just using a single uint. */
@@ -80,23 +85,23 @@ void PlanetsUniverse::save(const std::string& filename) {
 
     TiXmlElement* root = new TiXmlElement("planets-3d-universe");
 
-    for (const Planet& planet : planets) {
+    for (size_t i = 0; i < size(); ++i) {
         TiXmlElement* element = new TiXmlElement("planet");
-        element->SetAttribute("mass", std::to_string(planet.mass()));
+        element->SetAttribute("mass", std::to_string(masses[i]));
 
-        element->SetAttribute("material", std::to_string(planet.materialID));
+        element->SetAttribute("material", std::to_string(materials[i]));
 
         TiXmlElement* position = new TiXmlElement("position");
-        position->SetAttribute("x", std::to_string(planet.position.x));
-        position->SetAttribute("y", std::to_string(planet.position.y));
-        position->SetAttribute("z", std::to_string(planet.position.z));
+        position->SetAttribute("x", std::to_string(positions[i].x));
+        position->SetAttribute("y", std::to_string(positions[i].y));
+        position->SetAttribute("z", std::to_string(positions[i].z));
         element->LinkEndChild(position);
 
         TiXmlElement* velocity = new TiXmlElement("velocity");
         /* Velocity is saved with velocity factor. */
-        velocity->SetAttribute("x", std::to_string(planet.velocity.x / velocityFactor));
-        velocity->SetAttribute("y", std::to_string(planet.velocity.y / velocityFactor));
-        velocity->SetAttribute("z", std::to_string(planet.velocity.z / velocityFactor));
+        velocity->SetAttribute("x", std::to_string(velocities[i].x / velocityFactor));
+        velocity->SetAttribute("y", std::to_string(velocities[i].y / velocityFactor));
+        velocity->SetAttribute("z", std::to_string(velocities[i].z / velocityFactor));
         element->LinkEndChild(velocity);
 
         root->LinkEndChild(element);
@@ -111,93 +116,1328 @@ void PlanetsUniverse::save(const std::string& filename) {
 
 #endif /* Done with IO stuff that's excluded from Emscripten builds. */
 
-/* Basically the Quake method, tweaked for as much performance as I could get. */
-inline float fastInverseSqrt(float x) {
-    float halfx = x * 0.5f;
-    int32_t& i = reinterpret_cast<int32_t&>(x);
-    i = 0x5f3759df - (i >> 1);
-    return x*(1.5f - halfx*x*x);
+key_type PlanetsUniverse::allocateKey(size_t index) {
+    uint32_t slot;
+
+    if (freeSlots.empty()) {
+        if (slots.size() > slotMask)
+            throw std::length_error("Too many planets!");
+
+        slot = uint32_t(slots.size());
+        slots.push_back(Slot{ emptySlot, 0 });
+        trails.resizeTrails(slots.size());
+    } else {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    }
+
+    slots[slot].index = uint32_t(index);
+
+    return key_type(slot) | (key_type(slots[slot].generation) << slotBits);
+}
+
+void PlanetsUniverse::releaseKey(key_type key) {
+    Slot& slot = slots[key & slotMask];
+
+    slot.index = emptySlot;
+    /* Wraps around eventually, but a key would have to be held onto through over a thousand reuses of its slot. */
+    slot.generation = (slot.generation + 1) & generationMask;
+
+    trails.clear(key & slotMask);
+
+    freeSlots.push_back(uint32_t(key & slotMask));
+}
+
+key_type PlanetsUniverse::addPlanet(const Planet& planet) {
+    const key_type key = allocateKey(size());
+
+    keys.push_back(key);
+    positions.push_back(planet.position);
+    velocities.push_back(planet.velocity);
+    masses.push_back(planet.mass());
+    radii.push_back(planet.radius());
+    materials.push_back(planet.materialID);
+
+    return key;
+}
+
+void PlanetsUniverse::updatePaths() {
+    if (trails.capacity() != pathLength)
+        trails.reset(pathLength);
+
+    for (size_t i = 0; i < size(); ++i) {
+        const size_t trail = keys[i] & slotMask;
+        const size_t length = trails.size(trail);
+
+        /* If we have gone far enough, add a new point to the path. */
+        if (length < 2 || glm::distance2(trails.at(trail, length - 2), positions[i]) > pathRecordDistance)
+            trails.push(trail, positions[i]);
+        else
+            /* Otherwise update the last element to the current position. */
+            trails.setLast(trail, positions[i]);
+    }
 }
 
 void PlanetsUniverse::advance(float time) {
-    /* Factor the simulation speed and number of steps into the time value. */
-    time *= simulationSpeed / stepsPerFrame;
+    const int steps = stepController.plan(stepsPerFrame);
+
+    /* Factor the simulation speed and number of steps into the time value.
+     * Steps never get longer than stepsPerFrame would make them, if there are fewer than that the simulation slows down. */
+    time *= simulationSpeed / std::max(steps, stepsPerFrame);
+
+    /* Planets could have been added or changed since the last call, so don't trust anything left over from it. */
+    accelerationsValid = false;
+    tracerAccelerationsValid = false;
+    measureMultipole = true;
+    forceEvaluations_p = 0;
+
+    rebase();
+
+    tracerStarts = tracerPositions;
+
+    /* Old trails would just jump to wherever the planets are once recording starts again. */
+    if (pathsRecorded && !recordPaths)
+        trails.clearAll();
+    pathsRecorded = recordPaths;
+
+    typedef void (PlanetsUniverse::*steps_function)(int steps, float time);
+    static const steps_function stepFunctions[] = {
+        &PlanetsUniverse::advanceSteps<false, false, false>, &PlanetsUniverse::advanceSteps<false, false, true>,
+        &PlanetsUniverse::advanceSteps<false, true, false>,  &PlanetsUniverse::advanceSteps<false, true, true>,
+        &PlanetsUniverse::advanceSteps<true, false, false>,  &PlanetsUniverse::advanceSteps<true, false, true>,
+        &PlanetsUniverse::advanceSteps<true, true, false>,   &PlanetsUniverse::advanceSteps<true, true, true>,
+    };
+
+    const auto start = std::chrono::steady_clock::now();
+
+    (this->*stepFunctions[(mergePlanets ? 4 : 0) | (recordPaths ? 2 : 0) | (tracerPositions.empty() ? 0 : 1)])(steps, time);
+
+    stepController.measure(steps, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+}
+
+template<bool Merging, bool Paths, bool Tracers> void PlanetsUniverse::advanceSteps(int steps, float time) {
+    for (int s = 0; s < steps; ++s) {
+        if (sortInterval > 0 && integrator != IAS15 && ++stepsSinceSort >= sortInterval) {
+            stepsSinceSort = 0;
+            sortPlanets();
+        }
+
+        step<Merging, Tracers>(time);
+    }
+
+    if (Paths)
+        updatePaths();
+}
+
+void PlanetsUniverse::writeSnapshot(Snapshot& snapshot) const {
+    snapshot.keys = keys;
+    snapshot.positions = positions;
+    snapshot.velocities = velocities;
+    snapshot.masses = masses;
+    snapshot.radii = radii;
+    snapshot.materials = materials;
+    snapshot.trails = trails;
+    snapshot.tracerPositions = tracerPositions;
+    snapshot.previousTracerPositions = tracerStarts;
+
+    snapshot.slots.resize(slots.size());
+    for (size_t i = 0; i < slots.size(); ++i)
+        snapshot.slots[i] = slots[i].index;
+
+    snapshot.selected = selected;
+    snapshot.following = following;
+
+    snapshot.simulationSpeed = simulationSpeed;
+    snapshot.stepsPerFrame = stepsPerFrame;
+    snapshot.gravitySolver = gravitySolver;
+    snapshot.integrator = integrator;
+    snapshot.precision = precision;
+    snapshot.openingAngle = openingAngle;
+    snapshot.multipoleOrder = multipoleOrder;
+    snapshot.multipoleTolerance = multipoleTolerance;
+    snapshot.multipoleError = multipoleError_p;
+    snapshot.meshSize = meshSize;
+    snapshot.meshCorrection = meshCorrection;
+    snapshot.blockAccuracy = blockAccuracy;
+    snapshot.gaussRadauTolerance = gaussRadauTolerance;
+    snapshot.regularizationRange = regularizationRange;
+    snapshot.tracerMerging = tracerMerging;
+    snapshot.mergePlanets = mergePlanets;
+    snapshot.hashCollisions = hashCollisions;
+    snapshot.sortInterval = sortInterval;
+    snapshot.rebaseDistance = rebaseDistance;
+    snapshot.origin = origin_p;
+    snapshot.pathLength = pathLength;
+    snapshot.recordPaths = recordPaths;
+    snapshot.pathRecordDistance = pathRecordDistance;
+    snapshot.threadCount = threadCount();
+    snapshot.stepController = stepController;
+}
+
+/* Yoshida's 4th order coefficients, built from three leapfrog steps where the middle one goes backwards. */
+constexpr float yoshidaW1 = 1.3512071919596578f;  /* 1 / (2 - 2^(1/3)) */
+constexpr float yoshidaW0 = -1.7024143839193153f; /* -2^(1/3) / (2 - 2^(1/3)) */
+constexpr float yoshidaDrift[] = { yoshidaW1 * 0.5f, (yoshidaW0 + yoshidaW1) * 0.5f, (yoshidaW0 + yoshidaW1) * 0.5f, yoshidaW1 * 0.5f };
+constexpr float yoshidaKick[] = { yoshidaW1, yoshidaW0, yoshidaW1 };
+
+template<PlanetsUniverse::Precision P> void PlanetsUniverse::fixedStep(float time) {
+    /* Nothing changes the planets in the middle of an advance without keeping the double precision copies up to date,
+     * so the forces only have to be redone if something changed in between. */
+    if (P != Single && loadPrecise())
+        accelerationsValid = false;
+
+    auto forces = [this]() {
+        if (P == Double)
+            computePreciseAccelerations();
+        else
+            computeAccelerations();
+    };
+
+    switch (integrator) {
+    case Yoshida4:
+        for (int i = 0; i < 3; ++i) {
+            drift<P>(time * yoshidaDrift[i]);
+            forces();
+            kick<P>(time * yoshidaKick[i]);
+        }
+        drift<P>(time * yoshidaDrift[3]);
+        break;
+    case Euler:
+        forces();
+        kick<P>(time);
+        drift<P>(time);
+        break;
+    default:
+        /* Kick-drift-kick, the forces at the end of one step are the same as the start of the next so they're reused. */
+        if (!accelerationsValid)
+            forces();
+
+        if (P == Single)
+            findClosePairs(time);
+
+        if (P != Single || closePairs.empty()) {
+            kick<P>(time * 0.5f);
+            drift<P>(time);
+            forces();
+            kick<P>(time * 0.5f);
+        } else {
+            regularizedKick(time * 0.5f);
+            regularizedDrift(time);
+            computeAccelerations();
+            regularizedKick(time * 0.5f);
+        }
+
+        accelerationsValid = true;
+        break;
+    }
+}
+
+template<bool Merging, bool Tracers> void PlanetsUniverse::step(float time) {
+    /* The solvers only look for touching planets when merging, but anything left from before it was turned off goes too. */
+    merges.clear();
+
+    /* Only integrators that use the double precision copies keep them up to date. */
+    preciseValid = false;
+
+    if (Tracers)
+        startTracers(time);
+
+    switch (integrator) {
+    case BlockTimesteps:
+        blockStep(time);
+        break;
+    case IAS15:
+        gaussRadauStep(time);
+        break;
+    case KeplerLeapfrog:
+        keplerStep(time);
+        break;
+    case WisdomHolman:
+        if (wisdomHolmanStep(time))
+            break;
+        /* Nothing to build the map around, leapfrog is the same thing without the exact orbits. */
+        /* fall through */
+    default:
+        switch (precision) {
+        case Double:
+            fixedStep<Double>(time);
+            break;
+        case Mixed:
+            fixedStep<Mixed>(time);
+            break;
+        default:
+            fixedStep<Single>(time);
+            break;
+        }
+        break;
+    }
+
+    if (Merging) {
+        if (hashCollisions)
+            spatialHash.overlaps(positions.data(), radii.data(), size(), threadPool, merges);
 
-    /* Premultiply the gravity constant by time so we don't have to keep doing it every time we calculate gravitational force. */
+        /* Merged planets get the weighted average of their accelerations, which is close enough for leapfrog to keep using.
+         * Merging makes planets bigger, so with the spatial hash check again until nothing new is touching. That way a whole
+         * collapsing cloud ends up as one planet in a single step rather than growing a bit more each step. */
+        while (resolveMerges() && hashCollisions) {
+            merges.clear();
+            spatialHash.overlaps(positions.data(), radii.data(), size(), threadPool, merges);
+        }
+    }
+
+    if (Tracers)
+        finishTracers(time);
+}
+
+template<bool Merging> void PlanetsUniverse::blockForce(size_t i, glm::vec3& acceleration, glm::vec3& jerk, pair_list& merges) const {
+    const glm::vec3 position = predictedPositions[i], velocity = predictedVelocities[i];
+    acceleration = jerk = glm::vec3();
+
+    for (size_t j = 0; j < size(); ++j) {
+        const glm::vec3 direction = predictedPositions[j] - position;
+        const float distance2 = glm::length2(direction);
+
+        if (j == i)
+            continue;
+
+        if (Merging) {
+            const float touching = radii[i] + radii[j];
+
+            if (distance2 < touching * touching || distance2 == 0.0f) {
+                merges.push_back(std::make_pair(std::min(i, j), std::max(i, j)));
+                continue;
+            }
+        } else if (distance2 == 0.0f) {
+            continue;
+        }
+
+        const glm::vec3 relativeVelocity = predictedVelocities[j] - velocity;
+        const float inverse2 = 1.0f / distance2;
+        const float inverse3 = inverse2 * std::sqrt(inverse2) * masses[j];
+
+        acceleration += direction * inverse3;
+        jerk += (relativeVelocity - direction * (3.0f * glm::dot(direction, relativeVelocity) * inverse2)) * inverse3;
+    }
+}
+
+void PlanetsUniverse::blockStep(float time) {
+    const size_t count = size();
+    const uint64_t ticks = uint64_t(1) << maximumBlockLevel;
+    const double tickTime = double(time) / double(ticks);
+
+    accelerations.resize(count);
+    jerks.resize(count);
+    predictedPositions = positions;
+    predictedVelocities = velocities;
+    lastTicks.assign(count, 0);
+    levels.resize(count);
+
+    threadMerges.resize(threadPool.threadCount());
+    for (pair_list& list : threadMerges)
+        list.clear();
+
+    typedef void (PlanetsUniverse::*force_function)(size_t i, glm::vec3& acceleration, glm::vec3& jerk, pair_list& merges) const;
+    const force_function force = mergePlanets ? &PlanetsUniverse::blockForce<true> : &PlanetsUniverse::blockForce<false>;
+
+    /* Everything starts together, with a step from the simpler |a| / |j| estimate since there's nothing else to go on yet. */
+    threadPool.parallelFor(count, 16, [&](size_t begin, size_t end, unsigned int thread) {
+        for (size_t i = begin; i < end; ++i) {
+            (this->*force)(i, accelerations[i], jerks[i], threadMerges[thread]);
+
+            const float jerk = glm::length(jerks[i]);
+            const double step = jerk > 0.0f ? blockAccuracy * glm::length(accelerations[i]) / jerk : time;
+
+            uint32_t level = 0;
+            while (level < maximumBlockLevel && double(time) / double(uint64_t(1) << level) > step)
+                ++level;
+            levels[i] = level;
+        }
+    });
+    forceEvaluations_p += count;
+
+    for (uint64_t tick = 0; tick < ticks;) {
+        /* The next time anything is due, and everything that's due then. */
+        uint64_t next = ticks;
+        for (size_t i = 0; i < count; ++i)
+            next = std::min(next, lastTicks[i] + (ticks >> levels[i]));
+
+        activePlanets.clear();
+        for (size_t i = 0; i < count; ++i) {
+            if (lastTicks[i] + (ticks >> levels[i]) == next)
+                activePlanets.push_back(uint32_t(i));
+
+            /* Everyone gets predicted, since the planets being updated need to know where everything else is. */
+            const float dt = float(double(next - lastTicks[i]) * tickTime);
+            const glm::vec3 a = accelerations[i] * gravityConstant, j = jerks[i] * gravityConstant;
+            predictedPositions[i] = positions[i] + dt * (velocities[i] + dt * (a * 0.5f + dt * j * (1.0f / 6.0f)));
+            predictedVelocities[i] = velocities[i] + dt * (a + dt * j * 0.5f);
+        }
+
+        /* New forces first, then the corrections, so nothing moves while another planet is still reading it. */
+        activeAccelerations.resize(activePlanets.size());
+        activeJerks.resize(activePlanets.size());
+
+        threadPool.parallelFor(activePlanets.size(), 16, [&](size_t begin, size_t end, unsigned int thread) {
+            for (size_t n = begin; n < end; ++n)
+                (this->*force)(activePlanets[n], activeAccelerations[n], activeJerks[n], threadMerges[thread]);
+        });
+        forceEvaluations_p += activePlanets.size();
+
+        for (size_t n = 0; n < activePlanets.size(); ++n) {
+            const size_t i = activePlanets[n];
+            const double dt = double(next - lastTicks[i]) * tickTime;
+            const float step = float(dt);
+
+            /* Hermite corrector, the 2nd and 3rd derivatives of acceleration from the values at both ends of the step. */
+            const glm::vec3 a0 = accelerations[i], a1 = activeAccelerations[n], j0 = jerks[i], j1 = activeJerks[n];
+            const glm::vec3 snap = (-6.0f * (a0 - a1) - step * (4.0f * j0 + 2.0f * j1)) / (step * step);
+            const glm::vec3 crackle = (12.0f * (a0 - a1) + 6.0f * step * (j0 + j1)) / (step * step * step);
+
+            const float step2 = step * step, step3 = step2 * step;
+            positions[i] = predictedPositions[i] + (snap * (step2 * step2 / 24.0f) + crackle * (step3 * step2 / 120.0f)) * gravityConstant;
+            velocities[i] = predictedVelocities[i] + (snap * (step3 / 6.0f) + crackle * (step2 * step2 / 24.0f)) * gravityConstant;
+            predictedPositions[i] = positions[i];
+            predictedVelocities[i] = velocities[i];
+
+            accelerations[i] = a1;
+            jerks[i] = j1;
+            lastTicks[i] = next;
+
+            /* Aarseth's criterion with the derivatives at the end of the step. */
+            const glm::vec3 snapEnd = snap + crackle * step;
+            const float a = glm::length(a1), j = glm::length(j1), s = glm::length(snapEnd), c = glm::length(crackle);
+            const double bottom = double(j) * c + double(s) * s;
+            const double wanted = bottom > 0.0 ? std::sqrt(blockAccuracy * (double(a) * s + double(j) * j) / bottom) : time;
+
+            uint32_t level = 0;
+            while (level < maximumBlockLevel && double(time) / double(uint64_t(1) << level) > wanted)
+                ++level;
+
+            /* Steps can always be halved, but only doubled when the planet lines up with the longer step. */
+            if (level < levels[i]) {
+                if (next % (ticks >> (levels[i] - 1)) == 0)
+                    --levels[i];
+            } else {
+                levels[i] = level;
+            }
+        }
+
+        tick = next;
+    }
+
+    for (const pair_list& list : threadMerges)
+        merges.insert(merges.end(), list.begin(), list.end());
+
+    /* The accelerations include the jerk based prediction, nothing else should reuse them. */
+    accelerationsValid = false;
+}
+
+void PlanetsUniverse::preciseAccelerations(const std::vector<glm::dvec3>& positions, std::vector<glm::dvec3>& result) {
+    if (mergePlanets)
+        preciseAccelerations<true>(positions, result);
+    else
+        preciseAccelerations<false>(positions, result);
+}
+
+template<bool Merging> void PlanetsUniverse::preciseAccelerations(const std::vector<glm::dvec3>& positions, std::vector<glm::dvec3>& result) {
+    const size_t count = positions.size();
+    forceEvaluations_p += count;
+
+    threadMerges.resize(threadPool.threadCount());
+    for (pair_list& list : threadMerges)
+        list.clear();
+
+    threadPool.parallelFor(count, 16, [&](size_t begin, size_t end, unsigned int thread) {
+        for (size_t i = begin; i < end; ++i) {
+            glm::dvec3 acceleration;
+
+            for (size_t j = 0; j < count; ++j) {
+                const glm::dvec3 direction = positions[j] - positions[i];
+                const double distance2 = glm::length2(direction);
+
+                if (j == i)
+                    continue;
+
+                if (Merging) {
+                    const double touching = double(radii[i]) + double(radii[j]);
+
+                    if (distance2 < touching * touching || distance2 == 0.0) {
+                        threadMerges[thread].push_back(std::make_pair(std::min(i, j), std::max(i, j)));
+                        continue;
+                    }
+                } else if (distance2 == 0.0) {
+                    continue;
+                }
+
+                acceleration += direction * (double(masses[j]) / (distance2 * std::sqrt(distance2)));
+            }
+
+            result[i] = acceleration * preciseGravityConstant;
+        }
+    });
+
+    if (Merging)
+        for (const pair_list& list : threadMerges)
+            merges.insert(merges.end(), list.begin(), list.end());
+}
+
+bool PlanetsUniverse::loadPrecise() {
+    const size_t count = size();
+
+    /* Planets could have been added, moved, or merged since the last step, the float values are the ones to trust then. */
+    bool loaded = precisePositions.size() != count;
+
+    precisePositions.resize(count);
+    preciseVelocities.resize(count);
+
+    for (size_t i = 0; i < count; ++i) {
+        if (!(glm::vec3(precisePositions[i]) == positions[i] && glm::vec3(preciseVelocities[i]) == velocities[i])) {
+            precisePositions[i] = glm::dvec3(positions[i]);
+            preciseVelocities[i] = glm::dvec3(velocities[i]);
+            loaded = true;
+        }
+    }
+
+    preciseValid = true;
+
+    return loaded;
+}
+
+void PlanetsUniverse::computePreciseAccelerations() {
+    const size_t count = size();
+
+    preciseForces.resize(count);
+    preciseAccelerations(precisePositions, preciseForces);
+
+    /* Merging and tracers still go by the float ones. */
+    accelerations.resize(count);
+    for (size_t i = 0; i < count; ++i)
+        accelerations[i] = glm::vec3(preciseForces[i] / preciseGravityConstant);
+}
+
+void PlanetsUniverse::gaussRadauStep(float time) {
+    const size_t count = size();
+
+    /* The fit from the last step is no good if the planets changed. */
+    if (loadPrecise())
+        gaussRadau.reset();
+
+    /* Merges are found at every node, so planets that pass through each other during a step still merge. */
+    gaussRadau.integrate(precisePositions, preciseVelocities, time, gaussRadauTolerance,
+                         [this](const std::vector<glm::dvec3>& nodePositions, std::vector<glm::dvec3>& result) {
+        preciseAccelerations(nodePositions, result);
+    });
+
+    for (size_t i = 0; i < count; ++i) {
+        positions[i] = glm::vec3(precisePositions[i]);
+        velocities[i] = glm::vec3(preciseVelocities[i]);
+    }
+
+    /* Merging averages accelerations, they just need to be there even though nothing reuses them. */
+    accelerations.resize(count);
+    accelerationsValid = false;
+}
+
+bool PlanetsUniverse::wisdomHolmanStep(float time) {
+    const size_t count = size();
+
+    if (count < 2)
+        return false;
+
+    size_t central = 0;
+    for (size_t i = 1; i < count; ++i)
+        if (masses[i] > masses[central])
+            central = i;
+
+    float second = 0.0f;
+    for (size_t i = 0; i < count; ++i)
+        if (i != central)
+            second = std::max(second, masses[i]);
+
+    if (masses[central] < second * dominantMassRatio)
+        return false;
+
+    if (!accelerationsValid) {
+        computeAccelerations();
+        /* If there's a close encounter the leapfrog step that does it instead can start from these, unless it uses the
+         * double precision forces, which haven't been worked out yet. */
+        accelerationsValid = precision != Double;
+    }
+
+    if (!perturbationKick(central, time * 0.5f, true))
+        return false;
+
+    /* Democratic heliocentric coordinates, positions relative to the central planet and velocities relative to the barycenter. */
+    const double centralMass = masses[central];
+    double totalMass = 0.0;
+    glm::dvec3 barycenter, momentum;
+    for (size_t i = 0; i < count; ++i) {
+        totalMass += masses[i];
+        barycenter += glm::dvec3(positions[i]) * double(masses[i]);
+        momentum += glm::dvec3(velocities[i]) * double(masses[i]);
+    }
+    barycenter /= totalMass;
+    const glm::dvec3 barycentricVelocity = momentum / totalMass;
+
+    relativePositions.resize(count);
+    relativeVelocities.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        relativePositions[i] = glm::dvec3(positions[i]) - glm::dvec3(positions[central]);
+        relativeVelocities[i] = glm::dvec3(velocities[i]) - barycentricVelocity;
+    }
+
+    /* The central planet moves to keep the barycenter still, which shifts everything else's relative position. */
+    auto jump = [&](double time) {
+        glm::dvec3 shift;
+        for (size_t i = 0; i < count; ++i)
+            if (i != central)
+                shift += relativeVelocities[i] * double(masses[i]);
+        shift *= time / centralMass;
+
+        for (size_t i = 0; i < count; ++i)
+            if (i != central)
+                relativePositions[i] += shift;
+    };
+
+    jump(time * 0.5);
+
+    const double mu = double(gravityConstant) * centralMass;
+    threadPool.parallelFor(count, 64, [&](size_t begin, size_t end, unsigned int) {
+        for (size_t i = begin; i < end; ++i) {
+            /* Straight through the center can't be solved, but it's about to merge anyway. */
+            if (i != central && !Kepler::drift(relativePositions[i], relativeVelocities[i], mu, time))
+                relativePositions[i] += relativeVelocities[i] * double(time);
+        }
+    });
+
+    jump(time * 0.5);
+
+    /* Back to normal coordinates, the barycenter keeps drifting along at the same speed. */
+    barycenter += barycentricVelocity * double(time);
+    glm::dvec3 offset, centralMomentum;
+    for (size_t i = 0; i < count; ++i) {
+        if (i != central) {
+            offset += relativePositions[i] * double(masses[i]);
+            centralMomentum -= relativeVelocities[i] * double(masses[i]);
+        }
+    }
+
+    const glm::dvec3 centralPosition = barycenter - offset / totalMass;
+    for (size_t i = 0; i < count; ++i) {
+        if (i != central) {
+            positions[i] = glm::vec3(centralPosition + relativePositions[i]);
+            velocities[i] = glm::vec3(barycentricVelocity + relativeVelocities[i]);
+        }
+    }
+    positions[central] = glm::vec3(centralPosition);
+    velocities[central] = glm::vec3(barycentricVelocity + centralMomentum / centralMass);
+
+    computeAccelerations();
+    perturbationKick(central, time * 0.5f, false);
+
+    accelerationsValid = true;
+
+    return true;
+}
+
+bool PlanetsUniverse::perturbationKick(size_t central, float time, bool checkEncounters) {
+    const size_t count = size();
     const float gconsttime = gravityConstant * time;
 
-    /* Store the list end iterator so we don't have to keep retrieving it. */
-    iterator e = planets.end();
-
-    for (int s = 0; s < stepsPerFrame; ++s) {
-        for (iterator i = planets.begin(); i != e; ++i) {
-            /* We only have to run this for planets after the current one,
-             * because all the planets before this have already been calculated with this one. */
-            for (iterator o = i + 1; o != e;) {
-                glm::vec3 direction = o->position - i->position;
-                /* Don't use glm::length2 because it involves a conversion and extra multiply & add operations for a forth component. */
-                float force = direction.x * direction.x + direction.y * direction.y + direction.z * direction.z;
-
-                /* Planets are close enough to merge. */
-                if (force < (i->radius() + o->radius()) * (i->radius() + o->radius())) {
-                    /* Set the position and velocity to the wieghted average between the planets. */
-                    i->position = o->position * o->mass() + i->position * i->mass();
-                    i->velocity = o->velocity * o->mass() + i->velocity * i->mass();
-
-                    /* Add the masses together. */
-                    i->setMass(i->mass() + o->mass());
-
-                    /* Finish the weighted average calculation. */
-                    i->position /= i->mass();
-                    i->velocity /= i->mass();
-
-                    /* The path would be invalid after this. */
-                    i->path.clear();
-
-                    /* This function checks selected and following to make sure they remain valid. */
-                    o = remove(o - begin(), i - begin());
-
-                    /* Update the stored list end value. */
-                    e = planets.end();
-                } else {
-                    /* The gravity math to calculate the force between the planets. */
-                    force = gconsttime / force * fastInverseSqrt(force);
-
-                    /* Apply the force to the velocity of both planets. */
-                    i->velocity += force * o->mass() * direction;
-                    o->velocity -= force * i->mass() * direction;
-
-                    /* Keep going. (Not in for loop because of the possibility of erase() getting called.) */
-                    ++o;
+    /* Take the central planet's pull back out of each acceleration, leaving just the pull of the others. */
+    auto perturbation = [&](size_t i, glm::vec3& pull) {
+        const glm::vec3 direction = positions[central] - positions[i];
+        const float distance2 = glm::length2(direction);
+        pull = distance2 > 0.0f ? direction * (masses[central] / (distance2 * std::sqrt(distance2))) : glm::vec3();
+        return accelerations[i] - pull;
+    };
+
+    if (checkEncounters) {
+        const float ratio2 = closeEncounterRatio * closeEncounterRatio;
+
+        for (size_t i = 0; i < count; ++i) {
+            glm::vec3 pull;
+            if (i != central && glm::length2(perturbation(i, pull)) > glm::length2(pull) * ratio2)
+                return false;
+        }
+    }
+
+    /* The pull between the others is equal and opposite, so the central planet's velocity doesn't change. */
+    for (size_t i = 0; i < count; ++i) {
+        glm::vec3 pull;
+        if (i != central)
+            velocities[i] += perturbation(i, pull) * gconsttime;
+    }
+
+    return true;
+}
+
+void PlanetsUniverse::keplerStep(float time) {
+    if (!accelerationsValid)
+        computeAccelerations();
+
+    /* Which planets are orbiting what stays the same for the whole step, so both kicks leave out the same pulls. */
+    findPrimaries();
+
+    keplerKick(time * 0.5f);
+    keplerDrift(time);
+    computeAccelerations();
+    keplerKick(time * 0.5f);
+
+    accelerationsValid = true;
+}
+
+void PlanetsUniverse::findPrimaries() {
+    const size_t count = size();
+
+    primaries.assign(count, uint32_t(noPlanet));
+
+    primaryCandidates.resize(count);
+    for (size_t i = 0; i < count; ++i)
+        primaryCandidates[i] = uint32_t(i);
+
+    const size_t candidates = std::min(count, size_t(maximumPrimaries));
+    std::partial_sort(primaryCandidates.begin(), primaryCandidates.begin() + candidates, primaryCandidates.end(),
+                      [this](uint32_t a, uint32_t b) { return masses[a] > masses[b] || (masses[a] == masses[b] && a < b); });
+    primaryCandidates.resize(candidates);
+
+    const double ratio2 = double(closeEncounterRatio) * double(closeEncounterRatio);
+
+    threadPool.parallelFor(count, 64, [&](size_t begin, size_t end, unsigned int) {
+        for (size_t i = begin; i < end; ++i) {
+            /* Whichever candidate pulls hardest, as long as it's heavy enough to count as something to orbit. */
+            uint32_t primary = noPlanet;
+            float strongest = 0.0f;
+            for (uint32_t c : primaryCandidates) {
+                if (masses[c] < masses[i] * dominantMassRatio)
+                    break;
+
+                const float distance2 = glm::distance2(positions[c], positions[i]);
+                if (distance2 > 0.0f && masses[c] > strongest * distance2) {
+                    strongest = masses[c] / distance2;
+                    primary = c;
                 }
             }
 
-            /* Apply the velocity to the position of the planet and update the path. */
-            i->position += i->velocity * time;
-            i->updatePath(pathLength, pathRecordDistance);
+            if (primary == noPlanet)
+                continue;
+
+            const glm::dvec3 r = glm::dvec3(positions[i]) - glm::dvec3(positions[primary]);
+            const glm::dvec3 v = glm::dvec3(velocities[i]) - glm::dvec3(velocities[primary]);
+            const double distance = glm::length(r);
+            const double mu = double(gravityConstant) * (double(masses[primary]) + double(masses[i]));
+
+            /* Only bound orbits, a fly-by is better off integrated. */
+            if (0.5 * glm::dot(v, v) >= mu / distance)
+                continue;
+
+            /* Whatever doesn't come from the pair itself, compared to the pull between them. */
+            const glm::dvec3 pull = r * (mu / (distance * distance * distance));
+            const glm::dvec3 perturbation = (glm::dvec3(accelerations[i]) - glm::dvec3(accelerations[primary])) * double(gravityConstant) + pull;
+            if (glm::dot(perturbation, perturbation) > glm::dot(pull, pull) * ratio2)
+                continue;
+
+            primaries[i] = primary;
+        }
+    });
+
+    /* Only one level, anything orbiting a planet that's orbiting something else gets integrated normally.
+     * Candidates go heaviest first so each one's primary is settled before anything can depend on it. */
+    for (uint32_t c : primaryCandidates)
+        if (primaries[c] != noPlanet && primaries[primaries[c]] != noPlanet)
+            primaries[c] = noPlanet;
+
+    for (size_t i = 0; i < count; ++i)
+        if (primaries[i] != noPlanet && primaries[primaries[i]] != noPlanet)
+            primaries[i] = noPlanet;
+}
+
+void PlanetsUniverse::keplerKick(float time) {
+    const float gconsttime = gravityConstant * time;
+
+    /* The pull from the primary is left out, and so is the equal and opposite pull the primary gets from the planet,
+     * since the planet's velocity is kept relative to its primary's. That leaves the relative velocity kicked by just
+     * what the orbit doesn't account for. */
+    threadPool.parallelFor(size(), 256, [&](size_t begin, size_t end, unsigned int) {
+        for (size_t i = begin; i < end; ++i) {
+            const uint32_t primary = primaries[i];
+
+            if (primary == noPlanet) {
+                velocities[i] += accelerations[i] * gconsttime;
+                continue;
+            }
+
+            const glm::dvec3 r = glm::dvec3(positions[i]) - glm::dvec3(positions[primary]);
+            const double distance = glm::length(r);
+            const double mass = double(masses[primary]) + double(masses[i]);
+
+            velocities[i] = glm::vec3(glm::dvec3(velocities[i]) + (glm::dvec3(accelerations[i]) + r * (mass / (distance * distance * distance))) * double(gconsttime));
+        }
+    });
+}
+
+void PlanetsUniverse::keplerDrift(float time) {
+    const size_t count = size();
+
+    relativePositions.resize(count);
+    relativeVelocities.resize(count);
+
+    /* Everything is worked out relative to where the primaries were before any of them move. */
+    threadPool.parallelFor(count, 64, [&](size_t begin, size_t end, unsigned int) {
+        for (size_t i = begin; i < end; ++i) {
+            const uint32_t primary = primaries[i];
+
+            if (primary == noPlanet)
+                continue;
+
+            relativePositions[i] = glm::dvec3(positions[i]) - glm::dvec3(positions[primary]);
+            relativeVelocities[i] = glm::dvec3(velocities[i]) - glm::dvec3(velocities[primary]);
+
+            const double mu = double(gravityConstant) * (double(masses[primary]) + double(masses[i]));
+            /* Straight through the center can't be solved, but it's about to merge anyway. */
+            if (!Kepler::drift(relativePositions[i], relativeVelocities[i], mu, time))
+                relativePositions[i] += relativeVelocities[i] * double(time);
+        }
+    });
+
+    /* Primaries (and everything else) move in a straight line, then orbiting planets get put back around them. */
+    drift(time);
+
+    for (size_t i = 0; i < count; ++i) {
+        const uint32_t primary = primaries[i];
+
+        if (primary != noPlanet) {
+            positions[i] = glm::vec3(glm::dvec3(positions[primary]) + relativePositions[i]);
+            velocities[i] = glm::vec3(glm::dvec3(velocities[primary]) + relativeVelocities[i]);
         }
     }
 }
 
-PlanetsUniverse::iterator PlanetsUniverse::remove(const key_type key, const key_type replacement) {
+void PlanetsUniverse::findClosePairs(float time) {
+    const size_t count = size();
+
+    closePairs.clear();
+    partners.assign(count, uint32_t(noPlanet));
+
+    if (regularizationRange <= 0.0f || count < 2)
+        return;
+
+    /* A pair only needs regularizing if it gets closer than the distance the step can resolve an orbit at, which is
+     * cbrt(G * total mass) * this, as well as within regularizationRange. */
+    const float resolved = std::pow(time / regularizationStepRatio, 2.0f / 3.0f) * std::cbrt(gravityConstant);
+
+    /* Sweep along x, a pair can only get close if the ranges each could cover during the step overlap.
+     * Radius and cbrt(mass) are proportional, so each planet's share of the pair's range can be worked out on its own.
+     * The sorted copies keep the inner loop going through memory in order, since it has to look at a lot of pairs. */
+    sweepReach.resize(count);
+    sweepOrder.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        sweepReach[i] = std::min(regularizationRange * radii[i], resolved * std::cbrt(masses[i])) + glm::length(velocities[i]) * time;
+        sweepOrder[i] = uint32_t(i);
+    }
+
+    std::sort(sweepOrder.begin(), sweepOrder.end(), [this](uint32_t a, uint32_t b) {
+        return positions[a].x - sweepReach[a] < positions[b].x - sweepReach[b];
+    });
+
+    sweepPoints.resize(count);
+    for (size_t a = 0; a < count; ++a)
+        sweepPoints[a] = glm::vec4(positions[sweepOrder[a]], sweepReach[sweepOrder[a]]);
+
+    /* Each planet's nearest neighbor that's in range, as a fraction of the range. */
+    partnerDistances.assign(count, 1.0f);
+
+    for (size_t a = 0; a < count; ++a) {
+        const glm::vec4 point = sweepPoints[a];
+        const float upper = point.x + point.w;
+
+        for (size_t b = a + 1; b < count && sweepPoints[b].x - sweepPoints[b].w <= upper; ++b) {
+            const glm::vec4 other = sweepPoints[b];
+            const float bound = point.w + other.w;
+
+            if (std::abs(other.y - point.y) > bound || std::abs(other.z - point.z) > bound)
+                continue;
+
+            const size_t i = sweepOrder[a], j = sweepOrder[b];
+
+            /* Closest they get if they kept going in a straight line for the step. */
+            const glm::vec3 direction = positions[j] - positions[i];
+            const glm::vec3 relativeVelocity = velocities[j] - velocities[i];
+            const float speed2 = glm::length2(relativeVelocity);
+            const float when = speed2 > 0.0f ? glm::clamp(-glm::dot(direction, relativeVelocity) / speed2, 0.0f, time) : 0.0f;
+            const float reach = std::min(regularizationRange * (radii[i] + radii[j]), resolved * std::cbrt(masses[i] + masses[j]));
+            const float closest = glm::length2(direction + relativeVelocity * when) / (reach * reach);
+
+            if (closest < partnerDistances[i] || (closest == partnerDistances[i] && j < partners[i])) {
+                partnerDistances[i] = closest;
+                partners[i] = uint32_t(j);
+            }
+            if (closest < partnerDistances[j] || (closest == partnerDistances[j] && i < partners[j])) {
+                partnerDistances[j] = closest;
+                partners[j] = uint32_t(i);
+            }
+        }
+    }
+
+    /* Only planets that are each other's nearest get paired, anything close to several others is left alone. */
+    for (size_t i = 0; i < count; ++i)
+        if (partners[i] != noPlanet && i < partners[i] && partners[partners[i]] == i)
+            closePairs.push_back(std::make_pair(i, size_t(partners[i])));
+
+    partners.assign(count, uint32_t(noPlanet));
+    for (const auto& pair : closePairs) {
+        partners[pair.first] = uint32_t(pair.second);
+        partners[pair.second] = uint32_t(pair.first);
+    }
+}
+
+void PlanetsUniverse::regularizedKick(float time) {
+    const float gconsttime = gravityConstant * time;
+
+    /* The pull between the two is equal and opposite, so it drops out of the mass weighted average. */
+    for (size_t i = 0; i < size(); ++i) {
+        const uint32_t partner = partners[i];
+
+        if (partner == noPlanet)
+            velocities[i] += accelerations[i] * gconsttime;
+        else
+            velocities[i] += (accelerations[i] * masses[i] + accelerations[partner] * masses[partner]) *
+                             (gconsttime / (masses[i] + masses[partner]));
+    }
+}
+
+void PlanetsUniverse::regularizedDrift(float time) {
+    threadMerges.resize(threadPool.threadCount());
+    for (pair_list& list : threadMerges)
+        list.clear();
+
+    for (size_t i = 0; i < size(); ++i)
+        if (partners[i] == noPlanet)
+            positions[i] += velocities[i] * time;
+
+    /* Each pair takes its own number of steps, which can be a lot for a close bound pair, so give each thread one at a time. */
+    threadPool.parallelFor(closePairs.size(), 1, [&](size_t begin, size_t end, unsigned int thread) {
+        for (size_t p = begin; p < end; ++p) {
+            const size_t i = closePairs[p].first, j = closePairs[p].second;
+            const double massI = masses[i], massJ = masses[j], total = massI + massJ;
+
+            glm::dvec3 center = (glm::dvec3(positions[i]) * massI + glm::dvec3(positions[j]) * massJ) / total;
+            const glm::dvec3 centerVelocity = (glm::dvec3(velocities[i]) * massI + glm::dvec3(velocities[j]) * massJ) / total;
+
+            glm::dvec3 position = glm::dvec3(positions[j]) - glm::dvec3(positions[i]);
+            glm::dvec3 velocity = glm::dvec3(velocities[j]) - glm::dvec3(velocities[i]);
+
+            /* Everything else pulling them apart or together, taken as constant over the step. */
+            const double distance = glm::length(position);
+            const double mu = double(gravityConstant) * total;
+            const glm::dvec3 perturbation = (glm::dvec3(accelerations[j]) - glm::dvec3(accelerations[i])) * double(gravityConstant) +
+                                            position * (mu / (distance * distance * distance));
+
+            double closest = distance;
+            if (!KSRegularization::drift(position, velocity, mu, perturbation, time, closest))
+                position += velocity * double(time);
+
+            /* They could pass through each other and out the other side within the step. */
+            if (mergePlanets && closest < double(radii[i]) + double(radii[j]))
+                threadMerges[thread].push_back(closePairs[p]);
+
+            center += centerVelocity * double(time);
+            positions[i] = glm::vec3(center - position * (massJ / total));
+            positions[j] = glm::vec3(center + position * (massI / total));
+            velocities[i] = glm::vec3(centerVelocity - velocity * (massJ / total));
+            velocities[j] = glm::vec3(centerVelocity + velocity * (massI / total));
+        }
+    });
+
+    for (const pair_list& list : threadMerges)
+        merges.insert(merges.end(), list.begin(), list.end());
+}
+
+template<PlanetsUniverse::Precision P> void PlanetsUniverse::kick(float time) {
+    if (P == Double) {
+        /* These already have the gravity constant. */
+        for (size_t i = 0; i < size(); ++i) {
+            preciseVelocities[i] += preciseForces[i] * double(time);
+            velocities[i] = glm::vec3(preciseVelocities[i]);
+        }
+    } else if (P == Mixed) {
+        const double gconsttime = preciseGravityConstant * double(time);
+
+        for (size_t i = 0; i < size(); ++i) {
+            preciseVelocities[i] += glm::dvec3(accelerations[i]) * gconsttime;
+            velocities[i] = glm::vec3(preciseVelocities[i]);
+        }
+    } else {
+        /* Premultiply the gravity constant by time so we don't have to do it for every planet. */
+        const float gconsttime = gravityConstant * time;
+
+        for (size_t i = 0; i < size(); ++i)
+            velocities[i] += accelerations[i] * gconsttime;
+    }
+}
+
+template<PlanetsUniverse::Precision P> void PlanetsUniverse::drift(float time) {
+    if (P == Single) {
+        for (size_t i = 0; i < size(); ++i)
+            positions[i] += velocities[i] * time;
+    } else {
+        for (size_t i = 0; i < size(); ++i) {
+            precisePositions[i] += preciseVelocities[i] * double(time);
+            positions[i] = glm::vec3(precisePositions[i]);
+        }
+    }
+}
+
+void PlanetsUniverse::computeTracerAccelerations() {
+    const size_t count = tracerCount();
+
+    tracerAccelerations.resize(count);
+    tracerContacts.clear();
+
+    forceKernel.tracerAccelerations(tracerPositions.data(), count, positions.data(), masses.data(), radii.data(), size(),
+                                    instructionSet, threadPool, tracerAccelerations.data(), tracerContacts);
+
+    tracerAccelerationsValid = true;
+
+    if (!tracerMerging || tracerContacts.empty())
+        return;
+
+    /* A tracer can be inside more than one planet, sorting puts all of its contacts together. */
+    std::sort(tracerContacts.begin(), tracerContacts.end());
+
+    size_t kept = 0, contact = 0;
+
+    for (size_t i = 0; i < count; ++i) {
+        if (contact < tracerContacts.size() && tracerContacts[contact].first == i) {
+            while (contact < tracerContacts.size() && tracerContacts[contact].first == i)
+                ++contact;
+            continue;
+        }
+
+        if (kept != i) {
+            tracerPositions[kept] = tracerPositions[i];
+            tracerVelocities[kept] = tracerVelocities[i];
+            tracerAccelerations[kept] = tracerAccelerations[i];
+            tracerStarts[kept] = tracerStarts[i];
+        }
+
+        ++kept;
+    }
+
+    tracerPositions.resize(kept);
+    tracerVelocities.resize(kept);
+    tracerAccelerations.resize(kept);
+    tracerStarts.resize(kept);
+}
+
+void PlanetsUniverse::startTracers(float time) {
+    if (tracerPositions.empty())
+        return;
+
+    if (!tracerAccelerationsValid)
+        computeTracerAccelerations();
+
+    const float gconsttime = gravityConstant * time * 0.5f;
+
+    for (size_t i = 0; i < tracerCount(); ++i) {
+        tracerVelocities[i] += tracerAccelerations[i] * gconsttime;
+        tracerPositions[i] += tracerVelocities[i] * time;
+    }
+}
+
+void PlanetsUniverse::finishTracers(float time) {
+    if (tracerPositions.empty())
+        return;
+
+    computeTracerAccelerations();
+
+    const float gconsttime = gravityConstant * time * 0.5f;
+
+    for (size_t i = 0; i < tracerCount(); ++i)
+        tracerVelocities[i] += tracerAccelerations[i] * gconsttime;
+}
+
+void PlanetsUniverse::computeAccelerations() {
+    if (mergePlanets)
+        computeAccelerations<true>();
+    else
+        computeAccelerations<false>();
+}
+
+template<bool Merging> void PlanetsUniverse::computeAccelerations() {
+    const size_t count = size();
+
+    accelerations.resize(count);
+    forceEvaluations_p += count;
+
+    if (gravitySolver == BarnesHut) {
+        /* The tree reads straight from the planet arrays, so positions can't change until all the forces are done. */
+        octree.build(positions.data(), masses.data(), radii.data(), count);
+
+        threadMerges.resize(threadPool.threadCount());
+        for (pair_list& list : threadMerges)
+            list.clear();
+
+        /* Every planet only changes its own acceleration, so they can be split up between threads however. */
+        threadPool.parallelFor(count, 64, [&](size_t begin, size_t end, unsigned int thread) {
+            for (size_t i = begin; i < end; ++i)
+                accelerations[i] = octree.acceleration<Merging>(i, openingAngle, threadMerges[thread]);
+        });
+
+        if (Merging)
+            for (const pair_list& list : threadMerges)
+                merges.insert(merges.end(), list.begin(), list.end());
+    } else if (gravitySolver == FastMultipole) {
+        multipoleTree.accelerations<Merging>(positions.data(), masses.data(), radii.data(), count, multipoleOrder, multipoleTolerance,
+                                             threadPool, accelerations.data(), merges);
+
+        if (measureMultipole) {
+            multipoleError_p = MultipoleTree::measureError<Merging>(positions.data(), masses.data(), radii.data(), count, accelerations.data());
+            measureMultipole = false;
+        }
+    } else if (gravitySolver == ParticleMeshFFT) {
+        particleMesh.accelerations<Merging>(positions.data(), masses.data(), radii.data(), count, uint32_t(std::max(meshSize, 0)),
+                                            meshCorrection, threadPool, accelerations.data(), merges);
+    } else {
+        forceKernel.accelerations<Merging>(positions.data(), masses.data(), radii.data(), count, instructionSet, threadPool,
+                                           accelerations.data(), merges);
+    }
+}
+
+bool PlanetsUniverse::resolveMerges() {
+    if (merges.empty())
+        return false;
+
+    const size_t count = size();
+
+    /* Union-find, every group of touching planets ends up pointing at the lowest index in the group.
+     * Which one ends up the root doesn't depend on what order the pairs are in, so neither does anything after this. */
+    targets.resize(count);
+    for (size_t i = 0; i < count; ++i)
+        targets[i] = i;
+
+    auto find = [this](size_t index) {
+        while (targets[index] != index)
+            index = targets[index] = targets[targets[index]];
+        return index;
+    };
+
+    for (const auto& pair : merges) {
+        size_t a = find(pair.first), b = find(pair.second);
+
+        if (a < b)
+            targets[b] = a;
+        else if (b < a)
+            targets[a] = b;
+    }
+
+    /* Accelerations and the double precision copies only get merged if they're for the current planets. */
+    const bool mergeAccelerations = accelerations.size() == count;
+    const bool mergePrecise = preciseValid && precisePositions.size() == count;
+    const bool mergeForces = preciseValid && preciseForces.size() == count;
+
+    /* Each group's position, velocity and acceleration are summed weighted by mass into the lowest index in index order,
+     * then divided by the total once at the end. The root always comes before the rest of its group. */
+    merging.assign(count, false);
+    if (mergePrecise || mergeForces)
+        preciseMasses.assign(count, 0.0);
+
+    for (size_t i = 0; i < count; ++i) {
+        const size_t target = targets[i] = targets[targets[i]];
+
+        if (target == i)
+            continue;
+
+        if (!merging[target]) {
+            merging[target] = true;
+
+            positions[target] *= masses[target];
+            velocities[target] *= masses[target];
+            if (mergeAccelerations)
+                accelerations[target] *= masses[target];
+
+            if (mergePrecise || mergeForces)
+                preciseMasses[target] = masses[target];
+            if (mergePrecise) {
+                precisePositions[target] *= double(masses[target]);
+                preciseVelocities[target] *= double(masses[target]);
+            }
+            if (mergeForces)
+                preciseForces[target] *= double(masses[target]);
+        }
+
+        positions[target] += positions[i] * masses[i];
+        velocities[target] += velocities[i] * masses[i];
+        if (mergeAccelerations)
+            accelerations[target] += accelerations[i] * masses[i];
+
+        /* The total mass has to be in double too, or rounding it would throw off where the planets end up. */
+        if (mergePrecise || mergeForces)
+            preciseMasses[target] += masses[i];
+        if (mergePrecise) {
+            precisePositions[target] += precisePositions[i] * double(masses[i]);
+            preciseVelocities[target] += preciseVelocities[i] * double(masses[i]);
+        }
+        if (mergeForces)
+            preciseForces[target] += preciseForces[i] * double(masses[i]);
+
+        masses[target] += masses[i];
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        if (!merging[i])
+            continue;
+
+        positions[i] /= masses[i];
+        velocities[i] /= masses[i];
+        if (mergeAccelerations)
+            accelerations[i] /= masses[i];
+
+        /* The planets have to match their double precision copies, or they'd just get reloaded. */
+        if (mergePrecise) {
+            precisePositions[i] /= preciseMasses[i];
+            preciseVelocities[i] /= preciseMasses[i];
+            positions[i] = glm::vec3(precisePositions[i]);
+            velocities[i] = glm::vec3(preciseVelocities[i]);
+        }
+        if (mergeForces)
+            preciseForces[i] /= preciseMasses[i];
+
+        radii[i] = Planet::radiusFromMass(masses[i]);
+
+        /* The path would be invalid after this. */
+        trails.clear(keys[i] & slotMask);
+    }
+
+    compact();
+
+    return true;
+}
+
+void PlanetsUniverse::compact() {
+    const size_t count = size();
+
+    /* Anything selected or followed moves to whatever its planet is merging into. */
+    if (isValid(selected)) {
+        const size_t target = targets[indexOf(selected)];
+        selected = target < count ? keys[target] : key_type(-1);
+    }
+    if (isValid(following)) {
+        const size_t target = targets[indexOf(following)];
+        following = target < count ? keys[target] : key_type(-1);
+    }
+
+    /* Accelerations and double precision copies only need to move along if they're for the current planets. */
+    const bool keepAccelerations = accelerations.size() == count;
+    const bool keepPrecise = preciseValid && precisePositions.size() == count;
+    const bool keepForces = preciseValid && preciseForces.size() == count;
+
+    size_t kept = 0;
+
+    for (size_t i = 0; i < count; ++i) {
+        if (targets[i] != i) {
+            releaseKey(keys[i]);
+            continue;
+        }
+
+        if (kept != i) {
+            keys[kept] = keys[i];
+            positions[kept] = positions[i];
+            velocities[kept] = velocities[i];
+            masses[kept] = masses[i];
+            radii[kept] = radii[i];
+            materials[kept] = materials[i];
+
+            slots[keys[kept] & slotMask].index = uint32_t(kept);
+
+            if (keepAccelerations)
+                accelerations[kept] = accelerations[i];
+            if (keepPrecise) {
+                precisePositions[kept] = precisePositions[i];
+                preciseVelocities[kept] = preciseVelocities[i];
+            }
+            if (keepForces)
+                preciseForces[kept] = preciseForces[i];
+        }
+
+        ++kept;
+    }
+
+    if (keepAccelerations)
+        accelerations.resize(kept);
+    if (keepPrecise) {
+        precisePositions.resize(kept);
+        preciseVelocities.resize(kept);
+        /* The Gauss-Radau fit from the last step was for the planets that were there then. */
+        gaussRadau.reset();
+    }
+    if (keepForces)
+        preciseForces.resize(kept);
+
+    keys.resize(kept);
+    positions.resize(kept);
+    velocities.resize(kept);
+    masses.resize(kept);
+    radii.resize(kept);
+    materials.resize(kept);
+}
+
+void PlanetsUniverse::remove(const key_type key, const key_type replacement) {
     if (!isValid(key))
-        return planets.end();
+        return;
 
-    /* If the one we're deleting happens to be selected, select the remaining planet. */
+    /* If the one we're deleting happens to be selected or followed, move to the remaining planet. */
     if (key == selected)
         selected = replacement;
-    /* If the selected planet is after the one being deleted, it will shift down one location in the list. */
-    else if (key < selected)
-        --selected;
-
-    /* If the planet being followed happens to be the one being deleted, follow the remaining planet. */
     if (key == following)
         following = replacement;
-    /* If the planet being followed is after the one being deleted, it will shift down one location in the list. */
-    else if (key < following)
-        --following;
 
-    return planets.erase(begin() + key);
+    const size_t index = indexOf(key), last = size() - 1;
+
+    /* Fill the gap with the last planet, so nothing else has to move. */
+    if (index != last) {
+        keys[index] = keys[last];
+        positions[index] = positions[last];
+        velocities[index] = velocities[last];
+        masses[index] = masses[last];
+        radii[index] = radii[last];
+        materials[index] = materials[last];
+
+        slots[keys[index] & slotMask].index = uint32_t(index);
+    }
+
+    keys.pop_back();
+    positions.pop_back();
+    velocities.pop_back();
+    masses.pop_back();
+    radii.pop_back();
+    materials.pop_back();
+
+    releaseKey(key);
+}
+
+void PlanetsUniverse::deleteAll() {
+    /* Release the keys instead of clearing the slots, so old keys can't become valid again. */
+    for (key_type key : keys)
+        releaseKey(key);
+
+    keys.clear();
+    positions.clear();
+    velocities.clear();
+    masses.clear();
+    radii.clear();
+    materials.clear();
+
+    deleteTracers();
+
+    resetSelected();
+}
+
+void PlanetsUniverse::deleteTracers() {
+    tracerPositions.clear();
+    tracerVelocities.clear();
+    tracerAccelerations.clear();
+    tracerStarts.clear();
 }
 
 void PlanetsUniverse::generateRandom(const size_t& count, const float& positionRange, const float& maxVelocity, const float& maxMass) {
@@ -211,20 +1451,44 @@ void PlanetsUniverse::generateRandom(const size_t& count, const float& positionR
                          mass(generator)));
 }
 
+void PlanetsUniverse::addTracer(const glm::vec3& position, const glm::vec3& velocity) {
+    tracerPositions.push_back(position);
+    tracerVelocities.push_back(velocity);
+    /* It hasn't moved yet, so there's nowhere to draw it coming from. */
+    tracerStarts.push_back(position);
+
+    tracerAccelerationsValid = false;
+}
+
+void PlanetsUniverse::generateRandomTracers(const size_t& count, const float& positionRange, const float& maxVelocity) {
+    uniform_real_distribution<float> position(-positionRange, positionRange);
+    uniform_real_distribution<float> velocity(-maxVelocity, maxVelocity);
+
+    for (size_t i = 0; i < count; ++i)
+        addTracer(glm::vec3(position(generator), position(generator), position(generator)),
+                  glm::vec3(velocity(generator), velocity(generator), velocity(generator)));
+}
+
 /* TODO - This function currently does not account for other planets.
  * Doing so would be very complicated. IDK if it'd even be possible... I'll have to look into it sometime. */
-key_type PlanetsUniverse::addOrbital(Planet& around, const float& radius, const float& mass, const glm::mat4& plane) {
+key_type PlanetsUniverse::addOrbital(key_type key, const float& radius, const float& mass, const glm::mat4& plane) {
+    if (!isValid(key))
+        throw std::out_of_range("Invalid planet key!");
+
+    const size_t around = indexOf(key);
+    const float aroundMass = masses[around];
+
     /* Calculate the speed based on gravitational force and distance. */
-    float speed = sqrt((around.mass() * around.mass() * gravityConstant) / ((around.mass() + mass) * radius));
+    float speed = sqrt((aroundMass * aroundMass * gravityConstant) / ((aroundMass + mass) * radius));
 
     /* Velocity is the y column of the plane matrix * speed. */
     glm::vec3 velocity = glm::vec3(plane[1]) * speed;
 
     /* The x column is the relative position of the orbiting planet. */
-    Planet planet(around.position + glm::vec3(plane[0]) * radius, around.velocity + velocity, mass);
+    Planet planet(positions[around] + glm::vec3(plane[0]) * radius, velocities[around] + velocity, mass);
 
     /* Apply force on the planet being orbited in the opposite direction of the resulting planets velocity. */
-    around.velocity -= velocity * (mass / around.mass());
+    velocities[around] -= velocity * (mass / aroundMass);
 
     return addPlanet(planet);
 }
@@ -236,30 +1500,57 @@ void PlanetsUniverse::generateRandomOrbital(const size_t& count, key_type target
         if (!isValid(target))
             target = getRandomPlanet();
 
-        Planet &around = planets[target];
+        const size_t index = indexOf(target);
 
         uniform_real_distribution<float> angle(-glm::pi<float>(), glm::pi<float>());
-        uniform_real_distribution<float> radius(around.radius() * 1.5f, around.radius() * 80.0f);
-        uniform_real_distribution<float> mass(minimumMass, around.mass() * 0.2f);
+        uniform_real_distribution<float> radius(radii[index] * 1.5f, radii[index] * 80.0f);
+        uniform_real_distribution<float> mass(minimumMass, masses[index] * 0.2f);
 
         for (int i = 0; i < count; ++i) {
             glm::mat4 plane(1.0f);
             /* This is sort of a cheap way of making a random orbit plane. */
             plane *= glm::rotate(angle(generator), glm::sphericalRand(1.0f));
             plane *= glm::rotate(angle(generator), glm::sphericalRand(1.0f));
-            addOrbital(around, radius(generator), mass(generator), plane);
+            addOrbital(target, radius(generator), mass(generator), plane);
         }
     }
 }
 
+void PlanetsUniverse::generateRandomOrbitalTracers(const size_t& count, key_type target) {
+    if (isEmpty())
+        return;
+
+    if (!isValid(target))
+        target = getRandomPlanet();
+
+    const size_t index = indexOf(target);
+
+    /* The axis the whole disk turns around, and a direction in the disk to measure angles from. */
+    const glm::vec3 axis = glm::sphericalRand(1.0f);
+    const glm::vec3 reference = glm::normalize(glm::cross(axis, glm::abs(axis.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f)));
+
+    uniform_real_distribution<float> angle(-glm::pi<float>(), glm::pi<float>());
+    uniform_real_distribution<float> radius(radii[index] * 1.5f, radii[index] * 80.0f);
+
+    for (size_t i = 0; i < count; ++i) {
+        const float distance = radius(generator);
+        const glm::vec3 direction = glm::rotate(reference, angle(generator), axis);
+
+        /* Tracers don't pull back, so the speed only depends on the planet they're going around. */
+        const float speed = sqrt(masses[index] * gravityConstant / distance);
+
+        addTracer(positions[index] + direction * distance, velocities[index] + glm::cross(axis, direction) * speed);
+    }
+}
+
 void PlanetsUniverse::deleteEscapees() {
     /* We delete anything too far from the weighted average position. */
     glm::vec3 averagePosition;
     float totalMass = 0.0f;
 
-    for (const auto& planet : planets) {
-        averagePosition += planet.position * planet.mass();
-        totalMass += planet.mass();
+    for (size_t i = 0; i < size(); ++i) {
+        averagePosition += positions[i] * masses[i];
+        totalMass += masses[i];
     }
 
     averagePosition /= totalMass;
@@ -267,20 +1558,56 @@ void PlanetsUniverse::deleteEscapees() {
     /* The squared distance from the center outside of which we delete things. */
     const float limits2 = 1.0e12f;
 
-    for (int i = 0; i < size();) {
-        if (glm::distance2(planets[i].position, averagePosition) > limits2)
-            remove(i);
-        else
-            ++i;
+    targets.resize(size());
+    for (size_t i = 0; i < size(); ++i)
+        targets[i] = glm::distance2(positions[i], averagePosition) > limits2 ? size_t(-1) : i;
+
+    compact();
+
+    size_t kept = 0;
+    for (size_t i = 0; i < tracerCount(); ++i) {
+        if (glm::distance2(tracerPositions[i], averagePosition) > limits2)
+            continue;
+
+        tracerPositions[kept] = tracerPositions[i];
+        tracerVelocities[kept] = tracerVelocities[i];
+        tracerStarts[kept] = tracerStarts[i];
+        ++kept;
     }
+
+    tracerPositions.resize(kept);
+    tracerVelocities.resize(kept);
+    tracerStarts.resize(kept);
+    tracerAccelerationsValid = false;
 }
 
 key_type PlanetsUniverse::getRandomPlanet() {
-    if (isEmpty()) return 0;
+    if (isEmpty()) return -1;
+
+    uniform_int_distribution<size_type> random_n(0, size() - 1);
+
+    return keys[random_n(generator)];
+}
+
+double PlanetsUniverse::totalEnergy() const {
+    double kinetic = 0.0, potential = 0.0;
+
+    /* Use the double precision copies if they're up to date, rounding to float could be most of the error otherwise. */
+    bool precise = precisePositions.size() == size();
+    for (size_t i = 0; i < size() && precise; ++i)
+        precise = glm::vec3(precisePositions[i]) == positions[i] && glm::vec3(preciseVelocities[i]) == velocities[i];
 
-    uniform_int_distribution<list_type::size_type> random_n(0, size() - 1);
+    auto position = [&](size_t i) { return precise ? precisePositions[i] : glm::dvec3(positions[i]); };
+    auto velocity = [&](size_t i) { return precise ? preciseVelocities[i] : glm::dvec3(velocities[i]); };
+
+    for (size_t i = 0; i < size(); ++i) {
+        kinetic += 0.5 * double(masses[i]) * glm::dot(velocity(i), velocity(i));
+
+        for (size_t j = i + 1; j < size(); ++j)
+            potential -= double(masses[i]) * double(masses[j]) / glm::distance(position(i), position(j));
+    }
 
-    return random_n(generator);
+    return kinetic + potential * double(gravityConstant);
 }
 
 void PlanetsUniverse::centerAll() {
@@ -288,10 +1615,10 @@ void PlanetsUniverse::centerAll() {
     glm::vec3 averagePosition, averageVelocity;
     float totalMass = 0.0f;
 
-    for (const auto& planet : planets) {
-        averagePosition += planet.position * planet.mass();
-        averageVelocity += planet.velocity * planet.mass();
-        totalMass += planet.mass();
+    for (size_t i = 0; i < size(); ++i) {
+        averagePosition += positions[i] * masses[i];
+        averageVelocity += velocities[i] * masses[i];
+        totalMass += masses[i];
     }
 
     averagePosition /= totalMass;
@@ -301,10 +1628,103 @@ void PlanetsUniverse::centerAll() {
 
     /* Don't bother centering if it's already reasonably centered. */
     if (!glm::isNull(averagePosition, epsilon) || !glm::isNull(averageVelocity, epsilon)) {
-        for (auto& planet : planets) {
-            planet.position -= averagePosition;
-            planet.velocity -= averageVelocity;
-            planet.path.clear();
+        for (size_t i = 0; i < size(); ++i) {
+            positions[i] -= averagePosition;
+            velocities[i] -= averageVelocity;
+        }
+
+        for (size_t i = 0; i < tracerCount(); ++i) {
+            tracerPositions[i] -= averagePosition;
+            tracerVelocities[i] -= averageVelocity;
+            tracerStarts[i] -= averagePosition;
+        }
+
+        trails.clearAll();
+    }
+}
+
+void PlanetsUniverse::rebase() {
+    if (rebaseDistance <= 0.0f || isEmpty())
+        return;
+
+    glm::vec3 center;
+    if (isValid(following)) {
+        center = positions[indexOf(following)];
+    } else {
+        glm::dvec3 weighted;
+        double totalMass = 0.0;
+
+        for (size_t i = 0; i < size(); ++i) {
+            weighted += glm::dvec3(positions[i]) * double(masses[i]);
+            totalMass += masses[i];
+        }
+
+        center = glm::vec3(weighted / totalMass);
+    }
+
+    /* Written this way round so a center that isn't a number leaves everything alone. */
+    if (!(glm::length2(center) > rebaseDistance * rebaseDistance))
+        return;
+
+    const glm::dvec3 preciseCenter(center);
+
+    if (precisePositions.size() == size()) {
+        /* Planets with double precision copies are moved in double precision and rounded once, like a step would. */
+        for (size_t i = 0; i < size(); ++i) {
+            if (glm::vec3(precisePositions[i]) == positions[i]) {
+                precisePositions[i] -= preciseCenter;
+                positions[i] = glm::vec3(precisePositions[i]);
+            } else {
+                positions[i] -= center;
+            }
         }
+    } else {
+        for (glm::vec3& position : positions)
+            position -= center;
+    }
+
+    for (size_t i = 0; i < tracerCount(); ++i) {
+        tracerPositions[i] -= center;
+        tracerStarts[i] -= center;
     }
+
+    trails.translate(-center);
+
+    origin_p += preciseCenter;
+}
+
+/* Put values in the order given, where order[n] is the index of the value that should end up at n. */
+template<typename T> static void applyOrder(std::vector<T>& values, const std::vector<uint32_t>& order) {
+    std::vector<T> sorted(order.size());
+    for (size_t n = 0; n < order.size(); ++n)
+        sorted[n] = values[order[n]];
+    values.swap(sorted);
+}
+
+void PlanetsUniverse::sortPlanets() {
+    const size_t count = size();
+
+    mortonSort.sort(positions.data(), count, threadPool, mortonOrder);
+
+    applyOrder(keys, mortonOrder);
+    applyOrder(positions, mortonOrder);
+    applyOrder(velocities, mortonOrder);
+    applyOrder(masses, mortonOrder);
+    applyOrder(radii, mortonOrder);
+    applyOrder(materials, mortonOrder);
+
+    /* Anything that's still good for the current planets moves with them. */
+    if (accelerations.size() == count)
+        applyOrder(accelerations, mortonOrder);
+
+    if (preciseValid && precisePositions.size() == count) {
+        applyOrder(precisePositions, mortonOrder);
+        applyOrder(preciseVelocities, mortonOrder);
+        gaussRadau.reset();
+    }
+    if (preciseValid && preciseForces.size() == count)
+        applyOrder(preciseForces, mortonOrder);
+
+    for (size_t n = 0; n < count; ++n)
+        slots[keys[n] & slotMask].index = uint32_t(n);
 }
@@ -0,0 +1,248 @@
+#include "simulationrunner.h"
+#include <chrono>
+#include <algorithm>
+#include <exception>
+
+SimulationRunner::SimulationRunner(PlanetsUniverse& u) : universe(u), paused(false) { }
+
+SimulationRunner::~SimulationRunner() {
+    stop();
+}
+
+typedef std::chrono::steady_clock clock_type;
+
+/* Microseconds on the clock used for snapshot times. */
+static double microseconds(clock_type::time_point time) {
+    return std::chrono::duration<double, std::micro>(time.time_since_epoch()).count();
+}
+
+void SimulationRunner::rememberPositions() {
+    for (PlanetsUniverse::iterator it = universe.begin(); it != universe.end(); ++it) {
+        const key_type key = it.key();
+        const key_type slot = key & PlanetsUniverse::slotMask;
+
+        if (slot >= previousKeys.size()) {
+            previousKeys.resize(slot + 1, key_type(-1));
+            previousPositions.resize(slot + 1);
+        }
+
+        previousKeys[slot] = key;
+        previousPositions[slot] = (*it).position;
+    }
+
+    previousOrigin = universe.origin();
+}
+
+void SimulationRunner::publish() {
+    Snapshot& snapshot = snapshots.writeBuffer();
+
+    universe.writeSnapshot(snapshot);
+    snapshot.frame = frames;
+    snapshot.time = stepTime;
+    snapshot.interval = stepInterval;
+
+    const glm::vec3 rebased(universe.origin() - previousOrigin);
+
+    /* Planets that weren't around before the last step (or were edited since) just start where they are. */
+    snapshot.previousPositions.resize(snapshot.size());
+    for (size_t i = 0; i < snapshot.size(); ++i) {
+        const key_type slot = snapshot.keys[i] & PlanetsUniverse::slotMask;
+
+        if (slot < previousKeys.size() && previousKeys[slot] == snapshot.keys[i])
+            snapshot.previousPositions[i] = previousPositions[slot] - rebased;
+        else
+            snapshot.previousPositions[i] = snapshot.positions[i];
+    }
+
+    snapshots.publish();
+}
+
+const Snapshot& SimulationRunner::acquire() {
+    snapshots.acquire();
+    const Snapshot& snapshot = snapshots.readBuffer();
+
+    if (snapshot.interval > 0.0f) {
+        const double elapsed = microseconds(clock_type::now()) - snapshot.time;
+        blend_p = float(std::min(std::max(elapsed / snapshot.interval, 0.0), 1.0 + maximumExtrapolation));
+    } else {
+        blend_p = 1.0f;
+    }
+
+    return snapshot;
+}
+
+void SimulationRunner::update(float time) {
+    if (isRunning())
+        return;
+
+    /* The snapshot is drawn straight after this, so there's nothing to blend. */
+    stepInterval = 0.0f;
+
+    if (!paused) {
+        universe.advance(time);
+        ++frames;
+    }
+
+    publish();
+}
+
+#ifdef EMSCRIPTEN
+
+void SimulationRunner::start() { }
+void SimulationRunner::stop() { }
+
+bool SimulationRunner::isRunning() const {
+    return false;
+}
+
+void SimulationRunner::setPaused(bool value) {
+    paused = value;
+}
+
+void SimulationRunner::post(const command_type& command) {
+    command(universe);
+}
+
+void SimulationRunner::execute(const command_type& command) {
+    command(universe);
+}
+
+#else
+
+void SimulationRunner::start() {
+    if (isRunning())
+        return;
+
+    stopping = false;
+
+    /* Make sure there's something to draw straight away. */
+    publish();
+
+    thread = std::thread(&SimulationRunner::loop, this);
+}
+
+void SimulationRunner::stop() {
+    if (!isRunning())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+
+    thread.join();
+
+    /* Anything that didn't get a chance to run is done here, so nothing gets lost. */
+    for (const command_type& command : commands)
+        command(universe);
+    commands.clear();
+}
+
+bool SimulationRunner::isRunning() const {
+    return thread.joinable();
+}
+
+void SimulationRunner::setPaused(bool value) {
+    paused = value;
+}
+
+void SimulationRunner::post(const command_type& command) {
+    if (!isRunning()) {
+        command(universe);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        commands.push_back(command);
+    }
+    wake.notify_one();
+}
+
+void SimulationRunner::execute(const command_type& command) {
+    if (!isRunning()) {
+        command(universe);
+        return;
+    }
+
+    std::exception_ptr error;
+    bool done = false;
+
+    post([&](PlanetsUniverse& u) {
+        try {
+            command(u);
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        done = true;
+        finished.notify_all();
+    });
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [&] { return done; });
+    }
+
+    if (error)
+        std::rethrow_exception(error);
+}
+
+void SimulationRunner::loop() {
+    typedef clock_type clock;
+
+    const auto step = std::chrono::duration_cast<clock::duration>(std::chrono::duration<float, std::micro>(timestep));
+    clock::time_point next = clock::now();
+
+    std::vector<command_type> pending;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+
+            /* Sleep until the next step is due, unless there's something to do before that. */
+            wake.wait_until(lock, next, [this] { return stopping || !commands.empty(); });
+
+            if (stopping)
+                return;
+
+            pending.swap(commands);
+        }
+
+        for (const command_type& command : pending)
+            command(universe);
+
+        bool changed = !pending.empty();
+        pending.clear();
+
+        const clock::time_point now = clock::now();
+
+        if (now >= next) {
+            if (!paused) {
+                rememberPositions();
+                universe.advance(timestep);
+                ++frames;
+                changed = true;
+
+                /* A step that took longer than the timestep means the next snapshot will be late, so blend over the longer time. */
+                const clock::time_point done = clock::now();
+                stepTime = microseconds(done);
+                stepInterval = std::max(timestep, float(std::chrono::duration<double, std::micro>(done - now).count()));
+            } else if (stepInterval > 0.0f) {
+                /* Stop blending so the paused state is drawn exactly where it is. */
+                stepInterval = 0.0f;
+                changed = true;
+            }
+
+            /* Don't try to catch up after falling behind, the simulation just runs slower than real time instead. */
+            next = std::max(next + step, now);
+        }
+
+        if (changed)
+            publish();
+    }
+}
+
+#endif /* EMSCRIPTEN */
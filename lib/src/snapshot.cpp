@@ -0,0 +1,7 @@
+#include "snapshot.h"
+
+Planet Snapshot::planetAt(size_t index, float blend) const {
+    Planet planet(positionAt(index, blend), velocities[index], masses[index]);
+    planet.materialID = materials[index];
+    return planet;
+}
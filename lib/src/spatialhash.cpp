@@ -0,0 +1,154 @@
+#include "spatialhash.h"
+#include <glm/gtx/norm.hpp>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+/* The smallest power of two that's at least as wide as the body. */
+inline int32_t levelFor(float radius) {
+    int exponent;
+    std::frexp(radius * 2.0f, &exponent);
+    return exponent;
+}
+
+/* Which cell a coordinate is in on a grid with cells 1 / scale wide, clamped so positions way out there can't overflow.
+ * Scale is always a power of two so this is exact, and rounding down by hand avoids a call to floor(). */
+inline int64_t cellCoordinate(float position, double scale) {
+    const double cell = std::max(std::min(double(position) * scale, 4.0e18), -4.0e18);
+    const int64_t truncated = int64_t(cell);
+    return truncated - int64_t(cell < double(truncated));
+}
+
+/* Nearby cells practically never get the same full hash, since their coordinates only differ by a little and each step
+ * multiplies by something big. Multiplying only carries low bits up though, so the high bits get mixed back down at the
+ * end since the table uses the low ones. */
+inline uint64_t hashCell(int64_t x, int64_t y, int64_t z, int32_t level) {
+    uint64_t hash = uint64_t(x) * 0x9e3779b97f4a7c15ull + uint64_t(y);
+    hash = hash * 0xc2b2ae3d27d4eb4full + uint64_t(z);
+    hash = hash * 0x165667b19e3779f9ull + uint64_t(level);
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    return hash ^ (hash >> 33);
+}
+
+}
+
+void SpatialHash::overlaps(const glm::vec3* positions, const float* radii, size_t count, ThreadPool& pool, pair_list& overlaps) {
+    newCells.resize(count);
+
+    pool.parallelFor(count, block, [&](size_t begin, size_t end, unsigned int) {
+        for (size_t i = begin; i < end; ++i) {
+            const int32_t level = levelFor(radii[i]);
+            const double scale = std::ldexp(1.0, -level);
+            newCells[i] = { cellCoordinate(positions[i].x, scale), cellCoordinate(positions[i].y, scale),
+                            cellCoordinate(positions[i].z, scale), level };
+        }
+    });
+
+    /* Between most steps hardly anything changes cells, so the table from last time is usually still good. */
+    if (newCells != cells) {
+        cells.swap(newCells);
+        rebuild(count);
+    }
+
+    /* The positions still change every time. Copying them into table order means a bucket's bodies are all together. */
+    entryPoints.resize(count);
+    for (size_t n = 0; n < count; ++n)
+        entryPoints[n] = glm::vec4(positions[entries[n]], radii[entries[n]]);
+
+    threadOverlaps.resize(pool.threadCount());
+    for (pair_list& list : threadOverlaps)
+        list.clear();
+
+    pool.parallelFor(count, block, [&](size_t begin, size_t end, unsigned int thread) {
+        pair_list& found = threadOverlaps[thread];
+
+        for (size_t i = begin; i < end; ++i) {
+            const Cell& own = cells[i];
+            const glm::vec3 position = positions[i];
+            const float radius = radii[i];
+
+            /* Each pair is only looked for from the smaller body's level, and from the lower index when they're on the same one.
+             * Nothing on a level is more than half a cell in radius, so at most 3 cells along each side could be touching. */
+            for (size_t l = 0; l < levels.size(); ++l) {
+                const int32_t level = levels[l];
+                if (level < own.level)
+                    continue;
+
+                const double scale = levelScales[l];
+                const float reach = radius + float(0.5 / scale);
+
+                const int64_t firstX = cellCoordinate(position.x - reach, scale), lastX = cellCoordinate(position.x + reach, scale);
+                const int64_t firstY = cellCoordinate(position.y - reach, scale), lastY = cellCoordinate(position.y + reach, scale);
+                const int64_t firstZ = cellCoordinate(position.z - reach, scale), lastZ = cellCoordinate(position.z + reach, scale);
+
+                for (int64_t x = firstX; x <= lastX; ++x) {
+                    for (int64_t y = firstY; y <= lastY; ++y) {
+                        for (int64_t z = firstZ; z <= lastZ; ++z) {
+                            const uint64_t hash = hashCell(x, y, z, level);
+                            const size_t bucket = size_t(hash) & bucketMask;
+
+                            for (uint32_t n = bucketStarts[bucket]; n < bucketStarts[bucket + 1]; ++n) {
+                                /* Other cells can end up in the same bucket, but not with the same full hash. */
+                                if (entryHashes[n] != hash)
+                                    continue;
+
+                                const size_t j = entries[n];
+                                if (j == i || (level == own.level && j < i))
+                                    continue;
+
+                                const glm::vec4& other = entryPoints[n];
+                                const float touching = radius + other.w;
+                                if (glm::distance2(position, glm::vec3(other)) < touching * touching)
+                                    found.push_back(std::make_pair(std::min(i, j), std::max(i, j)));
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    });
+
+    for (const pair_list& list : threadOverlaps)
+        overlaps.insert(overlaps.end(), list.begin(), list.end());
+}
+
+void SpatialHash::rebuild(size_t count) {
+    size_t buckets = 1;
+    while (buckets < count * 2)
+        buckets <<= 1;
+    bucketMask = buckets - 1;
+
+    /* Counting sort, bucketStarts ends up pointing at the end of each bucket and then gets walked back to the start. */
+    cellHashes.resize(count);
+    for (size_t i = 0; i < count; ++i)
+        cellHashes[i] = hashCell(cells[i].x, cells[i].y, cells[i].z, cells[i].level);
+
+    bucketStarts.assign(buckets + 1, 0);
+    for (uint64_t hash : cellHashes)
+        ++bucketStarts[size_t(hash) & bucketMask];
+
+    for (size_t b = 1; b < buckets; ++b)
+        bucketStarts[b] += bucketStarts[b - 1];
+    bucketStarts[buckets] = uint32_t(count);
+
+    entries.resize(count);
+    entryHashes.resize(count);
+    for (size_t i = count; i-- > 0;) {
+        const uint32_t n = --bucketStarts[size_t(cellHashes[i]) & bucketMask];
+        entries[n] = uint32_t(i);
+        entryHashes[n] = cellHashes[i];
+    }
+
+    /* There's only ever a handful of levels, so checking the list for each body is quicker than sorting them all. */
+    levels.clear();
+    for (const Cell& cell : cells)
+        if (std::find(levels.begin(), levels.end(), cell.level) == levels.end())
+            levels.push_back(cell.level);
+    std::sort(levels.begin(), levels.end());
+
+    levelScales.resize(levels.size());
+    for (size_t l = 0; l < levels.size(); ++l)
+        levelScales[l] = std::ldexp(1.0, -levels[l]);
+}
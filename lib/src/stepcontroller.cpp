@@ -0,0 +1,43 @@
+#include "stepcontroller.h"
+#include <algorithm>
+
+/* How much each new measurement moves the smoothed step cost, so one slow frame doesn't throw everything off. */
+constexpr double costSmoothing = 0.25;
+
+int StepController::plan(int minimumSteps) {
+    minimumSteps = std::max(minimumSteps, 1);
+
+    if (!enabled || stepCost_p <= 0.0) {
+        /* Nothing to go on, so start with what the steps would be without the controller. */
+        steps_p = minimumSteps;
+    } else {
+        const int most = std::max(maximumSteps, minimumSteps);
+        int target = int(std::min(budget / stepCost_p, double(most)));
+
+        /* Only go up a quarter at a time, dropping is done straight away so a slow frame doesn't turn into several. */
+        if (target > steps_p)
+            target = std::min(target, steps_p + std::max(steps_p / 4, 1));
+
+        steps_p = std::max(target, 1);
+    }
+
+    timeScale_p = std::min(float(steps_p) / float(minimumSteps), 1.0f);
+
+    return steps_p;
+}
+
+void StepController::measure(int steps, double milliseconds) {
+    if (steps <= 0)
+        return;
+
+    const double cost = milliseconds / steps;
+
+    if (stepCost_p <= 0.0)
+        stepCost_p = cost;
+    else
+        stepCost_p += (cost - stepCost_p) * costSmoothing;
+}
+
+void StepController::reset() {
+    stepCost_p = 0.0;
+}
@@ -0,0 +1,128 @@
+#include "threadpool.h"
+#include <atomic>
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned int count) {
+    setThreadCount(count);
+}
+
+ThreadPool::~ThreadPool() {
+#ifndef EMSCRIPTEN
+    stop();
+#endif
+}
+
+unsigned int ThreadPool::hardwareThreads() {
+#ifdef EMSCRIPTEN
+    return 1;
+#else
+    /* This is allowed to return 0 if it can't tell. */
+    return std::max(std::thread::hardware_concurrency(), 1u);
+#endif
+}
+
+#ifdef EMSCRIPTEN
+
+void ThreadPool::setThreadCount(unsigned int) { }
+
+unsigned int ThreadPool::threadCount() const {
+    return 1;
+}
+
+void ThreadPool::run(const job_type& job) {
+    job(0);
+}
+
+#else
+
+void ThreadPool::setThreadCount(unsigned int count) {
+    if (count == 0)
+        count = hardwareThreads();
+
+    if (count == threadCount())
+        return;
+
+    stop();
+
+    stopping = false;
+
+    /* The calling thread does a share of the work, so it doesn't need a worker. */
+    for (unsigned int i = 1; i < count; ++i)
+        workers.emplace_back(&ThreadPool::worker, this, i, generation);
+}
+
+unsigned int ThreadPool::threadCount() const {
+    return unsigned(workers.size()) + 1;
+}
+
+void ThreadPool::run(const job_type& job) {
+    if (workers.empty()) {
+        job(0);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->job = &job;
+        remaining = workers.size();
+        ++generation;
+    }
+    wake.notify_all();
+
+    job(0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return remaining == 0; });
+    this->job = nullptr;
+}
+
+void ThreadPool::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+
+    for (std::thread& thread : workers)
+        thread.join();
+
+    workers.clear();
+}
+
+void ThreadPool::worker(unsigned int index, uint64_t seen) {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (true) {
+        wake.wait(lock, [&] { return stopping || generation != seen; });
+
+        if (stopping)
+            return;
+
+        seen = generation;
+        const job_type* current = job;
+
+        lock.unlock();
+        (*current)(index);
+        lock.lock();
+
+        if (--remaining == 0)
+            done.notify_one();
+    }
+}
+
+#endif /* EMSCRIPTEN */
+
+void ThreadPool::parallelFor(size_t count, size_t blockSize, const range_job_type& job) {
+    if (count <= blockSize || threadCount() == 1) {
+        job(0, count, 0);
+        return;
+    }
+
+    std::atomic<size_t> next(0);
+
+    run([&](unsigned int thread) {
+        size_t begin;
+        while ((begin = next.fetch_add(blockSize)) < count)
+            job(begin, std::min(begin + blockSize, count), thread);
+    });
+}
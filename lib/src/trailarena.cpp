@@ -0,0 +1,79 @@
+#include "trailarena.h"
+#include <algorithm>
+
+void TrailArena::reset(size_t capacity) {
+    capacity_p = capacity;
+
+    points.assign(trailCount() * stride(), glm::vec3());
+    clearAll();
+}
+
+void TrailArena::resizeTrails(size_t count) {
+    const size_t old = trailCount();
+
+    points.resize(count * stride());
+    starts.resize(count);
+    counts.resize(count);
+
+    for (size_t i = old; i < count; ++i)
+        clear(i);
+}
+
+void TrailArena::clearAll() {
+    std::fill(starts.begin(), starts.end(), 0);
+    std::fill(counts.begin(), counts.end(), 0);
+}
+
+void TrailArena::translate(const glm::vec3& offset) {
+    /* The unused parts of the rings move too, it's one pass over a single block of memory that way. */
+    for (glm::vec3& point : points)
+        point += offset;
+}
+
+void TrailArena::write(size_t trail, size_t position, const glm::vec3& point) {
+    glm::vec3* ring = &points[trail * stride()];
+
+    ring[position] = point;
+
+    /* Keep the extra point at the end matching the start. */
+    if (position == 0)
+        ring[capacity_p] = point;
+}
+
+void TrailArena::push(size_t trail, const glm::vec3& point) {
+    if (capacity_p == 0)
+        return;
+
+    if (counts[trail] < capacity_p) {
+        write(trail, (starts[trail] + counts[trail]) % capacity_p, point);
+        ++counts[trail];
+    } else {
+        /* Full, so the new point takes the place of the oldest one. */
+        write(trail, starts[trail], point);
+        starts[trail] = uint32_t((starts[trail] + 1) % capacity_p);
+    }
+}
+
+void TrailArena::setLast(size_t trail, const glm::vec3& point) {
+    write(trail, (starts[trail] + counts[trail] - 1) % capacity_p, point);
+}
+
+TrailArena::Spans TrailArena::spans(size_t trail) const {
+    Spans result = { { nullptr, 0 }, { nullptr, 0 } };
+
+    if (counts[trail] == 0)
+        return result;
+
+    const glm::vec3* ring = &points[trail * stride()];
+    const size_t start = starts[trail], count = counts[trail];
+
+    if (start + count <= capacity_p) {
+        result.first = { ring + start, count };
+    } else {
+        /* Wrapped around, the first span runs to the extra point at the end which is the same as the second span's first point. */
+        result.first = { ring + start, capacity_p - start + 1 };
+        result.second = { ring, start + count - capacity_p };
+    }
+
+    return result;
+}
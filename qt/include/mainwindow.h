@@ -35,6 +35,24 @@ private slots:
     void on_trailLengthSpinBox_valueChanged(int value);
     void on_trailRecordDistanceDoubleSpinBox_valueChanged(double value);
     void on_planetScaleDoubleSpinBox_valueChanged(double value);
+    void on_gravitySolverComboBox_currentIndexChanged(int index);
+    void on_openingAngleDoubleSpinBox_valueChanged(double value);
+    void on_multipoleOrderSpinBox_valueChanged(int value);
+    void on_multipoleToleranceDoubleSpinBox_valueChanged(double value);
+    void on_meshSizeComboBox_currentIndexChanged(int index);
+    void on_meshCorrectionCheckBox_toggled(bool checked);
+    void on_mergePlanetsCheckBox_toggled(bool checked);
+    void on_hashCollisionsCheckBox_toggled(bool checked);
+    void on_sortIntervalSpinBox_valueChanged(int value);
+    void on_rebaseDistanceDoubleSpinBox_valueChanged(double value);
+    void on_threadCountSpinBox_valueChanged(int value);
+    void on_adaptiveStepsCheckBox_toggled(bool checked);
+    void on_frameBudgetDoubleSpinBox_valueChanged(double value);
+    void on_integratorComboBox_currentIndexChanged(int index);
+    void on_precisionComboBox_currentIndexChanged(int index);
+    void on_blockAccuracyDoubleSpinBox_valueChanged(double value);
+    void on_gaussRadauToleranceSpinBox_valueChanged(int value);
+    void on_regularizationRangeDoubleSpinBox_valueChanged(double value);
 
     void on_firingVelocityDoubleSpinBox_valueChanged(double value);
     void on_firingMassSpinBox_valueChanged(int value);
@@ -45,6 +63,7 @@ private slots:
     void on_actionDraw_Planar_Circles_toggled(bool value);
 
     void on_randomOrbitalCheckBox_toggled(bool checked);
+    void on_randomTracersCheckBox_toggled(bool checked);
     void on_generateRandomPushButton_clicked();
 
     void openRecentFile();
@@ -68,18 +87,27 @@ private:
     const static QString settingTrailLength;
     const static QString settingTrailDelta;
     const static QString settingStepsPerFrame;
+    const static QString settingThreadCount;
 
     Ui::MainWindow* ui;
 
     /* The last thing the speed dial was set to. */
     int speedDialMemory;
 
+    /* The simulation speed in the last snapshot, the dial only follows it when something else changes it. */
+    float snapshotSpeed = -1.0f;
+
     QSettings settings;
 
     /* These labels go in the statusbar. */
     QLabel* planetCountLabel;
+    QLabel* stepsLabel;
     QLabel* fpsLabel;
     QLabel* averagefpsLabel;
+    QLabel* multipoleErrorLabel;
+
+    /* Load a simulation file, waiting for the simulation thread to do it. Returns the number of planets loaded. */
+    int loadSimulation(const QString& filename, bool clear = true);
 
     /* Read recent file list from settings. */
     QStringList getRecentFiles();
@@ -2,6 +2,7 @@
 
 #include "placinginterface.h"
 #include "planetsuniverse.h"
+#include "simulationrunner.h"
 #include "spheregenerator.h"
 #include "grid.h"
 #include "camera.h"
@@ -25,6 +26,13 @@ class QMouseEvent;
 
 class PlanetsWidget : public QOpenGLWidget, public QOpenGLFunctions {
     Q_OBJECT
+public:
+    /* These come first so they exist before anything that uses them. */
+    PlanetsUniverse universe;
+
+    /* Steps the universe on its own thread, everything else only reads its snapshots and posts changes to it. */
+    SimulationRunner runner;
+
 private:
     /* GL shader and uniform handles for texture shader. */
     QOpenGLShaderProgram shaderTexture;
@@ -67,6 +75,10 @@ private:
     QOpenGLBuffer gridBuffer;
 
     const static QColor trailColor;
+    const static QColor tracerColor;
+
+    /* Blended tracer positions for drawing, kept around so it doesn't get reallocated every frame. */
+    std::vector<glm::vec3> tracerPoints;
 
 #ifdef PLANETS3D_QT_USE_SDL_GAMEPAD
     PlanetsGamepad gamepad;
@@ -75,8 +87,6 @@ private:
 public:
     PlanetsWidget(QWidget *parent = nullptr);
 
-    PlanetsUniverse universe;
-
     PlacingInterface placing;
 
     Grid grid;
@@ -2,6 +2,7 @@
 #include "ui_mainwindow.h"
 #include "version.h"
 #include <functional>
+#include <cmath>
 #include <QFileDialog>
 #include <QMessageBox>
 #include <QCloseEvent>
@@ -18,10 +19,14 @@ MainWindow::MainWindow(QWidget* parent) : QMainWindow(parent), ui(new Ui::MainWi
     ui->PauseResume_Button->setFocus();
 
     /*Set the limits defined in the universe. */
-    ui->newMass_SpinBox->setMinimum(ui->centralwidget->universe.minimumMass);
-    ui->newMass_SpinBox->setMaximum(ui->centralwidget->universe.maximumMass);
-    ui->firingMassSpinBox->setMinimum(ui->centralwidget->universe.minimumMass);
-    ui->firingMassSpinBox->setMaximum(ui->centralwidget->universe.maximumMass);
+    ui->newMass_SpinBox->setMinimum(PlanetsUniverse::minimumMass);
+    ui->newMass_SpinBox->setMaximum(PlanetsUniverse::maximumMass);
+    ui->firingMassSpinBox->setMinimum(PlanetsUniverse::minimumMass);
+    ui->firingMassSpinBox->setMaximum(PlanetsUniverse::maximumMass);
+
+    /* The universe starts out using every hardware thread. */
+    ui->threadCountSpinBox->setMaximum(ThreadPool::hardwareThreads());
+    ui->threadCountSpinBox->setValue(ui->centralwidget->runner.current().threadCount);
 
     connect(ui->actionExit, &QAction::triggered, this, &QMainWindow::close);
     connect(ui->actionAbout_Qt, &QAction::triggered, QApplication::instance(), &QApplication::aboutQt);
@@ -39,19 +44,23 @@ MainWindow::MainWindow(QWidget* parent) : QMainWindow(parent), ui(new Ui::MainWi
     connect(ui->actionPlain_Average,                    &QAction::triggered,    ui->centralwidget, &PlanetsWidget::followPlainAverage);
     connect(ui->actionWeighted_Average,                 &QAction::triggered,    ui->centralwidget, &PlanetsWidget::followWeightedAverage);
 
-    connect(ui->actionDelete,           &QAction::triggered, std::bind(&PlanetsUniverse::deleteSelected,    &ui->centralwidget->universe));
-    connect(ui->actionCenter_All,       &QAction::triggered, std::bind(&PlanetsUniverse::centerAll,         &ui->centralwidget->universe));
-    connect(ui->actionDelete_Escapees,  &QAction::triggered, std::bind(&PlanetsUniverse::deleteEscapees,    &ui->centralwidget->universe));
+    connect(ui->actionDelete,           &QAction::triggered, std::bind(&SimulationRunner::post, &ui->centralwidget->runner, &PlanetsUniverse::deleteSelected));
+    connect(ui->actionCenter_All,       &QAction::triggered, std::bind(&SimulationRunner::post, &ui->centralwidget->runner, &PlanetsUniverse::centerAll));
+    connect(ui->actionDelete_Escapees,  &QAction::triggered, std::bind(&SimulationRunner::post, &ui->centralwidget->runner, &PlanetsUniverse::deleteEscapees));
 
     connect(ui->gridRangeSpinBox, SIGNAL(valueChanged(int)), ui->centralwidget, SLOT(setGridRange(int)));
 
     /* Set up the statusbar labels. */
     ui->statusbar->addPermanentWidget(planetCountLabel = new QLabel(ui->statusbar));
+    ui->statusbar->addPermanentWidget(stepsLabel = new QLabel(ui->statusbar));
     ui->statusbar->addPermanentWidget(fpsLabel = new QLabel(ui->statusbar));
     ui->statusbar->addPermanentWidget(averagefpsLabel = new QLabel(ui->statusbar));
+    ui->statusbar->addPermanentWidget(multipoleErrorLabel = new QLabel(ui->statusbar));
     fpsLabel->setFixedWidth(120);
     planetCountLabel->setFixedWidth(120);
+    stepsLabel->setFixedWidth(180);
     averagefpsLabel->setFixedWidth(160);
+    multipoleErrorLabel->setFixedWidth(160);
 
     /* Connect the statusbar labels to the correct signals. */
     connect(ui->centralwidget, &PlanetsWidget::updateFPSStatusMessage,          fpsLabel,           &QLabel::setText);
@@ -68,7 +77,7 @@ MainWindow::MainWindow(QWidget* parent) : QMainWindow(parent), ui(new Ui::MainWi
     /* Try loading file from command line arguments... */
     for (const QString& argument : QApplication::arguments()) {
         try {
-            ui->centralwidget->universe.load(argument.toStdString());
+            loadSimulation(argument);
             break;
         } catch (...) { /* We don't care if there are errors, just ignore them. */ }
     }
@@ -83,6 +92,8 @@ MainWindow::MainWindow(QWidget* parent) : QMainWindow(parent), ui(new Ui::MainWi
     settings.beginGroup(categoryGraphics);
     ui->actionGrid->setChecked(settings.value(settingDrawGrid).toBool());
     ui->actionDraw_Paths->setChecked(settings.value(settingDrawPaths).toBool());
+    /* Only changes if it's checked, the universe has to know when it isn't too. */
+    on_actionDraw_Paths_toggled(ui->actionDraw_Paths->isChecked());
 
     /* These aren't auto-saved, so for the moment they must be manually added to the config file. */
     if (settings.contains(settingGridDimensions))
@@ -100,6 +111,9 @@ MainWindow::MainWindow(QWidget* parent) : QMainWindow(parent), ui(new Ui::MainWi
     if (settings.contains(settingStepsPerFrame))
         ui->stepsPerFrameSpinBox->setValue(settings.value(settingStepsPerFrame).toInt());
 
+    if (settings.contains(settingThreadCount))
+        ui->threadCountSpinBox->setValue(settings.value(settingThreadCount).toInt());
+
     setAcceptDrops(true);
 
     updateRecentFileActions();
@@ -122,7 +136,7 @@ MainWindow::~MainWindow() {
 }
 
 void MainWindow::closeEvent(QCloseEvent* e) {
-    if (!ui->centralwidget->universe.isEmpty()) {
+    if (!ui->centralwidget->runner.current().isEmpty()) {
         int result = QMessageBox::warning(this, tr("Are You Sure?"), tr("Are you sure you wish to exit? (universe will not be saved...)"),
                                           QMessageBox::Yes | QMessageBox::Save | QMessageBox::No, QMessageBox::Yes);
 
@@ -134,21 +148,25 @@ void MainWindow::closeEvent(QCloseEvent* e) {
 }
 
 void MainWindow::on_createPlanet_PushButton_clicked() {
-    ui->centralwidget->universe.selected = ui->centralwidget->universe.addPlanet(
-                Planet(glm::vec3(ui->newPosX_SpinBox->value(),      ui->newPosY_SpinBox->value(),      ui->newPosZ_SpinBox->value()),
-                       glm::vec3(ui->newVelocityX_SpinBox->value(), ui->newVelocityY_SpinBox->value(), ui->newVelocityZ_SpinBox->value())
-                       * ui->centralwidget->universe.velocityFactor,
-                       ui->newMass_SpinBox->value()));
+    const Planet planet(glm::vec3(ui->newPosX_SpinBox->value(),      ui->newPosY_SpinBox->value(),      ui->newPosZ_SpinBox->value()),
+                        glm::vec3(ui->newVelocityX_SpinBox->value(), ui->newVelocityY_SpinBox->value(), ui->newVelocityZ_SpinBox->value())
+                        * PlanetsUniverse::velocityFactor,
+                        ui->newMass_SpinBox->value());
+
+    ui->centralwidget->runner.post([planet](PlanetsUniverse& universe) { universe.selected = universe.addPlanet(planet); });
 }
 
 void MainWindow::on_actionClear_Velocity_triggered() {
-    if (ui->centralwidget->universe.isSelectedValid())
-        ui->centralwidget->universe.getSelected().velocity = glm::vec3();
+    ui->centralwidget->runner.post([](PlanetsUniverse& universe) {
+        if (universe.isSelectedValid())
+            universe.getSelected().velocity = glm::vec3();
+    });
 }
 
 void MainWindow::on_speed_Dial_valueChanged(int value) {
-    ui->centralwidget->universe.simulationSpeed = float(value * speedDialMax) / ui->speed_Dial->maximum();
-    ui->speedDisplay_lcdNumber->display(ui->centralwidget->universe.simulationSpeed);
+    const float speed = float(value * speedDialMax) / ui->speed_Dial->maximum();
+    ui->centralwidget->runner.set(&PlanetsUniverse::simulationSpeed, speed);
+    ui->speedDisplay_lcdNumber->display(speed);
 
     /* Make sure speed related UI elements are up to date. */
     ui->PauseResume_Button->setText(value == 0 ? tr("Resume") : tr("Pause"));
@@ -175,9 +193,9 @@ void MainWindow::on_FastForward_Button_clicked() {
 }
 
 void MainWindow::on_actionNew_Simulation_triggered() {
-    if (!ui->centralwidget->universe.isEmpty() && QMessageBox::warning(this, tr("Are You Sure?"), tr("Are you sure you wish to destroy the universe? (i.e. delete all planets.)"),
-                                                                       QMessageBox::Yes | QMessageBox::No, QMessageBox::Yes) == QMessageBox::Yes)
-        ui->centralwidget->universe.deleteAll();
+    if (!ui->centralwidget->runner.current().isEmpty() && QMessageBox::warning(this, tr("Are You Sure?"), tr("Are you sure you wish to destroy the universe? (i.e. delete all planets.)"),
+                                                                               QMessageBox::Yes | QMessageBox::No, QMessageBox::Yes) == QMessageBox::Yes)
+        ui->centralwidget->runner.post([](PlanetsUniverse& universe) { universe.deleteAll(); });
 }
 
 void MainWindow::on_actionOpen_Simulation_triggered() {
@@ -186,7 +204,7 @@ void MainWindow::on_actionOpen_Simulation_triggered() {
     if (!filename.isEmpty()) {
         /* IO functions can throw errors. */
         try {
-            int loaded = ui->centralwidget->universe.load(filename.toStdString());
+            int loaded = loadSimulation(filename);
             ui->statusbar->showMessage(("Loaded %1 planets from \"" + filename + '"').arg(loaded), 8000);
             addRecentFile(filename);
         } catch (const std::exception& err) {
@@ -201,7 +219,7 @@ void MainWindow::on_actionAppend_Simulation_triggered() {
     if (!filename.isEmpty()) {
         /* IO functions can throw errors. */
         try {
-            int loaded = ui->centralwidget->universe.load(filename.toStdString(), false);
+            int loaded = loadSimulation(filename, false);
             ui->statusbar->showMessage(("Loaded %1 planets from \"" + filename + '"').arg(loaded), 8000);
             addRecentFile(filename);
         } catch (const std::exception& err) {
@@ -211,13 +229,14 @@ void MainWindow::on_actionAppend_Simulation_triggered() {
 }
 
 bool MainWindow::on_actionSave_Simulation_triggered() {
-    if (!ui->centralwidget->universe.isEmpty()) {
+    if (!ui->centralwidget->runner.current().isEmpty()) {
         QString filename = QFileDialog::getSaveFileName(this, tr("Save Simulation"), "", tr("Simulation files (*.xml)"));
 
         if (!filename.isEmpty()) {
             /* IO functions can throw errors. */
             try {
-                ui->centralwidget->universe.save(filename.toStdString());
+                const std::string file = filename.toStdString();
+                ui->centralwidget->runner.execute([&file](PlanetsUniverse& universe) { universe.save(file); });
                 ui->statusbar->showMessage("Simulation saved to \"" + filename + '"', 8000);
                 addRecentFile(filename);
                 return true;
@@ -249,11 +268,11 @@ void MainWindow::on_actionAbout_triggered() {
 }
 
 void MainWindow::on_stepsPerFrameSpinBox_valueChanged(int value) {
-    ui->centralwidget->universe.stepsPerFrame = value;
+    ui->centralwidget->runner.set(&PlanetsUniverse::stepsPerFrame, value);
 }
 
 void MainWindow::on_trailLengthSpinBox_valueChanged(int value) {
-    ui->centralwidget->universe.pathLength = value;
+    ui->centralwidget->runner.set(&PlanetsUniverse::pathLength, size_t(value));
 }
 
 void MainWindow::on_planetScaleDoubleSpinBox_valueChanged(double value) {
@@ -261,11 +280,97 @@ void MainWindow::on_planetScaleDoubleSpinBox_valueChanged(double value) {
 }
 
 void MainWindow::on_trailRecordDistanceDoubleSpinBox_valueChanged(double value) {
-    ui->centralwidget->universe.pathRecordDistance = value * value;
+    ui->centralwidget->runner.set(&PlanetsUniverse::pathRecordDistance, float(value * value));
+}
+
+void MainWindow::on_gravitySolverComboBox_currentIndexChanged(int index) {
+    ui->centralwidget->runner.set(&PlanetsUniverse::gravitySolver, PlanetsUniverse::GravitySolver(index));
+
+    /* Each solver's settings only mean anything to that solver. */
+    ui->openingAngleDoubleSpinBox->setEnabled(index == PlanetsUniverse::BarnesHut);
+    ui->multipoleOrderSpinBox->setEnabled(index == PlanetsUniverse::FastMultipole);
+    ui->multipoleToleranceDoubleSpinBox->setEnabled(index == PlanetsUniverse::FastMultipole);
+    ui->meshSizeComboBox->setEnabled(index == PlanetsUniverse::ParticleMeshFFT);
+    ui->meshCorrectionCheckBox->setEnabled(index == PlanetsUniverse::ParticleMeshFFT);
+}
+
+void MainWindow::on_openingAngleDoubleSpinBox_valueChanged(double value) {
+    ui->centralwidget->runner.set(&PlanetsUniverse::openingAngle, float(value));
+}
+
+void MainWindow::on_multipoleOrderSpinBox_valueChanged(int value) {
+    ui->centralwidget->runner.set(&PlanetsUniverse::multipoleOrder, value);
+}
+
+void MainWindow::on_multipoleToleranceDoubleSpinBox_valueChanged(double value) {
+    ui->centralwidget->runner.set(&PlanetsUniverse::multipoleTolerance, float(value));
+}
+
+void MainWindow::on_meshSizeComboBox_currentIndexChanged(int index) {
+    /* The sizes listed start at 16 and double each time. */
+    ui->centralwidget->runner.set(&PlanetsUniverse::meshSize, 16 << index);
+}
+
+void MainWindow::on_meshCorrectionCheckBox_toggled(bool checked) {
+    ui->centralwidget->runner.set(&PlanetsUniverse::meshCorrection, checked);
+}
+
+void MainWindow::on_mergePlanetsCheckBox_toggled(bool checked) {
+    ui->centralwidget->runner.set(&PlanetsUniverse::mergePlanets, checked);
+}
+
+void MainWindow::on_hashCollisionsCheckBox_toggled(bool checked) {
+    ui->centralwidget->runner.set(&PlanetsUniverse::hashCollisions, checked);
+}
+
+void MainWindow::on_sortIntervalSpinBox_valueChanged(int value) {
+    ui->centralwidget->runner.set(&PlanetsUniverse::sortInterval, value);
+}
+
+void MainWindow::on_rebaseDistanceDoubleSpinBox_valueChanged(double value) {
+    ui->centralwidget->runner.set(&PlanetsUniverse::rebaseDistance, float(value));
+}
+
+void MainWindow::on_threadCountSpinBox_valueChanged(int value) {
+    ui->centralwidget->runner.post([value](PlanetsUniverse& universe) { universe.setThreadCount(value); });
+}
+
+void MainWindow::on_adaptiveStepsCheckBox_toggled(bool checked) {
+    ui->centralwidget->runner.post([checked](PlanetsUniverse& universe) { universe.stepController.enabled = checked; });
+    ui->frameBudgetDoubleSpinBox->setEnabled(checked);
+}
+
+void MainWindow::on_frameBudgetDoubleSpinBox_valueChanged(double value) {
+    ui->centralwidget->runner.post([value](PlanetsUniverse& universe) { universe.stepController.budget = value; });
+}
+
+void MainWindow::on_integratorComboBox_currentIndexChanged(int index) {
+    ui->centralwidget->runner.set(&PlanetsUniverse::integrator, PlanetsUniverse::Integrator(index));
+
+    ui->blockAccuracyDoubleSpinBox->setEnabled(index == PlanetsUniverse::BlockTimesteps);
+    ui->gaussRadauToleranceSpinBox->setEnabled(index == PlanetsUniverse::IAS15);
+    ui->regularizationRangeDoubleSpinBox->setEnabled(index == PlanetsUniverse::Leapfrog || index == PlanetsUniverse::WisdomHolman);
+}
+
+void MainWindow::on_precisionComboBox_currentIndexChanged(int index) {
+    ui->centralwidget->runner.set(&PlanetsUniverse::precision, PlanetsUniverse::Precision(index));
+}
+
+void MainWindow::on_blockAccuracyDoubleSpinBox_valueChanged(double value) {
+    ui->centralwidget->runner.set(&PlanetsUniverse::blockAccuracy, float(value));
+}
+
+void MainWindow::on_gaussRadauToleranceSpinBox_valueChanged(int value) {
+    /* The spin box holds the exponent, shown with a "1e" prefix. */
+    ui->centralwidget->runner.set(&PlanetsUniverse::gaussRadauTolerance, float(std::pow(10.0, value)));
+}
+
+void MainWindow::on_regularizationRangeDoubleSpinBox_valueChanged(double value) {
+    ui->centralwidget->runner.set(&PlanetsUniverse::regularizationRange, float(value));
 }
 
 void MainWindow::on_firingVelocityDoubleSpinBox_valueChanged(double value) {
-    ui->centralwidget->placing.firingSpeed = value * ui->centralwidget->universe.velocityFactor;
+    ui->centralwidget->placing.firingSpeed = value * PlanetsUniverse::velocityFactor;
 }
 
 void MainWindow::on_firingMassSpinBox_valueChanged(int value) {
@@ -278,6 +383,8 @@ void MainWindow::on_actionGrid_toggled(bool value) {
 
 void MainWindow::on_actionDraw_Paths_toggled(bool value) {
     ui->centralwidget->drawPlanetTrails = value;
+    /* Nothing else uses the trails, so there's no point recording them unless they're drawn. */
+    ui->centralwidget->runner.set(&PlanetsUniverse::recordPaths, value);
 }
 
 void MainWindow::on_actionDraw_Planar_Circles_toggled(bool value) {
@@ -295,20 +402,38 @@ void MainWindow::on_actionHide_Planets_toggled(bool value) {
 void MainWindow::on_randomOrbitalCheckBox_toggled(bool checked) {
     /* All these boxes are unused for orbital mode. */
     ui->randomRangeDoubleSpinBox->setEnabled(!checked);
-    ui->randomMassDoubleSpinBox->setEnabled(!checked);
+    ui->randomMassDoubleSpinBox->setEnabled(!checked && !ui->randomTracersCheckBox->isChecked());
     ui->randomSpeedDoubleSpinBox->setEnabled(!checked);
 }
 
+void MainWindow::on_randomTracersCheckBox_toggled(bool checked) {
+    /* Tracers have no mass, and are cheap enough to make a lot more of. */
+    ui->randomMassDoubleSpinBox->setEnabled(!checked && !ui->randomOrbitalCheckBox->isChecked());
+    ui->randomAmountSpinBox->setMaximum(checked ? 100000 : 100);
+}
+
 void MainWindow::on_generateRandomPushButton_clicked() {
-    if (!ui->randomOrbitalCheckBox->isChecked())
-        ui->centralwidget->universe.generateRandom(ui->randomAmountSpinBox->value(), ui->randomRangeDoubleSpinBox->value(),
-                                                   ui->randomSpeedDoubleSpinBox->value() * ui->centralwidget->universe.velocityFactor,
-                                                   ui->randomMassDoubleSpinBox->value());
-    else if (ui->centralwidget->universe.isEmpty())
+    const int amount = ui->randomAmountSpinBox->value();
+
+    if (ui->randomTracersCheckBox->isChecked() && !ui->randomOrbitalCheckBox->isChecked()) {
+        const float range = ui->randomRangeDoubleSpinBox->value();
+        const float speed = ui->randomSpeedDoubleSpinBox->value() * PlanetsUniverse::velocityFactor;
+
+        ui->centralwidget->runner.post([=](PlanetsUniverse& universe) { universe.generateRandomTracers(amount, range, speed); });
+    } else if (!ui->randomOrbitalCheckBox->isChecked()) {
+        const float range = ui->randomRangeDoubleSpinBox->value();
+        const float speed = ui->randomSpeedDoubleSpinBox->value() * PlanetsUniverse::velocityFactor;
+        const float mass = ui->randomMassDoubleSpinBox->value();
+
+        ui->centralwidget->runner.post([=](PlanetsUniverse& universe) { universe.generateRandom(amount, range, speed, mass); });
+    } else if (ui->centralwidget->runner.current().isEmpty()) {
         /* If orbital is checked but the universe is empty, we can'tgenerate. */
         QMessageBox::warning(this, tr("Can't generate planets!"), tr("Nothing for new planets to orbit around!"));
-    else
-        ui->centralwidget->universe.generateRandomOrbital(ui->randomAmountSpinBox->value(), ui->centralwidget->universe.selected);
+    } else if (ui->randomTracersCheckBox->isChecked()) {
+        ui->centralwidget->runner.post([amount](PlanetsUniverse& universe) { universe.generateRandomOrbitalTracers(amount, universe.selected); });
+    } else {
+        ui->centralwidget->runner.post([amount](PlanetsUniverse& universe) { universe.generateRandomOrbital(amount, universe.selected); });
+    }
 }
 
 void MainWindow::on_actionClear_triggered() {
@@ -366,7 +491,7 @@ void MainWindow::openRecentFile() {
         QString path = action->toolTip();
 
         try {
-            int loaded = ui->centralwidget->universe.load(path.toStdString());
+            int loaded = loadSimulation(path);
 
             ui->statusbar->showMessage(("Loaded %1 planets from \"" + path + '"').arg(loaded), 8000);
 
@@ -391,7 +516,7 @@ void MainWindow::dropEvent(QDropEvent* event) {
     for (const QUrl& url : event->mimeData()->urls()) {
         /* IO functions can throw errors. */
         try {
-            int loaded = ui->centralwidget->universe.load(url.toLocalFile().toStdString());
+            int loaded = loadSimulation(url.toLocalFile());
 
             ui->statusbar->showMessage(("Loaded %1 planets from \"" + url.toLocalFile() + '"').arg(loaded), 8000);
 
@@ -408,12 +533,12 @@ bool MainWindow::event(QEvent* event) {
     switch (event->type()) {
     case QEvent::WindowActivate:
         /* If paused, resume. */
-        if (ui->centralwidget->universe.simulationSpeed <= 0.0f)
+        if (ui->centralwidget->runner.current().simulationSpeed <= 0.0f)
             on_PauseResume_Button_clicked();
         break;
     case QEvent::WindowDeactivate:
         /* If running, pause. */
-        if (ui->centralwidget->universe.simulationSpeed > 0.0f)
+        if (ui->centralwidget->runner.current().simulationSpeed > 0.0f)
             on_PauseResume_Button_clicked();
         break;
     default: break;
@@ -422,24 +547,60 @@ bool MainWindow::event(QEvent* event) {
 }
 
 void MainWindow::on_materialSpinBox_valueChanged(int value) {
-    if (ui->centralwidget->universe.isSelectedValid())
-        ui->centralwidget->universe.getSelected().materialID = value;
+    const key_type selected = ui->centralwidget->runner.current().selected;
+
+    ui->centralwidget->runner.post([selected, value](PlanetsUniverse& universe) {
+        if (universe.isValid(selected))
+            universe[selected].materialID = value;
+    });
+}
+
+int MainWindow::loadSimulation(const QString& filename, bool clear) {
+    const std::string file = filename.toStdString();
+    int loaded = 0;
+
+    ui->centralwidget->runner.execute([&](PlanetsUniverse& universe) { loaded = universe.load(file, clear); });
+
+    return loaded;
 }
 
 void MainWindow::frameUpdate() {
-    if (ui->centralwidget->universe.size() == 1)
+    const Snapshot& snapshot = ui->centralwidget->runner.current();
+
+    if (snapshot.size() == 1)
         planetCountLabel->setText(tr("1 planet"));
     else
-        planetCountLabel->setText(tr("%1 planets").arg(ui->centralwidget->universe.size()));
+        planetCountLabel->setText(tr("%1 planets").arg(snapshot.size()));
 
-    /* If the simulation speed is different from the dial's value, update the dial (which will also update the other speed UI elements). */
-    if (int(ui->centralwidget->universe.simulationSpeed * ui->speed_Dial->maximum() / speedDialMax) != ui->speed_Dial->value())
-        ui->speed_Dial->setValue(int(ui->centralwidget->universe.simulationSpeed * ui->speed_Dial->maximum() / speedDialMax));
+    if (!snapshot.tracerPositions.empty())
+        planetCountLabel->setText(planetCountLabel->text() + tr(", %1 tracers").arg(snapshot.tracerPositions.size()));
+
+    /* Show what the step controller decided for the last frame. */
+    const StepController& controller = snapshot.stepController;
+    if (controller.isSlowed())
+        stepsLabel->setText(tr("%1 steps/frame (%2% speed)").arg(controller.steps()).arg(int(controller.timeScale() * 100.0f)));
+    else
+        stepsLabel->setText(tr("%1 steps/frame").arg(controller.steps()));
+
+    /* How far off the fast multipole solver was from direct summation on the last frame. */
+    if (snapshot.gravitySolver == PlanetsUniverse::FastMultipole)
+        multipoleErrorLabel->setText(tr("force error %1").arg(snapshot.multipoleError, 0, 'e', 2));
+    else
+        multipoleErrorLabel->clear();
+
+    /* If the simulation speed was changed by something other than the dial, update the dial (which will also update the other speed UI elements).
+     * Changes from the dial take a moment to show up in a snapshot, so only look at the speed when the snapshot's value changes. */
+    if (snapshot.simulationSpeed != snapshotSpeed) {
+        snapshotSpeed = snapshot.simulationSpeed;
+
+        if (int(snapshotSpeed * ui->speed_Dial->maximum() / speedDialMax) != ui->speed_Dial->value())
+            ui->speed_Dial->setValue(int(snapshotSpeed * ui->speed_Dial->maximum() / speedDialMax));
+    }
 
-    if (ui->centralwidget->universe.isSelectedValid()) {
-        const Planet& selected = ui->centralwidget->universe.getSelected();
+    if (snapshot.isSelectedValid()) {
+        const Planet selected = snapshot.getSelected();
 
-        glm::vec3 velocity = selected.velocity / ui->centralwidget->universe.velocityFactor;
+        glm::vec3 velocity = selected.velocity / PlanetsUniverse::velocityFactor;
 
         ui->positionLabel->setText(QString("x: %0, y: %1, z: %2").arg(selected.position.x).arg(selected.position.y).arg(selected.position.z));
         ui->velocityLabel->setText(QString("x: %0, y: %1, z: %2").arg(velocity.x).arg(velocity.y).arg(velocity.z));
@@ -467,3 +628,4 @@ const QString MainWindow::settingGridDimensions =   "GridDimensions";
 const QString MainWindow::settingTrailLength =      "TrailLength";
 const QString MainWindow::settingTrailDelta =       "TrailDelta";
 const QString MainWindow::settingStepsPerFrame =    "StepsPerFrame";
+const QString MainWindow::settingThreadCount =      "ThreadCount";
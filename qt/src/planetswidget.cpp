@@ -14,10 +14,10 @@ constexpr int normal    = 1;
 constexpr int tangent   = 2;
 constexpr int uv        = 3;
 
-PlanetsWidget::PlanetsWidget(QWidget* parent) : QOpenGLWidget(parent), placing(universe), camera(universe),
+PlanetsWidget::PlanetsWidget(QWidget* parent) : QOpenGLWidget(parent), runner(universe), placing(runner), camera(runner),
     screenshotDir(QDir::homePath() + "/Pictures/Planets3D-Screenshots/"), highResSphereTris(QOpenGLBuffer::IndexBuffer),
 #ifdef PLANETS3D_QT_USE_SDL_GAMEPAD
-    gamepad(universe, camera, placing),
+    gamepad(runner, camera, placing),
 #endif
     lowResSphereLines(QOpenGLBuffer::IndexBuffer), circleLines(QOpenGLBuffer::IndexBuffer) {
     /* We want mouse movement events. */
@@ -31,6 +31,8 @@ PlanetsWidget::PlanetsWidget(QWidget* parent) : QOpenGLWidget(parent), placing(u
 
     gamepad.closeFunction = &QApplication::closeAllWindows;
 #endif
+
+    runner.start();
 }
 
 void PlanetsWidget::initializeGL() {
@@ -171,8 +173,11 @@ void PlanetsWidget::paintGL() {
 #endif
 
     /* Don't advance if placing. */
-    if (placing.step == PlacingInterface::NotPlacing || placing.step == PlacingInterface::Firing)
-        universe.advance(delay);
+    runner.setPaused(placing.step != PlacingInterface::NotPlacing && placing.step != PlacingInterface::Firing);
+
+    /* Only does anything if the runner doesn't have its own thread. */
+    runner.update(delay);
+    runner.acquire();
 
     render();
 
@@ -185,7 +190,12 @@ void PlanetsWidget::paintGL() {
 void PlanetsWidget::render() {
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+    const Snapshot& snapshot = runner.current();
+    /* Planets are drawn partway between the last two steps so motion stays smooth no matter how often the simulation steps. */
+    const float blend = runner.blend();
+
     camera.setup();
+    placing.followOrigin();
 
     if (!hidePlanets) {
         /* Only used for drawing the planets. */
@@ -213,24 +223,19 @@ void PlanetsWidget::render() {
         shaderTexture.setAttributeBuffer(tangent,   GL_FLOAT, offsetof(Vertex, tangent),    3, sizeof(Vertex));
         shaderTexture.setAttributeBuffer(uv,        GL_FLOAT, offsetof(Vertex, uv),         2, sizeof(Vertex));
 
-        std::uniform_int_distribution<int> material(0, NUM_PLANET_TEXTURES-1);
-
         for (int i = 0; i < NUM_PLANET_TEXTURES; ++i) {
             glActiveTexture(GL_TEXTURE0);
             textures_diff[i]->bind();
             glActiveTexture(GL_TEXTURE1);
             textures_nrm[i]->bind();
 
-            for (Planet& planet : universe) {
-                if (planet.materialID > NUM_PLANET_TEXTURES)
-                    planet.materialID = material(universe.generator);
-
-                if (planet.materialID != i)
+            for (size_t p = 0; p < snapshot.size(); ++p) {
+                if (snapshot.materialAt(p, NUM_PLANET_TEXTURES) != i)
                     continue;
 
                 /* Set up a matrix for the planet's position and size. */
-                glm::mat4 matrix = glm::translate(planet.position);
-                matrix = glm::scale(matrix, glm::vec3(planet.radius() * drawScale));
+                glm::mat4 matrix = glm::translate(snapshot.positionAt(p, blend));
+                matrix = glm::scale(matrix, glm::vec3(snapshot.radii[p] * drawScale));
                 glUniformMatrix4fv(shaderTexture_modelMatrix, 1, GL_FALSE, glm::value_ptr(matrix));
 
                 /* Draw the high resolution sphere. */
@@ -256,8 +261,8 @@ void PlanetsWidget::render() {
     lowResSphereVerts.bind();
     lowResSphereLines.bind();
 
-    if (!hidePlanets && universe.isSelectedValid())
-        drawPlanetWireframe(universe.getSelected());
+    if (!hidePlanets && snapshot.isSelectedValid())
+        drawPlanetWireframe(snapshot.getSelected(blend));
 
     if (placing.step != PlacingInterface::NotPlacing && placing.step != PlacingInterface::Firing)
         drawPlanetWireframe(placing.planet);
@@ -270,14 +275,36 @@ void PlanetsWidget::render() {
         shaderColor.setUniformValue(shaderColor_modelMatrix, QMatrix4x4());
         shaderColor.setUniformValue(shaderColor_color, trailColor);
 
-        for (const auto& i : universe) {
-            shaderColor.setAttributeArray(vertex, GL_FLOAT, i.path.data(), 3);
-            glDrawArrays(GL_LINE_STRIP, 0, GLsizei(i.path.size()));
+        const TrailArena& trails = snapshot.trails;
+
+        for (size_t i = 0; i < trails.trailCount(); ++i) {
+            const TrailArena::Spans spans = trails.spans(i);
+
+            /* A trail can be split in two where its ring buffer wraps around. */
+            for (const TrailArena::Span& span : { spans.first, spans.second }) {
+                if (span.size < 2) continue;
+
+                shaderColor.setAttributeArray(vertex, GL_FLOAT, span.data, 3);
+                glDrawArrays(GL_LINE_STRIP, 0, GLsizei(span.size));
+            }
         }
     }
 
+    if (!hidePlanets && !snapshot.tracerPositions.empty()) {
+        shaderColor.setUniformValue(shaderColor_modelMatrix, QMatrix4x4());
+        shaderColor.setUniformValue(shaderColor_color, tracerColor);
+
+        /* Tracers are just points, blended between steps the same as the planets. */
+        tracerPoints.resize(snapshot.tracerPositions.size());
+        for (size_t i = 0; i < tracerPoints.size(); ++i)
+            tracerPoints[i] = snapshot.tracerPositionAt(i, blend);
+
+        shaderColor.setAttributeArray(vertex, GL_FLOAT, tracerPoints.data(), 3);
+        glDrawArrays(GL_POINTS, 0, GLsizei(tracerPoints.size()));
+    }
+
     if (placing.step == PlacingInterface::FreeVelocity && !glm::all(glm::equal(placing.planet.velocity, glm::vec3()))) {
-        float length = glm::length(placing.planet.velocity) / universe.velocityFactor;
+        float length = glm::length(placing.planet.velocity) / PlanetsUniverse::velocityFactor;
 
         glm::mat4 matrix = glm::translate(placing.planet.position);
         matrix = glm::scale(matrix, glm::vec3(placing.planet.radius()));
@@ -325,7 +352,7 @@ void PlanetsWidget::render() {
     }
 
     if ((placing.step == PlacingInterface::OrbitalPlane || placing.step == PlacingInterface::OrbitalPlanet)
-        && universe.isSelectedValid() && placing.orbitalRadius > 0.0f) {
+        && snapshot.isSelectedValid() && placing.orbitalRadius > 0.0f) {
         glm::mat4 newRadiusMatrix = placing.getOrbitalCircleMat();
         glm::mat4 oldRadiusMatrix = placing.getOrbitedCircleMat();
 
@@ -351,10 +378,11 @@ void PlanetsWidget::render() {
         glUniformMatrix4fv(shaderColor_modelMatrix, 1, GL_FALSE, glm::value_ptr(glm::mat4(1.0f)));
 
         /* Draw a line from the planet's 3D position to the 2D circle's center. */
-        for (const auto& i : universe) {
+        for (size_t i = 0; i < snapshot.size(); ++i) {
+            const glm::vec3 position = snapshot.positionAt(i, blend);
             float verts[] = {
-                i.position.x, i.position.y, 0,
-                i.position.x, i.position.y, i.position.z,
+                position.x, position.y, 0,
+                position.x, position.y, position.z,
             };
             glVertexAttribPointer(vertex, 3, GL_FLOAT, GL_FALSE, 0, verts);
             glDrawArrays(GL_LINES, 0, 2);
@@ -366,12 +394,12 @@ void PlanetsWidget::render() {
         shaderColor.setAttributeBuffer(vertex, GL_FLOAT, 0, 3, sizeof(glm::vec3));
 
         /* Draw the circle on the XY plane. */
-        for (const auto& i : universe) {
-            glm::vec3 pos = i.position;
+        for (size_t i = 0; i < snapshot.size(); ++i) {
+            glm::vec3 pos = snapshot.positionAt(i, blend);
             pos.z = 0;
 
             glm::mat4 matrix = glm::translate(pos);
-            matrix = glm::scale(matrix, glm::vec3(i.radius() * drawScale + camera.distance * 0.02f));
+            matrix = glm::scale(matrix, glm::vec3(snapshot.radii[i] * drawScale + camera.distance * 0.02f));
 
             glUniformMatrix4fv(shaderColor_modelMatrix, 1, GL_FALSE, glm::value_ptr(matrix));
             glDrawElements(GL_LINES, circleLineCount, GL_UNSIGNED_INT, nullptr);
@@ -521,7 +549,7 @@ void PlanetsWidget::mouseDoubleClickEvent(QMouseEvent* e) {
     case Qt::LeftButton:
         /* Double clicking the left button while not placing sets or clears the planet currently being followed. */
         if (placing.step == PlacingInterface::NotPlacing) {
-            if (universe.isSelectedValid()) {
+            if (runner.current().isSelectedValid()) {
                 camera.followSelection();
             } else {
                 camera.clearFollow();
@@ -575,3 +603,4 @@ void PlanetsWidget::drawPlanetWireframe(const Planet& planet, const QColor& colo
 }
 
 const QColor PlanetsWidget::trailColor = QColor(0xcc, 0xff, 0xff, 0xff);
+const QColor PlanetsWidget::tracerColor = QColor(0xcc, 0xb3, 0x99, 0xff);
@@ -5,6 +5,7 @@
 #endif
 
 #include "planetsuniverse.h"
+#include "simulationrunner.h"
 #include "placinginterface.h"
 #include "grid.h"
 #include "camera.h"
@@ -15,6 +16,8 @@
 class PlanetsWindow {
     /* Universe and basic interface classes. */
     PlanetsUniverse universe;
+    /* Steps the universe on its own thread, everything else only reads its snapshots and posts changes to it. */
+    SimulationRunner runner;
     PlacingInterface placing;
     Camera camera;
 
@@ -102,6 +105,9 @@ class PlanetsWindow {
     /* Called whenever window gets resized. */
     void onResized(uint32_t width, uint32_t height);
 
+    /* Blended tracer positions for drawing, kept around so it doesn't get reallocated every frame. */
+    std::vector<glm::vec3> tracerPoints;
+
     /* Draw a wireframe planet. Expects low res sphere VBO & IBO to be bound. */
     void drawPlanetWireframe(const Planet& planet, const glm::vec4& color = glm::vec4(0.0f, 1.0f, 0.0f, 1.0f));
 
@@ -125,6 +131,8 @@ class PlanetsWindow {
 #endif
 
     bool planetGenOrbital = false;
+    /* Generate massless tracers instead of planets. */
+    bool planetGenTracers = false;
     int planetGenAmount = 10;
     float planetGenMaxPos = 1.0e3f;
     float planetGenMaxSpeed = 1.0f;
@@ -15,7 +15,7 @@
 
 #define NUM_PLANET_TEXTURES 7
 
-PlanetsWindow::PlanetsWindow(int argc, char* argv[]) : placing(universe), camera(universe), gamepad(universe, camera, placing) {
+PlanetsWindow::PlanetsWindow(int argc, char* argv[]) : runner(universe), placing(runner), camera(runner), gamepad(runner, camera, placing) {
     initSDL();
     initGL();
     initUI();
@@ -28,6 +28,8 @@ PlanetsWindow::PlanetsWindow(int argc, char* argv[]) : placing(universe), camera
             universe.load(argv[i]); break;
         } catch (...) {}
     }
+
+    runner.start();
 }
 
 PlanetsWindow::~PlanetsWindow() {
@@ -406,7 +408,7 @@ void PlanetsWindow::openFile() {
     nfdresult_t result = NFD_OpenDialog("xml", NULL, &outPath);
 
     if (result == NFD_OKAY) {
-        universe.load(outPath);
+        runner.execute([outPath](PlanetsUniverse& universe) { universe.load(outPath); });
         free(outPath);
     } else if (result == NFD_ERROR)
         printf("Error: %s\n", NFD_GetError());
@@ -417,7 +419,7 @@ void PlanetsWindow::appendFile() {
     nfdresult_t result = NFD_OpenDialog("xml", NULL, &outPath);
 
     if (result == NFD_OKAY) {
-        universe.load(outPath, false);
+        runner.execute([outPath](PlanetsUniverse& universe) { universe.load(outPath, false); });
         free(outPath);
     } else if (result == NFD_ERROR)
         printf("Error: %s\n", NFD_GetError());
@@ -428,7 +430,7 @@ void PlanetsWindow::saveFile() {
     nfdresult_t result = NFD_SaveDialog("xml", NULL, &outPath);
 
     if (result == NFD_OKAY) {
-        universe.save(outPath);
+        runner.execute([outPath](PlanetsUniverse& universe) { universe.save(outPath); });
         free(outPath);
     } else if (result == NFD_ERROR)
         printf("Error: %s\n", NFD_GetError());
@@ -456,7 +458,7 @@ void PlanetsWindow::run() {
         if (delay != 0)
             /* Put a bunch of information into the title. */
             SDL_SetWindowTitle(windowSDL, ("Planets3D  [" + std::to_string(1000000 / delay) + "fps, " +
-                                           std::to_string(universe.size()) + " planet(s)]").c_str());
+                                           std::to_string(runner.current().size()) + " planet(s)]").c_str());
 
         /* Don't do delays larger than a second. */
         delay = std::min(delay, 1000000);
@@ -465,8 +467,11 @@ void PlanetsWindow::run() {
         doEvents();
 
         /* Don't advance if we're placing. */
-        if (placing.step == PlacingInterface::NotPlacing || placing.step == PlacingInterface::Firing)
-            universe.advance(float(delay));
+        runner.setPaused(placing.step != PlacingInterface::NotPlacing && placing.step != PlacingInterface::Firing);
+
+        /* Only does anything if the runner doesn't have its own thread. */
+        runner.update(float(delay));
+        runner.acquire();
 
         paint();
         /* UI time is measured in seconds. */
@@ -492,7 +497,12 @@ void PlanetsWindow::paint() {
     SDL_GL_MakeCurrent(windowSDL, contextSDL);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+    const Snapshot& snapshot = runner.current();
+    /* Planets are drawn partway between the last two steps so motion stays smooth no matter how often the simulation steps. */
+    const float blend = runner.blend();
+
     camera.setup();
+    placing.followOrigin();
 
     /* We only use the texture shader, normals, tangents, and uvs for drawing the shaded planets. */
     glUseProgram(shaderTexture);
@@ -509,8 +519,6 @@ void PlanetsWindow::paint() {
 
     glBindVertexArray(highResSphereVAO);
 
-    std::uniform_int_distribution<int> material(0, NUM_PLANET_TEXTURES-1);
-
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D_ARRAY, planetTextures_diff);
     glActiveTexture(GL_TEXTURE1);
@@ -518,16 +526,12 @@ void PlanetsWindow::paint() {
     glActiveTexture(GL_TEXTURE2);
     glBindTexture(GL_TEXTURE_2D_ARRAY, planetTextures_height);
 
-    for (Planet& planet : universe) {
-        /* If the material is invalid, generate a valid one. */
-        if (planet.materialID > NUM_PLANET_TEXTURES)
-            planet.materialID = material(universe.generator);
-
-        glUniform1i(shaderTexture_material, planet.materialID);
+    for (size_t i = 0; i < snapshot.size(); ++i) {
+        glUniform1i(shaderTexture_material, snapshot.materialAt(i, NUM_PLANET_TEXTURES));
 
         /* Create a matrix translated by the position and scaled by the radius. */
-        glm::mat4 matrix = glm::translate(planet.position);
-        matrix = glm::scale(matrix, glm::vec3(planet.radius() * drawScale));
+        glm::mat4 matrix = glm::translate(snapshot.positionAt(i, blend));
+        matrix = glm::scale(matrix, glm::vec3(snapshot.radii[i] * drawScale));
         glUniformMatrix4fv(shaderTexture_modelMatrix, 1, GL_FALSE, glm::value_ptr(matrix));
 
         /* Render all the triangles... */
@@ -544,8 +548,8 @@ void PlanetsWindow::paint() {
     glBindVertexArray(lowResSphereVAO);
 
     /* Draw a green wireframe sphere around the selected planet if there is one. */
-    if (universe.isSelectedValid())
-        drawPlanetWireframe(universe.getSelected());
+    if (snapshot.isSelectedValid())
+        drawPlanetWireframe(snapshot.getSelected(blend));
 
     /* For any valid placing states other than firing, draw the templateplanet. */
     if (placing.step != PlacingInterface::NotPlacing && placing.step != PlacingInterface::Firing)
@@ -558,7 +562,7 @@ void PlanetsWindow::paint() {
         glBindVertexArray(arrowVAO);
 
         /* How long does the velocity arrow need to be? */
-        float length = glm::length(placing.planet.velocity) / universe.velocityFactor;
+        float length = glm::length(placing.planet.velocity) / PlanetsUniverse::velocityFactor;
 
         glm::mat4 matrix = glm::translate(placing.planet.position);
         matrix *= placing.rotation;
@@ -571,16 +575,42 @@ void PlanetsWindow::paint() {
     /* Back to no VAO. */
     glBindVertexArray(0);
 
+    /* Nothing else uses the trails, so there's no point recording them unless they're drawn. */
+    if (snapshot.recordPaths != drawTrails)
+        runner.set(&PlanetsUniverse::recordPaths, drawTrails);
+
     if (drawTrails) {
         /* There is no model matrix for drawing trails, they're in world space, just use identity. */
         glUniformMatrix4fv(shaderColor_modelMatrix, 1, GL_FALSE, glm::value_ptr(glm::mat4(1.0f)));
 
-        for (const auto& i : universe) {
-            glVertexAttribPointer(vertex, 3, GL_FLOAT, GL_FALSE, 0, i.path.data());
-            glDrawArrays(GL_LINE_STRIP, 0, GLsizei(i.path.size()));
+        const TrailArena& trails = snapshot.trails;
+
+        for (size_t i = 0; i < trails.trailCount(); ++i) {
+            const TrailArena::Spans spans = trails.spans(i);
+
+            /* A trail can be split in two where its ring buffer wraps around. */
+            for (const TrailArena::Span& span : { spans.first, spans.second }) {
+                if (span.size < 2) continue;
+
+                glVertexAttribPointer(vertex, 3, GL_FLOAT, GL_FALSE, 0, span.data);
+                glDrawArrays(GL_LINE_STRIP, 0, GLsizei(span.size));
+            }
         }
     }
 
+    if (!snapshot.tracerPositions.empty()) {
+        glUniformMatrix4fv(shaderColor_modelMatrix, 1, GL_FALSE, glm::value_ptr(glm::mat4(1.0f)));
+        glUniform4fv(shaderColor_color, 1, glm::value_ptr(glm::vec4(0.8f, 0.7f, 0.6f, 1.0f)));
+
+        /* Tracers are just points, blended between steps the same as the planets. */
+        tracerPoints.resize(snapshot.tracerPositions.size());
+        for (size_t i = 0; i < tracerPoints.size(); ++i)
+            tracerPoints[i] = snapshot.tracerPositionAt(i, blend);
+
+        glVertexAttribPointer(vertex, 3, GL_FLOAT, GL_FALSE, 0, tracerPoints.data());
+        glDrawArrays(GL_POINTS, 0, GLsizei(tracerPoints.size()));
+    }
+
     if (grid.draw) {
         glDepthMask(GL_FALSE);
 
@@ -622,10 +652,11 @@ void PlanetsWindow::paint() {
         glUniform4fv(shaderColor_color, 1, glm::value_ptr(glm::vec4(0.8f)));
         glUniformMatrix4fv(shaderColor_modelMatrix, 1, GL_FALSE, glm::value_ptr(glm::mat4(1.0f)));
 
-        for (const auto& i : universe) {
+        for (size_t i = 0; i < snapshot.size(); ++i) {
+            const glm::vec3 position = snapshot.positionAt(i, blend);
             float verts[] = {
-                i.position.x, i.position.y, 0,
-                i.position.x, i.position.y, i.position.z,
+                position.x, position.y, 0,
+                position.x, position.y, position.z,
             };
             glVertexAttribPointer(vertex, 3, GL_FLOAT, GL_FALSE, 0, verts);
             glDrawArrays(GL_LINES, 0, 2);
@@ -637,13 +668,13 @@ void PlanetsWindow::paint() {
 
     if (drawPlanarCircles) {
         /* Then we draw a circle at the XY position of every planet. */
-        for (const auto& i : universe) {
-            glm::vec3 pos = i.position;
+        for (size_t i = 0; i < snapshot.size(); ++i) {
+            glm::vec3 pos = snapshot.positionAt(i, blend);
             pos.z = 0;
 
             glm::mat4 matrix = glm::translate(pos);
             /* Make the circle start at the planet's radius and increase it slightly the further out the camera is. */
-            matrix = glm::scale(matrix, glm::vec3(i.radius() * drawScale + camera.distance * 0.02f));
+            matrix = glm::scale(matrix, glm::vec3(snapshot.radii[i] * drawScale + camera.distance * 0.02f));
 
             glUniformMatrix4fv(shaderColor_modelMatrix, 1, GL_FALSE, glm::value_ptr(matrix));
             glDrawElements(GL_LINES, circleLineCount, GL_UNSIGNED_INT, (GLvoid*)circleLineStart);
@@ -651,7 +682,7 @@ void PlanetsWindow::paint() {
     }
 
     if ((placing.step == PlacingInterface::OrbitalPlane || placing.step == PlacingInterface::OrbitalPlanet)
-            && universe.isSelectedValid() && placing.orbitalRadius > 0.0f) {
+            && snapshot.isSelectedValid() && placing.orbitalRadius > 0.0f) {
         glUniform4fv(shaderColor_color, 1, glm::value_ptr(glm::vec4(1.0f)));
 
         glm::mat4 newRadiusMatrix = placing.getOrbitalCircleMat();
@@ -702,6 +733,8 @@ void PlanetsWindow::paintUI(const float delay) {
     /* Hide OS cursor if imgui has one. */
     SDL_ShowCursor(io.MouseDrawCursor ? SDL_FALSE : SDL_TRUE);
 
+    const Snapshot& snapshot = runner.current();
+
     /* Begin UI code. */
     ImGui::NewFrame();
 
@@ -760,7 +793,7 @@ void PlanetsWindow::paintUI(const float delay) {
             if (ImGui::MenuItem("Interactive Creation", "Alt+P"))
                 placing.beginInteractiveCreation();
 
-            if (ImGui::MenuItem("Interactive Orbital", "Alt+O", false, universe.isSelectedValid()))
+            if (ImGui::MenuItem("Interactive Orbital", "Alt+O", false, snapshot.isSelectedValid()))
                 placing.beginOrbitalCreation();
 
             ImGui::EndMenu();
@@ -779,6 +812,8 @@ void PlanetsWindow::paintUI(const float delay) {
         ImGui::Begin("Random Planet Generator", &showPlanetGenWindow);
 
         ImGui::Checkbox("Orbital", &planetGenOrbital);
+        ImGui::SameLine();
+        ImGui::Checkbox("Tracers", &planetGenTracers);
 
         if (ImGui::InputInt("Amount", &planetGenAmount))
             planetGenAmount = std::max(1, planetGenAmount);
@@ -786,14 +821,24 @@ void PlanetsWindow::paintUI(const float delay) {
         if (!planetGenOrbital) {
             ImGui::SliderFloat("Maximum Position", &planetGenMaxPos, 1.0f, 1.0e4f, "%.3f", ImGuiSliderFlags_Logarithmic);
             ImGui::SliderFloat("Maximum Speed", &planetGenMaxSpeed, 0.0f, 200.0f);
-            ImGui::SliderFloat("Maximum Mass", &planetGenMaxMass, 10.0f, 1.0e4f);
+            if (!planetGenTracers)
+                ImGui::SliderFloat("Maximum Mass", &planetGenMaxMass, 10.0f, 1.0e4f);
         }
 
         if (ImGui::Button("Generate")) {
-            if (planetGenOrbital)
-                universe.generateRandomOrbital(planetGenAmount, universe.selected);
-            else
-                universe.generateRandom(planetGenAmount, planetGenMaxPos, planetGenMaxSpeed * universe.velocityFactor, planetGenMaxMass);
+            const int amount = planetGenAmount;
+
+            if (planetGenTracers && planetGenOrbital) {
+                runner.post([amount](PlanetsUniverse& universe) { universe.generateRandomOrbitalTracers(amount, universe.selected); });
+            } else if (planetGenTracers) {
+                const float range = planetGenMaxPos, speed = planetGenMaxSpeed * PlanetsUniverse::velocityFactor;
+                runner.post([=](PlanetsUniverse& universe) { universe.generateRandomTracers(amount, range, speed); });
+            } else if (planetGenOrbital) {
+                runner.post([amount](PlanetsUniverse& universe) { universe.generateRandomOrbital(amount, universe.selected); });
+            } else {
+                const float range = planetGenMaxPos, speed = planetGenMaxSpeed * PlanetsUniverse::velocityFactor, mass = planetGenMaxMass;
+                runner.post([=](PlanetsUniverse& universe) { universe.generateRandom(amount, range, speed, mass); });
+            }
         }
 
         ImGui::End();
@@ -804,31 +849,58 @@ void PlanetsWindow::paintUI(const float delay) {
         ImGui::SetNextWindowSize(ImVec2(360, 100), ImGuiCond_FirstUseEver);
         ImGui::Begin("Speed Controls", &showSpeedWindow);
 
-        ImGui::SliderFloat("Speed", &universe.simulationSpeed, 0.0f, 64.0f, "%.3fx");
+        float speed = snapshot.simulationSpeed;
+
+        if (ImGui::SliderFloat("Speed", &speed, 0.0f, 64.0f, "%.3fx"))
+            runner.set(&PlanetsUniverse::simulationSpeed, speed);
+
+        if (ImGui::Button("Slow Down"))
+            runner.set(&PlanetsUniverse::simulationSpeed, speed <= 0.25f ? 0.0f : speed * 0.5f);
 
-        if (ImGui::Button("Slow Down")) {
-            if (universe.simulationSpeed <= 0.25f)
-                universe.simulationSpeed = 0.0f;
-            else
-                universe.simulationSpeed *= 0.5f;
-        }
         ImGui::SameLine();
-        if (ImGui::Button(universe.simulationSpeed <= 0.0f ? "Resume" : "Pause")) {
-            if (universe.simulationSpeed <= 0.0f)
-                universe.simulationSpeed = pauseSpeed;
+        if (ImGui::Button(speed <= 0.0f ? "Resume" : "Pause")) {
+            if (speed <= 0.0f)
+                runner.set(&PlanetsUniverse::simulationSpeed, pauseSpeed);
             else {
-                pauseSpeed = universe.simulationSpeed;
-                universe.simulationSpeed = 0.0f;
+                pauseSpeed = speed;
+                runner.set(&PlanetsUniverse::simulationSpeed, 0.0f);
             }
         }
         ImGui::SameLine();
         if (ImGui::Button("Fast Forward")) {
-            if (universe.simulationSpeed <= 0.0f)
-                universe.simulationSpeed = 0.25f;
-            else if (universe.simulationSpeed < 64.0f)
-                universe.simulationSpeed *= 2.0f;
+            if (speed <= 0.0f)
+                runner.set(&PlanetsUniverse::simulationSpeed, 0.25f);
+            else if (speed < 64.0f)
+                runner.set(&PlanetsUniverse::simulationSpeed, speed * 2.0f);
         }
 
+        const char* integrators[] = { "Euler", "Leapfrog", "Yoshida 4th Order", "Wisdom-Holman", "Block Timesteps", "IAS15", "Kepler Leapfrog" };
+        int integrator = snapshot.integrator;
+        if (ImGui::Combo("Integrator", &integrator, integrators, IM_ARRAYSIZE(integrators)))
+            runner.set(&PlanetsUniverse::integrator, PlanetsUniverse::Integrator(integrator));
+
+        float blockAccuracy = snapshot.blockAccuracy;
+        if (integrator == PlanetsUniverse::BlockTimesteps &&
+                ImGui::SliderFloat("Block Accuracy", &blockAccuracy, 0.001f, 0.1f, "%.3f", ImGuiSliderFlags_Logarithmic))
+            runner.set(&PlanetsUniverse::blockAccuracy, blockAccuracy);
+
+        float gaussRadauTolerance = snapshot.gaussRadauTolerance;
+        if (integrator == PlanetsUniverse::IAS15 &&
+                ImGui::SliderFloat("Tolerance", &gaussRadauTolerance, 1.0e-14f, 1.0e-3f, "%.0e", ImGuiSliderFlags_Logarithmic))
+            runner.set(&PlanetsUniverse::gaussRadauTolerance, gaussRadauTolerance);
+
+        float regularizationRange = snapshot.regularizationRange;
+        if ((integrator == PlanetsUniverse::Leapfrog || integrator == PlanetsUniverse::WisdomHolman) &&
+                ImGui::SliderFloat("Regularization Range", &regularizationRange, 0.0f, 100.0f, "%.1f"))
+            runner.set(&PlanetsUniverse::regularizationRange, regularizationRange);
+
+        /* Only the Euler, leapfrog, and Yoshida integrators go by this. */
+        const char* precisions[] = { "Single", "Double", "Mixed" };
+        int precision = snapshot.precision;
+        if ((integrator == PlanetsUniverse::Euler || integrator == PlanetsUniverse::Leapfrog || integrator == PlanetsUniverse::Yoshida4) &&
+                ImGui::Combo("Precision", &precision, precisions, IM_ARRAYSIZE(precisions)))
+            runner.set(&PlanetsUniverse::precision, PlanetsUniverse::Precision(precision));
+
         ImGui::End();
     }
 
@@ -837,14 +909,94 @@ void PlanetsWindow::paintUI(const float delay) {
         ImGui::SetNextWindowSize(ImVec2(360, 120), ImGuiCond_FirstUseEver);
         ImGui::Begin("View Settings", &showViewSettingsWindow);
 
-        ImGui::SliderInt("Path Length", (int*)&universe.pathLength, 100, 4000);
+        int pathLength = int(snapshot.pathLength);
+        if (ImGui::SliderInt("Path Length", &pathLength, 100, 4000))
+            runner.set(&PlanetsUniverse::pathLength, size_t(pathLength));
 
         /* Show the square root of the value, because it is stored in squared units. */
-        float distance = sqrt(universe.pathRecordDistance);
+        float distance = sqrt(snapshot.pathRecordDistance);
         if (ImGui::SliderFloat("Path Record Distance", &distance, 0.2f, 10.0f))
-            universe.pathRecordDistance = distance * distance;
+            runner.set(&PlanetsUniverse::pathRecordDistance, distance * distance);
+
+        int stepsPerFrame = snapshot.stepsPerFrame;
+        if (ImGui::SliderInt("Steps Per Frame", &stepsPerFrame, 1, 4000))
+            runner.set(&PlanetsUniverse::stepsPerFrame, stepsPerFrame);
+
+        const StepController& controller = snapshot.stepController;
+
+        bool adaptive = controller.enabled;
+        if (ImGui::Checkbox("Adaptive Steps", &adaptive))
+            runner.post([adaptive](PlanetsUniverse& universe) { universe.stepController.enabled = adaptive; });
+
+        if (controller.enabled) {
+            float budget = float(controller.budget);
+            if (ImGui::SliderFloat("Frame Budget", &budget, 1.0f, 100.0f, "%.1fms"))
+                runner.post([budget](PlanetsUniverse& universe) { universe.stepController.budget = budget; });
+
+            /* Show what the controller decided for the last frame. */
+            if (controller.isSlowed())
+                ImGui::Text("%d steps, slowed to %.0f%%", controller.steps(), controller.timeScale() * 100.0f);
+            else
+                ImGui::Text("%d steps", controller.steps());
+        }
+
+        const char* solvers[] = { "Direct Sum", "Barnes-Hut", "Fast Multipole", "Particle Mesh" };
+        int solver = snapshot.gravitySolver;
+        if (ImGui::Combo("Gravity Solver", &solver, solvers, IM_ARRAYSIZE(solvers)))
+            runner.set(&PlanetsUniverse::gravitySolver, PlanetsUniverse::GravitySolver(solver));
+
+        /* The opening angle only means anything to Barnes-Hut. */
+        float openingAngle = snapshot.openingAngle;
+        if (solver == PlanetsUniverse::BarnesHut && ImGui::SliderFloat("Opening Angle", &openingAngle, 0.1f, 1.5f))
+            runner.set(&PlanetsUniverse::openingAngle, openingAngle);
+
+        if (solver == PlanetsUniverse::FastMultipole) {
+            int order = snapshot.multipoleOrder;
+            if (ImGui::SliderInt("Expansion Order", &order, 1, MultipoleTree::maximumOrder))
+                runner.set(&PlanetsUniverse::multipoleOrder, order);
+
+            float tolerance = snapshot.multipoleTolerance;
+            if (ImGui::SliderFloat("Error Tolerance", &tolerance, 1.0e-6f, 0.5f, "%.6f", ImGuiSliderFlags_Logarithmic))
+                runner.set(&PlanetsUniverse::multipoleTolerance, tolerance);
+
+            ImGui::Text("Force error: %.2e", snapshot.multipoleError);
+        }
+
+        if (solver == PlanetsUniverse::ParticleMeshFFT) {
+            const char* meshSizes[] = { "8", "16", "32", "64", "128", "256" };
+            int meshSize = 0;
+            while (meshSize < IM_ARRAYSIZE(meshSizes) - 1 && (int(ParticleMesh::minimumSize) << (meshSize + 1)) <= snapshot.meshSize)
+                ++meshSize;
+            if (ImGui::Combo("Grid Cells", &meshSize, meshSizes, IM_ARRAYSIZE(meshSizes)))
+                runner.set(&PlanetsUniverse::meshSize, int(ParticleMesh::minimumSize) << meshSize);
+
+            bool correction = snapshot.meshCorrection;
+            if (ImGui::Checkbox("Short Range Correction", &correction))
+                runner.set(&PlanetsUniverse::meshCorrection, correction);
+        }
+
+        bool mergePlanets = snapshot.mergePlanets;
+        if (ImGui::Checkbox("Merge Planets", &mergePlanets))
+            runner.set(&PlanetsUniverse::mergePlanets, mergePlanets);
+
+        /* Merging works with every solver this way, otherwise it's up to the solver to notice planets touching. */
+        bool hashCollisions = snapshot.hashCollisions;
+        if (ImGui::Checkbox("Spatial Hash Collisions", &hashCollisions))
+            runner.set(&PlanetsUniverse::hashCollisions, hashCollisions);
+
+        int sortInterval = snapshot.sortInterval;
+        if (ImGui::SliderInt("Sort Interval", &sortInterval, 0, 256))
+            runner.set(&PlanetsUniverse::sortInterval, sortInterval);
+
+        /* Moving everything back to the origin is invisible, so this only matters for how much precision is lost first. */
+        float rebaseDistance = snapshot.rebaseDistance;
+        if (ImGui::SliderFloat("Rebase Distance", &rebaseDistance, 0.0f, 1.0e6f, "%.0f", ImGuiSliderFlags_Logarithmic))
+            runner.set(&PlanetsUniverse::rebaseDistance, rebaseDistance);
+
+        int threads = snapshot.threadCount;
+        if (ImGui::SliderInt("Threads", &threads, 1, ThreadPool::hardwareThreads()))
+            runner.post([threads](PlanetsUniverse& universe) { universe.setThreadCount(threads); });
 
-        ImGui::SliderInt("Steps Per Frame", &universe.stepsPerFrame, 1, 4000);
         ImGui::SliderInt("Grid Size", (int*)&grid.range, 4, 64);
 
         ImGui::SliderFloat("Planet Scale", &drawScale, 1.0f, 8.0f);
@@ -857,22 +1009,30 @@ void PlanetsWindow::paintUI(const float delay) {
         ImGui::SetNextWindowSize(ImVec2(360, 320), ImGuiCond_FirstUseEver);
         ImGui::Begin("Information", &showInfoWindow);
 
-        if (universe.isSelectedValid() && ImGui::CollapsingHeader("Selected Planet")) {
-            Planet& p = universe.getSelected();
+        if (snapshot.isSelectedValid() && ImGui::CollapsingHeader("Selected Planet")) {
+            const key_type key = snapshot.selected;
+            const Planet p = snapshot.getSelected();
             ImGui::Text("Position: x: %f, y: %f, z: %f", p.position.x, p.position.y, p.position.z);
-            ImGui::Text("Velocity: x: %f, y: %f, z: %f",
-                        p.velocity.x / universe.velocityFactor, p.velocity.y / universe.velocityFactor, p.velocity.z / universe.velocityFactor);
+            ImGui::Text("Velocity: x: %f, y: %f, z: %f", p.velocity.x / PlanetsUniverse::velocityFactor,
+                        p.velocity.y / PlanetsUniverse::velocityFactor, p.velocity.z / PlanetsUniverse::velocityFactor);
             ImGui::Text("Mass:     %f", p.mass());
             ImGui::Text("Radius:   %f", p.radius());
             /* The materialID is a uint8_t, so it won't work directly with SliderInt(),
              * but SliderInt() just converts to a float and calls SliderFloat(), so why bother with an int in between? */
             float mat = p.materialID;
-            if (ImGui::SliderFloat("Material", &mat, 0, NUM_PLANET_TEXTURES-1, "%.0f"))
-                p.materialID = static_cast<uint8_t>(mat);
+            if (ImGui::SliderFloat("Material", &mat, 0, NUM_PLANET_TEXTURES-1, "%.0f")) {
+                const uint8_t material = static_cast<uint8_t>(mat);
+                runner.post([key, material](PlanetsUniverse& universe) {
+                    if (universe.isValid(key))
+                        universe[key].materialID = material;
+                });
+            }
         }
 
-        if (ImGui::CollapsingHeader("General Info", ImGuiTreeNodeFlags_DefaultOpen))
-            ImGui::Text("Planet Count: %zu", universe.size());
+        if (ImGui::CollapsingHeader("General Info", ImGuiTreeNodeFlags_DefaultOpen)) {
+            ImGui::Text("Planet Count: %zu", snapshot.size());
+            ImGui::Text("Tracer Count: %zu", snapshot.tracerPositions.size());
+        }
 
         if (ImGui::CollapsingHeader("Statistics")) {
             ImGui::PlotLines("Frame Time\n(in ms)", frameTimes.data(), static_cast<int>(frameTimes.size()),
@@ -901,9 +1061,9 @@ void PlanetsWindow::paintUI(const float delay) {
             placing.enableFiringMode(firingMode);
 
         /* Show the speed in UI velocity. */
-        float speed = placing.firingSpeed / universe.velocityFactor;
+        float speed = placing.firingSpeed / PlanetsUniverse::velocityFactor;
         if (ImGui::SliderFloat("Speed", &speed, 0.0f, 1.0e3f, "%.3f", ImGuiSliderFlags_Logarithmic))
-            placing.firingSpeed = speed * universe.velocityFactor;
+            placing.firingSpeed = speed * PlanetsUniverse::velocityFactor;
 
         ImGui::SliderFloat("Mass", &placing.firingMass, 1.0f, 1.0e3f);
 
@@ -1041,14 +1201,14 @@ void PlanetsWindow::doEvents() {
         case SDL_WINDOWEVENT:
             switch(event.window.event) {
             case SDL_WINDOWEVENT_FOCUS_LOST:
-                if (universe.simulationSpeed > 0.0f) {
-                    pauseSpeed = universe.simulationSpeed;
-                    universe.simulationSpeed = 0.0f;
+                if (runner.current().simulationSpeed > 0.0f) {
+                    pauseSpeed = runner.current().simulationSpeed;
+                    runner.set(&PlanetsUniverse::simulationSpeed, 0.0f);
                 }
                 break;
             case SDL_WINDOWEVENT_FOCUS_GAINED:
-                if (pauseSpeed > 0.0f && universe.simulationSpeed <= 0.0f)
-                    universe.simulationSpeed = pauseSpeed;
+                if (pauseSpeed > 0.0f && runner.current().simulationSpeed <= 0.0f)
+                    runner.set(&PlanetsUniverse::simulationSpeed, pauseSpeed);
                 break;
             case SDL_WINDOWEVENT_RESIZED:
                 /* We don't want anyone resizing the window with a width or height of 0. */
@@ -1086,7 +1246,7 @@ void PlanetsWindow::doEvents() {
             if (!io.WantCaptureMouse) {
                 if (event.button.button == SDL_BUTTON_LEFT) {
                     if (event.button.clicks == 2 && placing.step == PlacingInterface::NotPlacing) {
-                        if (universe.isSelectedValid())
+                        if (runner.current().isSelectedValid())
                             camera.followSelection();
                         else
                             camera.clearFollow();
@@ -1109,7 +1269,8 @@ void PlanetsWindow::doEvents() {
             break;
         case SDL_DROPFILE:
             try {
-                universe.load(event.drop.file);
+                const std::string file = event.drop.file;
+                runner.execute([&file](PlanetsUniverse& universe) { universe.load(file); });
             } catch (std::exception e) {
                 SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, "Unable to load file dropped on window", e.what(), windowSDL);
             }
@@ -1168,10 +1329,10 @@ void PlanetsWindow::doKeyPress(const SDL_Keysym& key) {
         break;
     case SDLK_c:
         if (key.mod & KMOD_ALT)
-            universe.centerAll();
+            runner.post([](PlanetsUniverse& universe) { universe.centerAll(); });
         break;
     case SDLK_DELETE:
-        universe.deleteSelected();
+        runner.post([](PlanetsUniverse& universe) { universe.deleteSelected(); });
         break;
     case SDLK_RETURN:
         if (key.mod & KMOD_ALT)
@@ -1212,7 +1373,7 @@ void PlanetsWindow::onClose() {
     };
 
     int result;
-    running = !universe.isEmpty() && SDL_ShowMessageBox(&messageboxdata, &result) == 0 && result == 0;
+    running = !runner.current().isEmpty() && SDL_ShowMessageBox(&messageboxdata, &result) == 0 && result == 0;
 }
 
 void PlanetsWindow::newUniverse() {
@@ -1223,8 +1384,8 @@ void PlanetsWindow::newUniverse() {
     };
 
     int result;
-    if (!universe.isEmpty() && SDL_ShowMessageBox(&messageboxdata, &result) == 0 && result == 1)
-        universe.deleteAll();
+    if (!runner.current().isEmpty() && SDL_ShowMessageBox(&messageboxdata, &result) == 0 && result == 1)
+        runner.post([](PlanetsUniverse& universe) { universe.deleteAll(); });
 }
 
 void PlanetsWindow::onResized(uint32_t width, uint32_t height) {